@@ -14,14 +14,19 @@ extern "C" {
 #include "webclient.h"
 #include "config.h"
 
+// TPL5111 wake up period (s), set by its delay resistor
+#define WAKE_PERIOD 600
+
 // sysinfo informations
 typedef struct
 {
+  uint32_t bootUs;  // Boot to setup() (µs)
   bool   extWake;
   float  vBatt;
   float  temperature;
   float  pressure;
   float  humidity;
+  uint8_t sensors;  // SENSOR_HAS_* of the values above, see sensor.h
 } _sysinfo;
 
 // Exported variables/object instancied in main sketch
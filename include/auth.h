@@ -0,0 +1,9 @@
+#pragma once
+#include "common.h"
+
+// HMAC-SHA256 keyed with config.report_key
+#define AUTH_HMAC_SIZE  32
+
+bool authEnabled(void);
+void authHmac(const uint8_t * data, size_t len, uint8_t * mac, size_t mac_len=AUTH_HMAC_SIZE);
+bool authCheckHex(const uint8_t * data, size_t len, const char * hex);
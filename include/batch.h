@@ -0,0 +1,41 @@
+#pragma once
+#include "common.h"
+
+// Multi sample upload, little endian, used in deep sleep mode (see sampler.h)
+// instead of the JSON samples array when config.report_batch is set
+//  0  magic        'E' 'B'
+//  2  version      BATCH_VERSION
+//  3  flags        BATCH_FLAG_*
+//  4  chip id      uint32
+//  8  time         uint32, Unix time of the first sample, 0 if unknown
+// 12  interval     uint16, s between samples
+// 14  channels     uint8, BATCH_CH_* present
+// 15  count        uint8, samples
+// 16  data         for each channel present, in BATCH_CH_* order, each sample
+//                  value minus the previous one (0 for the first) as a
+//                  ZigZag varint. Units are the _sample ones
+// Data is heatshrink compressed (window 2^8, lookahead 2^4) when flagged
+#define BATCH_MAGIC0        'E'
+#define BATCH_MAGIC1        'B'
+#define BATCH_VERSION       1
+#define BATCH_HEADER_SIZE   16
+#define BATCH_SIZE          256   // Encoding buffers, twice on the stack
+
+#define BATCH_FLAG_HEATSHRINK 0x01
+
+#define BATCH_CH_TEMPERATURE  0x01
+#define BATCH_CH_HUMIDITY     0x02
+#define BATCH_CH_PRESSURE     0x04
+#define BATCH_CH_VBATT        0x08
+
+// config.report_batch
+#define BATCH_OFF           0     // JSON samples array
+#define BATCH_RAW           1
+#define BATCH_HEATSHRINK    2
+#define BATCH_MAX           BATCH_HEATSHRINK
+
+// heatshrink parameters, the host decoder has to use the same
+#define BATCH_HS_WINDOW     8     // log2 of the back reference window
+#define BATCH_HS_LOOKAHEAD  4     // log2 of the longest back reference
+
+uint16_t batchEncode(uint8_t * batch, bool compress);
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+
+// Battery voltage, state of charge and adaptive duty cycle
+// A0 is read through the board divider, oversampled and converted with two
+// calibration points (config.batt). The charge comes from a LiPo open
+// circuit voltage curve, the reading being taken before the radio is on.
+// As it drops, reports are spread over more wakes: the TPL5111 period is
+// fixed, so wakes are skipped; in deep sleep mode the interval grows
+// instead. The samples per upload are never stretched, uploads would
+// otherwise end up stretch squared apart.
+#define BATT_DEFAULT_ADC_LO     621   // ADC reading at BATT_DEFAULT_MV_LO
+#define BATT_DEFAULT_MV_LO      3500  // mV
+#define BATT_DEFAULT_ADC_HI     712
+#define BATT_DEFAULT_MV_HI      4000
+#define BATT_DEFAULT_OVERSAMPLE 16    // ADC readings averaged
+#define BATT_DEFAULT_SOC_LOW    40    // % where the duty cycle starts stretching
+#define BATT_DEFAULT_SOC_CRIT   10    // % where it is stretched the most
+#define BATT_DEFAULT_STRETCH    4     // Reports that far apart at BATT_DEFAULT_SOC_CRIT
+
+#define BATT_OVERSAMPLE_MAX     64
+#define BATT_STRETCH_MAX        16
+#define BATT_MV_JUMP            150   // mV, a bigger step restarts the smoothing (new battery)
+#define BATT_SOC_CHARGE         500   // 1/100 %, a bigger rise is a charge
+#define BATT_SOC_HYST           200   // 1/100 %, rise needed before the stretch goes down
+#define BATT_RATE_SPAN          86400 // s between discharge rate updates
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 12 bytes
+typedef struct
+{
+  uint16_t mv;                      // 2   Smoothed voltage (mV), 0 if unknown
+  uint16_t ref_soc;                 // 2   Charge at the rate anchor (1/100 %)
+  uint32_t ref_tick;                // 4   Anchor time tick (see timemodel.h), 0 if none
+  uint16_t rate;                    // 2   Discharge rate (1/100 % per day), 0 if unknown
+  uint8_t  stretch;                 // 1   Current duty cycle stretch, 0 or 1 for none
+  uint8_t  reserved;                // 1
+} _battstate;
+
+#pragma pack(pop)
+
+void batteryRead(void);
+float batteryAdc(void);
+void batteryUpdate(uint16_t mv);
+uint16_t batterySoc(void);
+uint8_t batteryStretch(void);
+bool batterySkip(void);
+void batteryJSON(String & r);
@@ -3,28 +3,50 @@
 #include <Arduino.h>
 
 
-#define DEBUG
+// Build profile, see platformio.ini: the field build leaves config mode
+// and serial debug out of the image every wake boots
+#ifndef FIELD_BUILD
+  #define DEBUG
+#endif
 
-#define DEBUG_SERIAL  Serial
-#ifdef DEBUG
-  #define dbgInit()     DEBUG_SERIAL.begin(115200);
-  #define dbg(x)        DEBUG_SERIAL.print(x)
-  #define dbgF(x)       DEBUG_SERIAL.print(F(x))
-  #define dbg_s(...)    DEBUG_SERIAL.printf(__VA_ARGS__)
-  #define dbgFlush()    DEBUG_SERIAL.flush()
+#define HAS_BME280
+//#define ALWAYS_REPORT   // Report on every wake whatever the report policy
+//#define BOOT_BENCH      // Print boot timing on power off, even without DEBUG
 
-  #define EOL "\r\n"
+// Feature flags as constants: disabled code is still compiled, then dropped
+#ifdef DEBUG
+constexpr bool featureDebug = true;
+#else
+constexpr bool featureDebug = false;
+#endif
+#ifdef HAS_BME280
+constexpr bool featureBME280 = true;
 #else
-  #define dbg(x)    {}
-  #define dbgln(x)  {}
-  #define dbgF(x)   {}
-  #define dbglnF(x) {}
-  #define dbgf(...) {}
-  #define dbgflush  {}
+constexpr bool featureBME280 = false;
+#endif
+#ifdef ALWAYS_REPORT
+constexpr bool featureAlwaysReport = true;
+#else
+constexpr bool featureAlwaysReport = false;
+#endif
+#ifdef BOOT_BENCH
+constexpr bool featureBootBench = true;
+#else
+constexpr bool featureBootBench = false;
 #endif
 
-#define HAS_BME280
-#define ALWAYS_REPORT
+#define DEBUG_SERIAL  Serial
+#define EOL "\r\n"
+
+#include "log.h"
+
+// Debug output goes through the logger (log.h) at LOG_INFO level
+#define dbgInit()     logInit()
+#define dbg(x)        do { if (featureDebug) logValue(x); } while (0)
+#define dbgF(x)       do { if (featureDebug) \
+                           logWrite(LOG_INFO | LOG_RAW, PSTR(x), NULL, 0); } while (0)
+#define dbg_s(...)    do { if (featureDebug) LOG_AT(LOG_INFO, __VA_ARGS__); } while (0)
+#define dbgFlush()    do { if (featureDebug) logPump(); } while (0)
 
 #define __appName "esLPWeather"
 #define __version "1.1.0"
@@ -1,9 +1,16 @@
 #pragma once
 #include "common.h"
+#include "reporttpl.h"
+
+// EEPROM layout: configuration block first, then runtime state (see state.h),
+// then the saved log (see log.h)
+#define EEPROM_SIZE       3072
+#define EEPROM_CFG_ADDR   0
 
 #define CFG_SSID_SIZE 		32
 #define CFG_PSK_SIZE  		64
 #define CFG_HOSTNAME_SIZE 16
+#define CFG_NETWORKS      2   // Fallback networks in addition to the main one
 
 // Custom reporting: data is sent using POST "payload" data
 #define CFG_REPORT_HOST_SIZE    32
@@ -12,6 +19,32 @@
 #define CFG_REPORT_DEFAULT_HOST "my.iot.server.com"
 #define CFG_REPORT_DEFAULT_URL  "/?a=newEvent&uuid=aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee&token=xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx&type=1"
 #define CFG_REPORT_MSG_SIZE     90
+#define CFG_REPORT_KEY_SIZE     32  // Shared key authenticating server directives
+#define CFG_REPORT_FP_SIZE      20  // SHA1 fingerprint of the HTTPS server certificate
+#define CFG_REPORT_TPL_SIZE     80  // Compiled HTTP report template, see reporttpl.h
+
+// Report transports
+#define CFG_REPORT_PROTO_HTTP   0   // JSON POST over HTTP
+#define CFG_REPORT_PROTO_UDP    1   // Binary datagram, see frame.h
+#define CFG_REPORT_PROTO_MQTT   2   // MQTT publish, url is the topic template
+#define CFG_REPORT_PROTO_ESPNOW 3   // ESP-NOW frame to a gateway, no WiFi association
+#define CFG_REPORT_PROTO_HTTPS  4   // JSON POST over HTTPS, report_fp required
+#define CFG_REPORT_PROTO_MAX    CFG_REPORT_PROTO_HTTPS
+#define CFG_ESPNOW_MAC_SIZE     6
+#define CFG_ESPNOW_DEFAULT_CHANNEL 1
+#define CFG_REPORT_DEFAULT_ACK  200 // UDP acknowledge timeout (ms), 0 for none
+
+// Power profiles, see power.h
+#define CFG_POWER_PHASES        3   // Sensor, association, transfer
+
+// Deep sleep scheduling, see sampler.h
+#define CFG_SLEEP_DEFAULT_FLUSH 10  // Samples per upload
+
+// Sensor statistics, see stats.h
+#define CFG_STATS_DEFAULT_WINDOW 36 // Samples, 6 hours with the TPL5111
+
+// Time model, see timemodel.h
+#define CFG_NTP_SIZE            32
 
 #define CFG_NET_DEFAULT_IP ""
 #define CFG_NET_DEFAULT_GW ""
@@ -27,22 +60,21 @@
 #define CFG_DEBUG	      0x0002	// Enable serial debug
 #define CFG_BAD_CRC     0x8000  // Bad CRC when reading configuration
 
-// Web Interface Configuration Form field names
-#define CFG_FORM_SSID     FPSTR("ssid")
-#define CFG_FORM_PSK      FPSTR("psk")
-#define CFG_FORM_HOST     FPSTR("host")
-#define CFG_FORM_NET_IP   FPSTR("net_ip")
-#define CFG_FORM_NET_MSK  FPSTR("net_msk")
-#define CFG_FORM_NET_GW   FPSTR("net_gw")
-#define CFG_FORM_NET_DNS  FPSTR("net_dns")
-#define CFG_FORM_AP_PSK   FPSTR("ap_psk")
-#define CFG_FORM_OTA_AUTH FPSTR("ota_auth")
-#define CFG_FORM_OTA_PORT FPSTR("ota_port")
-
-#define CFG_FORM_REPORT_HOST  FPSTR("report_host")
-#define CFG_FORM_REPORT_PORT  FPSTR("report_port")
-#define CFG_FORM_REPORT_URL   FPSTR("report_url")
-#define CFG_FORM_REPORT_MSG   FPSTR("report_msg")
+// Configuration field types, see _cfgfield
+#define CFG_TYPE_STR    0   // String, value shorter than the field
+#define CFG_TYPE_UINT   1   // Unsigned 1, 2 or 4 bytes, min to max
+#define CFG_TYPE_HEX    2   // Bytes, "aa:bb:.." or "aabb..", "" for all zero
+#define CFG_TYPE_IP     3   // Binary IPv4 address, "" for 0
+#define CFG_TYPE_POWER  4   // POWER_PROFILE_* by name, see power.h
+#define CFG_TYPE_TPL    5   // Report template text, compiled, see reporttpl.h
+
+// Configuration field flags
+#define CFG_FIELD_REMOTE  0x01  // Settable by the report server, see webclient.h
+#define CFG_FIELD_ZERO    0x02  // 0 is accepted out of min to max
+#define CFG_FIELD_EITHER  0x04  // Only min or max are accepted
+
+#define CFG_FIELD_NAME_SIZE 18
+#define CFG_FIELD_VALUE_SIZE (TPL_TEXT_SIZE+1) // cfgFieldValue() buffer
 
 #pragma pack(push)  // push current alignment to stack
 #pragma pack(1)     // set alignment to 1 byte boundary
@@ -52,12 +84,88 @@
 typedef struct
 {
   char  host[CFG_REPORT_HOST_SIZE+1];     // 33  FQDN
-  char  url[CFG_REPORT_URL_SIZE+1];       // 129 Post URL
+  char  url[CFG_REPORT_URL_SIZE+1];       // 129 Post URL (MQTT topic template)
   uint16_t port;                          // 2   Protocol port (HTTP/HTTPS)
   char  msg[CFG_REPORT_MSG_SIZE+1];       // 91  Message 
-  uint8_t filler;                         // +1 = 256
+  uint8_t proto;                          // 1   Transport, CFG_REPORT_PROTO_*
 } _report;
 
+// 13 bytes
+// Report suppression policy, see policy.h
+typedef struct
+{
+  uint8_t  flags;                         // 1   POLICY_* flags
+  uint16_t dtemp;                         // 2   Temperature delta (1/100 °C)
+  uint16_t dhum;                          // 2   Humidity delta (1/100 %)
+  uint16_t dpress;                        // 2   Pressure delta (Pa)
+  uint16_t vbatt_low;                     // 2   Battery low threshold (mV)
+  uint16_t vbatt_crit;                    // 2   Battery critical threshold (mV)
+  uint16_t heartbeat;                     // 2   Report at least every N wakes
+} _policy;
+
+// 4 bytes
+typedef struct
+{
+  uint8_t  cpu;                           // 1   CPU clock (MHz), 80 or 160
+  uint8_t  tx;                            // 1   TX power (1/4 dBm), 0 to 82
+  uint8_t  phy;                           // 1   WiFiPhyMode_t
+  uint8_t  sleep;                         // 1   WiFiSleepType_t
+} _powerprofile;
+
+// 7 bytes
+// Power profile of each wake phase, see power.h
+typedef struct
+{
+  uint8_t  phase[CFG_POWER_PHASES];       // 3   POWER_PROFILE_* of each phase
+  _powerprofile custom;                   // 4   POWER_PROFILE_CUSTOM settings
+} _power;
+
+// 3 bytes
+// Deep sleep scheduling, for boards without the TPL5111 cut-off
+typedef struct
+{
+  uint16_t interval;                      // 2   Wake interval (s), 0 when the TPL5111 does it
+  uint8_t  flush;                         // 1   Samples accumulated per upload
+} _sleep;
+
+// 3 bytes
+// Sensor statistics windows, see stats.h
+typedef struct
+{
+  uint16_t window;                        // 2   Samples per window, 0 disabled
+  uint8_t  flags;                         // 1   STATS_* flags
+} _statscfg;
+
+// 35 bytes
+// Time synchronisation, see timemodel.h
+typedef struct
+{
+  char     ntp[CFG_NTP_SIZE+1];           // 33  SNTP server
+  uint16_t drift;                         // 2   Sync when the estimate may be off by more (s), 0 never
+} _timecfg;
+
+// 12 bytes
+// Battery measure and adaptive duty cycle, see battery.h
+typedef struct
+{
+  uint16_t adc_lo;                        // 2   ADC reading at mv_lo
+  uint16_t mv_lo;                         // 2   Battery voltage (mV)
+  uint16_t adc_hi;                        // 2   ADC reading at mv_hi
+  uint16_t mv_hi;                         // 2
+  uint8_t  oversample;                    // 1   ADC readings averaged
+  uint8_t  soc_low;                       // 1   Charge (%) where reports start spreading, 0 never
+  uint8_t  soc_crit;                      // 1   Charge (%) where they are spread the most
+  uint8_t  stretch;                       // 1   Reports one wake in N at soc_crit
+} _battcfg;
+
+// 2 bytes
+// External wake coalescing, see events.h
+typedef struct
+{
+  uint8_t  window;                        // 1   Timer wakes external wakes are coalesced for, 0 never
+  uint8_t  flags;                         // 1   EVENT_* flags
+} _eventcfg;
+
 // 64 bytes
 #define CFG_IP_ADDRESS_MAX_SIZE  (3*4+3)
 typedef struct
@@ -68,6 +176,18 @@ typedef struct
   char dns[CFG_IP_ADDRESS_MAX_SIZE+1];        // 16
 } _netcfg;
 
+// 114 bytes
+// Fallback network, addresses in binary form to keep it small, 0 = DHCP
+typedef struct
+{
+  char     ssid[CFG_SSID_SIZE+1];         // 33  SSID, empty if unused
+  char     psk[CFG_PSK_SIZE+1];           // 65  Pre shared key
+  uint32_t ip;                            // 4   Static address
+  uint32_t gw;                            // 4
+  uint32_t msk;                           // 4
+  uint32_t dns;                           // 4
+} _network;
+
 
 // Config saved into eeprom
 // 1024 bytes total including CRC
@@ -81,7 +201,23 @@ typedef struct
   uint32_t config;                 //     4   Bit field register
   uint16_t ota_port;               //     2   OTA port
   _netcfg  netcfg;                 //    64   Network config
-  uint8_t  filler[67+128+256];     //   131   in case adding data in config avoiding loosing current conf by bad crc
+  char  report_key[CFG_REPORT_KEY_SIZE+1]; // 33 Report server shared key
+  uint8_t  report_fp[CFG_REPORT_FP_SIZE];  // 20 Report server certificate fingerprint
+  uint16_t report_ack;             //     2   UDP report acknowledge timeout (ms)
+  uint8_t  espnow_mac[CFG_ESPNOW_MAC_SIZE]; // 6 ESP-NOW gateway MAC address
+  uint8_t  espnow_channel;         //     1   ESP-NOW WiFi channel
+  _policy  policy;                 //    13   Report suppression policy
+  _network networks[CFG_NETWORKS]; //   228   Fallback networks
+  _power   power;                  //     7   Power profiles
+  uint8_t  log_level;              //     1   Runtime log level, 0 for default
+  _sleep   sleep;                  //     3   Deep sleep scheduling
+  _statscfg stats;                 //     3   Sensor statistics
+  _timecfg time;                   //    35   Time synchronisation
+  uint8_t  report_batch;           //     1   Deep sleep samples upload format, see batch.h
+  _battcfg batt;                   //    12   Battery measure and duty cycle
+  _eventcfg event;                 //     2   External wake coalescing
+  uint8_t  report_tpl[CFG_REPORT_TPL_SIZE]; // 80 HTTP report template opcodes, empty for the default
+  uint8_t  filler[4];              //     4   in case adding data in config avoiding loosing current conf by bad crc
   _report  report;                 //   256   Custom reporting configuration
   uint16_t crc;                    //     2   CRC
 } _Config;                         // =1024
@@ -93,10 +229,34 @@ extern _Config config;
 
 #pragma pack(pop)
 
+// Configuration field descriptor, one per web form and JSON field
+typedef struct
+{
+  char     name[CFG_FIELD_NAME_SIZE];     // Web form field name
+  uint16_t hash;                          // Hash of name, see cfgFieldFind()
+  uint16_t offset;                        // Offset in _Config
+  uint8_t  size;                          // Size in _Config
+  uint8_t  type;                          // CFG_TYPE_*
+  uint8_t  flags;                         // CFG_FIELD_*
+  int32_t  min;                           // Accepted range of CFG_TYPE_UINT
+  int32_t  max;
+} _cfgfield;
+
 // Declared exported function from route.cpp
 // ===================================================
+uint16_t crc16Update(uint16_t crc, uint8_t a);
+bool eepromReadBlock(uint16_t addr, void * data, uint16_t size, bool clear_on_error=true);
+bool eepromWriteBlock(uint16_t addr, void * data, uint16_t size, bool commit=true);
+
 void cfgInit(void);
 bool cfgRead(bool clear_on_error=true);
 bool cfgSave(void);
+bool cfgField(uint8_t index, _cfgfield * field);
+bool cfgFieldFind(const char * name, _cfgfield * field);
+bool cfgFieldSet(const _cfgfield * field, const char * value);
+const char * cfgFieldValue(const _cfgfield * field, char * buf);
+bool cfgSetField(const char * name, const char * value);
+bool hexToBytes(const char * hex, uint8_t * data, uint8_t size);
+void bytesToHex(const uint8_t * data, uint8_t size, char * hex);
 void cfgShow(void);
 void cfgReset(void);
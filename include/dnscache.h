@@ -0,0 +1,13 @@
+#pragma once
+#include "common.h"
+
+#include <ESP8266WiFi.h>
+
+#define DNS_PORT          53
+#define DNS_TIMEOUT       1000    // Query timeout (ms)
+#define DNS_DEFAULT_TTL   3600    // TTL used when the system resolver had to be used (s)
+#define DNS_MAX_TTL       86400   // Cap so that a moved server is found again (s)
+#define DNS_MSG_SIZE      256
+
+bool dnsResolve(const char * host, IPAddress & ip);
+void dnsInvalidate(void);
@@ -0,0 +1,8 @@
+#pragma once
+#include "common.h"
+
+#define ESPNOW_TIMEOUT    50    // Link layer acknowledge wait (ms)
+#define ESPNOW_TRIES      2     // First send plus one retry
+
+bool espnowReady(void);
+bool espnowReport(void);
@@ -0,0 +1,41 @@
+#pragma once
+#include "common.h"
+
+// External wake coalescing: with config.event.window set, external wakes
+// (reed switch) only record the event into the state and cut power, no
+// WiFi. Events are reported together when the window closes, after that
+// many timer wakes, or along with any report sent before. The board has no
+// clock across power cuts, so events are grouped in bursts, one per timer
+// period, stamped with the estimated time of their first event.
+#define EVENT_FIRST_NOW   0x01  // The event opening a window is reported at once
+
+#define EVENT_BURSTS      6     // Bursts kept, later ones add to the last one
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 6 bytes
+typedef struct
+{
+  uint32_t time;                    // 4   Estimated Unix time of the first event, 0 if unknown
+  uint16_t count;                   // 2   Events
+} _eventburst;
+
+// 42 bytes
+typedef struct
+{
+  uint8_t  open;                    // 1   Coalescing window open
+  uint8_t  timers;                  // 1   Timer wakes since it opened
+  uint16_t count;                   // 2   Events not reported yet
+  uint8_t  bursts;                  // 1   Bursts used
+  uint8_t  split;                   // 1   Next event starts a new burst
+  _eventburst burst[EVENT_BURSTS];  // 36
+} _eventstate;
+
+#pragma pack(pop)
+
+bool eventWake(bool ext);
+bool eventPending(void);
+uint16_t eventCount(void);
+void eventReported(void);
+void eventJSON(String & r);
@@ -0,0 +1,36 @@
+#pragma once
+#include "common.h"
+
+// Binary report frame, little endian, used by the datagram transports
+//  0  magic        'E' 'L'
+//  2  version      FRAME_VERSION
+//  3  flags        FRAME_FLAG_*
+//  4  chip id      uint32
+//  8  sequence     uint32, grows on every frame
+// 12  battery      uint16, mV
+// 14  temperature  int16,  1/100 °C
+// 16  humidity     uint16, 1/100 %
+// 18  pressure     uint32, Pa
+// 22  MAC          first 8 bytes of HMAC-SHA256(report_key, bytes 0..21)
+#define FRAME_MAGIC0        'E'
+#define FRAME_MAGIC1        'L'
+#define FRAME_VERSION       1
+#define FRAME_DATA_SIZE     22
+#define FRAME_MAC_SIZE      8
+#define FRAME_SIZE          (FRAME_DATA_SIZE + FRAME_MAC_SIZE)
+
+#define FRAME_FLAG_EXTWAKE  0x01  // External wake up, or coalesced ones
+#define FRAME_FLAG_SENSOR   0x02  // Temperature, humidity, pressure are valid
+#define FRAME_FLAG_ACK      0x04  // Acknowledge requested
+
+// Acknowledge frame, sent back by the collector
+//  0  magic        'E' 'A'
+//  2  chip id      uint32
+//  6  sequence     uint32, the one acknowledged
+// 10  MAC          first 8 bytes of HMAC-SHA256(report_key, bytes 0..9)
+#define FRAME_ACK_MAGIC1    'A'
+#define FRAME_ACK_DATA_SIZE 10
+#define FRAME_ACK_SIZE      (FRAME_ACK_DATA_SIZE + FRAME_MAC_SIZE)
+
+uint8_t frameEncode(uint8_t * frame, uint32_t seq, uint8_t flags);
+bool frameCheckAck(const uint8_t * ack, uint8_t len, uint32_t seq);
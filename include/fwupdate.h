@@ -0,0 +1,12 @@
+#pragma once
+#include "common.h"
+
+// Firmware image is staged into SPIFFS, a few chunks per wake
+#define FW_UPDATE_FILE          "/fw.bin"
+#define FW_UPDATE_CHUNK_SIZE    8192    // HTTP Range request size
+#define FW_UPDATE_WAKE_BUDGET   4000    // Max time spent downloading per wake (ms)
+#define FW_UPDATE_MAX_FAILURES  3       // Drop the offer after that many bad images or wakes without progress
+
+void fwUpdateOffer(const char * ver, const char * url, uint32_t size, const char * md5);
+bool fwUpdatePending(void);
+void fwUpdateStep(uint32_t budget);
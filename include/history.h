@@ -0,0 +1,86 @@
+#pragma once
+#include "common.h"
+#include "sampler.h"
+
+// Sensor history kept on the board, for diagnosis in config mode without
+// the report server, see /history.json. Samples wait in the state for
+// HIST_PENDING wakes so SPIFFS is only mounted now and then, then go into
+// one ring file per resolution tier: raw samples, and min/mean/max rollups
+// per 10 min and per hour. Files have a fixed number of slots, the oldest
+// record is overwritten in place once full. Field builds keep no history.
+#define HIST_PENDING      8       // Samples buffered in the state
+#define HIST_FILE         "/hist%u.bin"
+#define HIST_MAGIC        0x4853  // File header magic, "SH"
+
+#define HIST_RAW          0       // Tiers
+#define HIST_10MIN        1
+#define HIST_1HOUR        2
+#define HIST_TIERS        3
+
+#define HIST_RAW_SLOTS    576     // 4 days of TPL5111 wakes
+#define HIST_10MIN_SLOTS  1008    // 7 days
+#define HIST_1HOUR_SLOTS  2160    // 90 days
+
+#define HIST_CHUNK        512     // /history.json is sent by chunks of about that size
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 14 bytes
+typedef struct
+{
+  uint32_t time;                    // 4   Unix time, or seconds since first boot if never set
+  _sample  s;                       // 10
+} _histrec;
+
+// 36 bytes
+typedef struct
+{
+  uint32_t time;                    // 4   Start of the period
+  uint16_t n;                       // 2   Samples
+  _sample  min;                     // 10
+  _sample  mean;                    // 10
+  _sample  max;                     // 10
+} _histroll;
+
+// 42 bytes
+// Rollup being built
+typedef struct
+{
+  uint32_t time;                    // 4   Start of the period
+  uint16_t n;                       // 2   Samples, 0 if none yet
+  _sample  min;                     // 10
+  _sample  max;                     // 10
+  int32_t  sum[4];                  // 16  Per channel, for the mean
+} _histacc;
+
+// 60 bytes
+// Ring file header, records follow it
+typedef struct
+{
+  uint16_t magic;                   // 2   HIST_MAGIC
+  uint8_t  tier;                    // 1   HIST_*
+  uint8_t  size;                    // 1   Record size
+  uint16_t slots;                   // 2   Records the file holds
+  uint16_t head;                    // 2   Next slot written
+  uint16_t count;                   // 2   Records
+  uint32_t last;                    // 4   Time of the last sample
+  _histacc acc;                     // 42  Rollup being built, unused for raw
+  uint32_t reserved;                // 4
+} _histhdr;
+
+// 118 bytes
+typedef struct
+{
+  uint32_t last;                    // 4   Time of the last sample, times never go back
+  uint8_t  count;                   // 1   Samples pending
+  _histrec pending[HIST_PENDING];   // 112 Not written to the files yet
+  uint8_t  done;                    // 1   Tiers written by a flush that failed on a later one
+} _histstate;
+
+#pragma pack(pop)
+
+void historyAdd(const _sample & s, uint8_t ago);
+bool historyFlush(void);
+int8_t historyTier(const char * res, uint32_t from);
+void historyJSON(uint8_t tier, uint32_t from, uint32_t to, String & r, void (* flush)(String & r));
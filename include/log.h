@@ -0,0 +1,91 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+
+// Levels, a record is only kept when its level is <= the runtime one
+#define LOG_ERROR         1   // Also saves the log into flash
+#define LOG_WARN          2
+#define LOG_INFO          3   // dbg*() macros
+#define LOG_DEBUG         4
+#define LOG_RAW           0x80  // Level flag, text is not a format
+
+// Compile time level, calls above it are not built in at all
+#ifndef LOG_LEVEL_MAX
+  #ifdef DEBUG
+    #define LOG_LEVEL_MAX LOG_DEBUG
+  #else
+    #define LOG_LEVEL_MAX LOG_WARN
+  #endif
+#endif
+#define LOG_LEVEL_DEFAULT LOG_INFO  // Runtime level when not configured
+
+#define LOG_RING_SIZE     1024  // Binary records kept in RAM
+#define LOG_REC_SIZE      64    // Biggest record
+#define LOG_TX_SIZE       512   // Text waiting for the UART, power of 2
+#define LOG_TX_FIFO_LOW   32    // UART FIFO refilled below this
+#define LOG_LINE_SIZE     128   // Biggest formatted record
+#define LOG_FLUSH_TIMEOUT 250   // Time given to the UART before powering off (ms)
+
+// Saved log in EEPROM (see state.h), 1024 bytes including CRC
+#define LOG_SAVE_SIZE     1012
+
+// One log record argument, converted from whatever was passed
+struct logArg
+{
+  char type;                  // 'i', 'u', 'f', 's' RAM string, 'P' flash string
+  union {
+    int32_t      i;
+    uint32_t     u;
+    float        f;
+    const char * s;
+  };
+  logArg()                  : type('i'), i(0) {}
+  logArg(bool v)            : type('i'), i(v) {}
+  logArg(char v)            : type('i'), i(v) {}
+  logArg(signed char v)     : type('i'), i(v) {}
+  logArg(unsigned char v)   : type('u'), u(v) {}
+  logArg(short v)           : type('i'), i(v) {}
+  logArg(unsigned short v)  : type('u'), u(v) {}
+  logArg(int v)             : type('i'), i(v) {}
+  logArg(unsigned int v)    : type('u'), u(v) {}
+  logArg(long v)            : type('i'), i(v) {}
+  logArg(unsigned long v)   : type('u'), u(v) {}
+  logArg(float v)           : type('f'), f(v) {}
+  logArg(double v)          : type('f'), f(v) {}
+  logArg(const char * v)    : type('s'), s(v) {}
+  logArg(const String & v)  : type('s'), s(v.c_str()) {}
+  logArg(const __FlashStringHelper * v) : type('P'), s((const char *) v) {}
+  logArg(const void * v)    : type('u'), u((uint32_t) (uintptr_t) v) {}
+};
+
+void logInit(void);
+void logSetLevel(uint8_t level);
+uint8_t logGetLevel(void);
+void logWrite(uint8_t level, PGM_P fmt, const logArg * args, uint8_t n);
+void logValue(const logArg & v);
+void logPump(void);
+void logFlush(uint16_t timeout);
+bool logSave(bool commit);
+bool logStaged(void);
+void logJSON(String & r);
+
+/* ======================================================================
+Function: logPrintf
+Purpose : log a formatted record
+Input   : level, format (PROGMEM), arguments
+Output  : -
+Comments: only the arguments are stored, formatting is done later when
+          the record is output
+====================================================================== */
+template<typename... A> inline void logPrintf(uint8_t level, PGM_P fmt, const A &... a)
+{
+  const logArg args[] = { logArg(), logArg(a)... };
+  logWrite(level, fmt, args + 1, sizeof...(a));
+}
+
+#define LOG_AT(level, fmt, ...) do { if ((level) <= LOG_LEVEL_MAX) \
+                                  logPrintf(level, PSTR(fmt), ##__VA_ARGS__); } while (0)
+#define logE(fmt, ...)  LOG_AT(LOG_ERROR, fmt, ##__VA_ARGS__)
+#define logW(fmt, ...)  LOG_AT(LOG_WARN,  fmt, ##__VA_ARGS__)
+#define logI(fmt, ...)  LOG_AT(LOG_INFO,  fmt, ##__VA_ARGS__)
+#define logD(fmt, ...)  LOG_AT(LOG_DEBUG, fmt, ##__VA_ARGS__)
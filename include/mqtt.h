@@ -0,0 +1,21 @@
+#pragma once
+#include "common.h"
+
+// Minimal MQTT 3.1.1 publisher
+#define MQTT_DEFAULT_PORT   1883
+#define MQTT_KEEPALIVE      60      // s, connection never lasts that long
+#define MQTT_BUFFER_SIZE    2048    // Whole CONNECT + PUBLISH burst, 32 samples included
+#define MQTT_TIMEOUT        2000    // CONNACK / PUBACK wait (ms)
+#define MQTT_TOPIC_SIZE     64
+#define MQTT_PUB_MAX        48      // PUBLISH packets in a burst, acknowledges mask is 64 bits
+
+// Packet types
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_DUP            0x08    // PUBLISH flag, sent again
+#define MQTT_QOS1           0x02
+#define MQTT_PUBACK         0x40
+#define MQTT_DISCONNECT     0xE0
+
+bool mqttReport(void);
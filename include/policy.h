@@ -0,0 +1,18 @@
+#pragma once
+#include "common.h"
+
+// Report policy flags
+#define POLICY_ENABLED    0x01  // Otherwise report on every wake
+#define POLICY_EXTWAKE    0x02  // Always report on external wake
+
+// Defaults when enabling the policy
+#define POLICY_DEFAULT_FLAGS      (POLICY_EXTWAKE)
+#define POLICY_DEFAULT_DTEMP      50    // 0.5 °C
+#define POLICY_DEFAULT_DHUM       300   // 3 %
+#define POLICY_DEFAULT_DPRESS     100   // 1 hPa
+#define POLICY_DEFAULT_VBATT_LOW  3400  // mV
+#define POLICY_DEFAULT_VBATT_CRIT 3300  // mV
+#define POLICY_DEFAULT_HEARTBEAT  36    // wakes
+
+bool policyShouldReport(void);
+void policyReported(void);
@@ -0,0 +1,23 @@
+#pragma once
+#include "common.h"
+
+#include <ESP8266WiFi.h>
+
+// Wake phases, each one runs with its own power profile
+#define POWER_PHASE_SENSOR    0   // Boot and sensor reading, radio not used yet
+#define POWER_PHASE_ASSOC     1   // WiFi association
+#define POWER_PHASE_TRANSFER  2   // Report and firmware transfer, ESP-NOW send
+
+// Power profiles
+#define POWER_PROFILE_MAX_SPEED   0   // 160MHz, full TX power, no modem sleep
+#define POWER_PROFILE_BALANCED    1   // 80MHz, 17dBm, modem sleep
+#define POWER_PROFILE_MIN_ENERGY  2   // 80MHz, 12dBm, light sleep
+#define POWER_PROFILE_CUSTOM      3   // As set in the configuration
+#define POWER_PROFILE_MAX         POWER_PROFILE_CUSTOM
+
+#define POWER_TX_MAX          82  // 20.5dBm in 1/4 dBm
+
+void powerApply(uint8_t profile, bool radio=true);
+void powerPhase(uint8_t phase);
+int8_t powerProfileByName(const char * name);
+const char * powerProfileName(uint8_t profile);
@@ -0,0 +1,24 @@
+#pragma once
+#include "common.h"
+
+// HTTP JSON report template, config.report_tpl. The text is literal bytes
+// with {name} placeholders, see tplNames in reporttpl.cpp. Any other brace
+// is literal, so JSON needs no escaping:
+//   {"id":"{id}","t":{temp},"h":{hum},"v":{vbatt},"wake":"{wake}"{events}}
+// It is compiled when set into the opcodes stored in config, the text
+// given back by /config.json is rebuilt from them:
+//   0x01-0x7F  literal byte
+//   0x80+n     placeholder n
+//   0xFF b     literal byte b, for UTF-8
+//   0x00       end, unless the opcodes fill the field
+// Each report then runs them into a fixed buffer, no parsing, no allocation
+#define TPL_OP_VALUE      0x80
+#define TPL_OP_BYTE       0xFF
+#define TPL_TEXT_SIZE     255     // Longest template text
+#define TPL_NAME_SIZE     8       // Longest placeholder name
+#define TPL_OUT_SIZE      512     // Rendered report buffer, on the stack
+
+bool tplCompile(const char * text, uint8_t * code, uint8_t size);
+void tplSource(const uint8_t * code, uint8_t size, char * buf);
+bool tplSamples(const uint8_t * code, uint8_t size);
+uint16_t tplRender(const uint8_t * code, uint8_t size, char * out, uint16_t len);
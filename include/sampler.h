@@ -0,0 +1,42 @@
+#pragma once
+#include "common.h"
+
+// Deep sleep scheduling, used instead of the TPL5111 when config.sleep.interval
+// is set. GPIO16 has to be wired to RST so the RTC timer can wake the chip.
+// Samples are kept in RTC user memory, which survives deep sleep but not
+// a power loss, and uploaded every config.sleep.flush wakes.
+#define SAMPLER_MAX           32    // Samples kept in RTC memory
+#define SAMPLER_RTC_OFFSET    32    // RTC user memory block (4 bytes), blocks below are left to eboot
+#define SAMPLER_RTC_BLOCKS    83    // Blocks used by the samples, the crash log goes after (log.cpp)
+#define SAMPLER_INTERVAL_MIN  10    // s
+#define SAMPLER_INTERVAL_MAX  3600  // s, below ESP.deepSleepMax()
+#define SAMPLER_CONFIG_TIME   300   // Config mode after a reset before sleeping again (s)
+#define SAMPLER_HOP_US        10000 // Reboot to turn the radio on (µs)
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 10 bytes
+typedef struct
+{
+  int16_t  temperature;             // 2   1/100 °C
+  uint16_t humidity;                // 2   1/100 %
+  uint32_t pressure;                // 4   Pa
+  uint16_t vbatt;                   // 2   mV
+} _sample;
+
+#pragma pack(pop)
+
+void samplerTake(_sample & s);
+bool samplerEnabled(void);
+bool samplerAdd(void);
+bool samplerTimerWake(void);
+uint16_t samplerTaken(void);
+void samplerReported(void);
+void samplerFlushed(bool reported);
+uint8_t samplerStretch(void);
+void samplerSleep(void);
+uint8_t samplerCount(void);
+const _sample * samplerGet(uint8_t i);
+const _sample * samplerNext(void);
+void samplerJSON(String & r);
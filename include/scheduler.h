@@ -0,0 +1,37 @@
+#pragma once
+#include "common.h"
+
+// Cooperative scheduler of config mode, loop() runs one pass of it.
+// Each pass runs all the I/O tasks due (OTA, HTTP), then at most one of
+// the other tasks due: the one with the best priority, then the earliest
+// due. So I/O waits at most for one slice of background work, which has
+// to keep its slices short and split longer work over several runs.
+#define SCHED_TASKS_MAX   8
+
+// Priorities, lower first
+#define SCHED_PRIO_IO       0   // Every pass, no slice limit
+#define SCHED_PRIO_SERVICE  1   // Housekeeping, short and frequent
+#define SCHED_PRIO_BACKGROUND 2 // Sampling, scans
+
+typedef void (* _schedfn)(void);
+
+// Task slot
+typedef struct
+{
+  const char * name;                // (PROGMEM)
+  _schedfn fn;
+  uint8_t  prio;                    // SCHED_PRIO_*
+  uint16_t period;                  // Run every (ms), 0 on every pass
+  uint16_t deadline;                // Late by more than this (ms) is a miss
+  uint32_t due;                     // Next run (millis())
+  uint32_t runs;
+  uint32_t missed;                  // Runs started after their deadline
+  uint32_t lateMax;                 // Worst start delay after due (ms)
+  uint32_t usMax;                   // Longest run (µs)
+  uint64_t usTotal;                 // Run time (µs)
+} _schedtask;
+
+bool schedAdd(PGM_P name, _schedfn fn, uint8_t prio, uint16_t period, uint16_t deadline);
+void schedDelay(uint16_t ms);
+void schedRun(void);
+void schedJSON(String & r);
@@ -0,0 +1,54 @@
+#pragma once
+#include "common.h"
+
+// Quantities known by the fixed layout reports (frame, samples, batch),
+// the first channel of each one also goes into sysinfo
+#define SENSOR_TEMPERATURE  0   // °C
+#define SENSOR_HUMIDITY     1   // %
+#define SENSOR_PRESSURE     2   // hPa
+#define SENSOR_OTHER        3   // Only in the JSON reports
+
+#define SENSOR_HAS_TEMPERATURE  (1 << SENSOR_TEMPERATURE)
+#define SENSOR_HAS_HUMIDITY     (1 << SENSOR_HUMIDITY)
+#define SENSOR_HAS_PRESSURE     (1 << SENSOR_PRESSURE)
+#define SENSOR_HAS_WEATHER      (SENSOR_HAS_TEMPERATURE | SENSOR_HAS_HUMIDITY | SENSOR_HAS_PRESSURE)
+
+#define SENSOR_CHANNELS_MAX 8
+#define SENSOR_TIMEOUT      500   // Conversions not done by then are dropped (ms)
+#define SENSOR_POLL_MS      5     // Config mode polling of the conversions (ms)
+#define SENSOR_REFRESH      10000 // Config mode refresh period (ms)
+
+// Channel descriptor, drivers keep them in flash
+typedef struct
+{
+  const char * key;                 // JSON key (PROGMEM)
+  const char * label;               // Web page label, with unit (PROGMEM)
+  uint8_t  quantity;                // SENSOR_*
+  uint8_t  decimals;                // Reported decimals
+} _sensorchannel;
+
+// Sensor driver, conversions of all drivers run at the same time:
+// begin() and startConversion() on each one, then poll() them all and
+// read() each one as soon as it is done
+class SensorDriver
+{
+public:
+  virtual bool begin(void) = 0;                       // false if not fitted
+  virtual void startConversion(void) = 0;
+  virtual bool poll(void) = 0;                        // true once converted
+  virtual bool read(float * values) = 0;              // one value per channel
+  virtual const _sensorchannel * channels(uint8_t & count) = 0; // PROGMEM table
+};
+
+// Drivers, see the registry in sensor.cpp
+SensorDriver * bme280Driver(void);
+
+void sensorsStart(void);
+void sensorsRefresh(void);
+bool sensorsPoll(void);
+void sensorsCollect(void);
+void sensorsTask(void);
+uint8_t sensorChannels(void);
+bool sensorGet(uint8_t i, _sensorchannel & desc, float & value);
+bool sensorHas(uint8_t quantities);
+void sensorJSON(String & r, uint8_t skip = 0);
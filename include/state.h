@@ -0,0 +1,148 @@
+#pragma once
+#include "common.h"
+#include "config.h"
+#include "stats.h"
+#include "timemodel.h"
+#include "battery.h"
+#include "events.h"
+#include "history.h"
+
+// Runtime state is stored into EEPROM right after the configuration block
+#define EEPROM_STATE_ADDR   (EEPROM_CFG_ADDR + sizeof(_Config))
+#define EEPROM_LOG_ADDR     (EEPROM_STATE_ADDR + sizeof(_State))  // Saved log, see log.h
+
+// Wake journal, TPL5111 mode. A commit erases the whole EEPROM flash sector
+// and only rewrites EEPROM_SIZE bytes, its end is left erased. A wake that
+// only changed the state from its sample is appended there as a record,
+// flash is programmed without erase, and replayed on the next wakes. The
+// state is only committed when something else changed or the journal is
+// full. RTC memory would not do: the TPL5111 cuts the power.
+#define STATE_SECTOR_SIZE   4096          // EEPROM flash sector
+#define STATE_JOURNAL_ADDR  EEPROM_SIZE   // Offset in the sector
+#define STATE_JOURNAL_RECS  ((STATE_SECTOR_SIZE - EEPROM_SIZE) / sizeof(_wakerec))
+#define STATE_JOURNAL_MAGIC 0xA5
+#define STATE_WAKE_EXTERNAL 0x01          // Wake record flags
+
+// Firmware update pulled from the report server
+#define FW_VERSION_SIZE     16
+#define FW_URL_SIZE         128
+#define FW_MD5_SIZE         32
+
+// TLS session resumption
+#define TLS_SESSION_SIZE    96      // >= sizeof(BearSSL::Session)
+#define TLS_MFLN_UNKNOWN    0       // Max Fragment Length support not probed yet
+#define TLS_MFLN_OK         1
+#define TLS_MFLN_NONE       2
+#define TLS_MFLN_SIZE       512     // TLS buffers when server supports MFLN
+
+// WiFi networks ranking, main network is index 0 then config fallbacks
+#define WIFI_NETWORKS       (1+CFG_NETWORKS)
+#define WIFI_HIST_BUCKETS   8       // Connection durations histogram, see wificonn.cpp
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 184 bytes
+typedef struct
+{
+  char     ver[FW_VERSION_SIZE+1];  // 17  Advertised firmware version
+  char     url[FW_URL_SIZE+1];      // 129 Image URL
+  char     md5[FW_MD5_SIZE+1];      // 33  Image MD5 (hex)
+  uint32_t size;                    // 4   Image size
+  uint8_t  failures;                // 1   Number of failed verifications
+} _fwupdate;
+
+// 97 bytes
+typedef struct
+{
+  uint8_t  mfln;                    // 1   Server Max Fragment Length support
+  uint8_t  session[TLS_SESSION_SIZE]; // 96 Last TLS session parameters
+} _tlsstate;
+
+// 10 bytes
+typedef struct
+{
+  uint16_t host_crc;                // 2   CRC16 of the resolved host name
+  uint32_t ip;                      // 4   Its address, 0 if none
+  uint32_t expire;                  // 4   Wake count after which it is stale
+} _dnscache;
+
+// 15 bytes
+// Last values successfully reported, for the report policy
+typedef struct
+{
+  uint32_t wake;                    // 4   Wake counter at that time, 0 if never
+  int16_t  temperature;             // 2   1/100 °C
+  uint16_t humidity;                // 2   1/100 %
+  uint32_t pressure;                // 4   Pa
+  uint8_t  batt_zone;               // 1   Battery threshold zone
+  uint16_t reserved;                // 2
+} _lastreport;
+
+// 9 bytes
+// What we learnt about a network on its last successful connection
+typedef struct
+{
+  uint8_t  bssid[6];                // 6   Access point, to skip the scan
+  uint8_t  channel;                 // 1   Its channel, 0 if unknown
+  int8_t   rssi;                    // 1   Signal (dBm), 0 if never connected
+  uint8_t  fails;                   // 1   Consecutive connection failures
+} _netrank;
+
+// 52 bytes
+typedef struct
+{
+  uint8_t  last;                    // 1   Last network connected, +1, 0 if none
+  _netrank net[WIFI_NETWORKS];      // 27
+  uint8_t  hist[WIFI_NETWORKS][WIFI_HIST_BUCKETS]; // 24 Connection durations
+} _wifistate;
+
+// 16 bytes, flash is written by 32 bit words
+// Wake journal record
+typedef struct
+{
+  uint8_t  magic;                   // 1   STATE_JOURNAL_MAGIC, 0xFF if free
+  uint8_t  flags;                   // 1   STATE_WAKE_*
+  _sample  s;                       // 10  Wake sample
+  uint16_t reserved;                // 2
+  uint16_t crc;                     // 2   CRC
+} _wakerec;
+
+// State saved into eeprom, survives power off
+// 1024 bytes total including CRC
+// The wake counter changes on every wake, the flash sector only on
+// commits, see the wake journal: count ~100k erase cycles over the board life.
+typedef struct
+{
+  uint32_t  wakes;                  //     4  Wake counter
+  _fwupdate fw;                     //   184  Pending firmware update
+  uint32_t  cfg_seq;                //     4  Last remote config delta applied
+  _tlsstate tls;                    //    97  HTTPS reporting
+  _dnscache dns;                    //    10  Report server address
+  uint32_t  seq;                    //     4  Last report frame sequence number
+  _lastreport last;                 //    15  Last report, for the report policy
+  _wifistate wifi;                  //    52  Known networks ranking
+  _stats    stats;                  //   164  Sensor statistics windows
+  _timestate time;                  //    28  Time model
+  _battstate batt;                  //    12  Battery charge tracking
+  _eventstate event;                //    42  External wakes not reported yet
+  _histstate hist;                  //   118  Samples not written to the history yet
+  uint16_t  mqtt_pid;               //     2  Last MQTT packet identifier
+  uint32_t  fw_seq;                 //     4  Last firmware offer accepted
+  uint8_t   filler[282];            //   282  room for new state, zeroed on first boot
+  uint16_t  crc;                    //     2  CRC
+} _State;                           // =1024
+
+// Exported variables/object instancied in main sketch
+// ===================================================
+extern _State state;
+
+#pragma pack(pop)
+
+// Declared exported function from state.cpp
+// ===================================================
+void stateInit(void);
+bool stateReplay(_wakerec & r);
+void stateWake(const _wakerec & r);
+void stateStage(void);
+bool stateSave(void);
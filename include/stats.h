@@ -0,0 +1,54 @@
+#pragma once
+#include "common.h"
+#include "sampler.h"
+
+// Streaming statistics of each sensor channel, over windows of samples
+// One sample per wake, or per deep sleep interval, see sampler.h
+#define STATS_TEMPERATURE   0
+#define STATS_HUMIDITY      1
+#define STATS_PRESSURE      2
+#define STATS_VBATT         3
+#define STATS_CHANNELS      4
+
+// Statistics flags
+#define STATS_PER_REPORT    0x01  // A new window also starts after each report
+#define STATS_REPLACE       0x02  // Report statistics instead of the last values
+
+#define STATS_WINDOW_MAX    10000 // Samples
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 20 bytes
+// Welford running mean and variance, values in sample units (see _sample)
+typedef struct
+{
+  float    mean;                    // 4   Running mean
+  float    m2;                      // 4   Sum of squared differences from the mean
+  int32_t  min;                     // 4
+  int32_t  max;                     // 4
+  uint16_t min_at;                  // 2   Sample index in the window
+  uint16_t max_at;                  // 2
+} _statchan;
+
+// 82 bytes
+typedef struct
+{
+  uint16_t  n;                      // 2   Samples, 0 if empty
+  _statchan ch[STATS_CHANNELS];     // 80
+} _statswin;
+
+// 164 bytes
+typedef struct
+{
+  _statswin cur;                    // 82  Window being filled
+  _statswin done;                   // 82  Last full window, empty once reported
+} _stats;
+
+#pragma pack(pop)
+
+bool statsEnabled(void);
+void statsAdd(const _sample & s);
+void statsReported(void);
+bool statsReplace(void);
+void statsJSON(String & r);
@@ -0,0 +1,51 @@
+#pragma once
+#include "common.h"
+
+// Wall clock estimated from the last synchronisation and the number of
+// samples (ticks) since then, one tick per wake, or per deep sleep
+// interval. The tick period is calibrated from successive synchronisations
+// so SNTP is only needed when the estimated drift passes config.time.drift
+#define TIME_NTP_DEFAULT_SERVER "pool.ntp.org"
+#define TIME_NTP_DEFAULT_DRIFT  30      // s
+#define TIME_NTP_PORT           123
+#define TIME_NTP_TIMEOUT        1000    // ms
+#define TIME_NTP_PACKET_SIZE    48
+#define TIME_NTP_UNIX_OFFSET    2208988800UL  // 1900 to 1970
+#define TIME_NTP_BACKOFF_MAX    4       // Retry after up to 2^4 ticks
+
+#define TIME_SOURCE_NONE        0
+#define TIME_SOURCE_DATE        1       // HTTP Date header, 1s resolution
+#define TIME_SOURCE_SNTP        2
+
+#define TIME_CALIB_MIN_SECONDS  14400   // Calibration anchors at least 4h apart
+#define TIME_CALIB_RANGE        8       // Calibrated period within nominal +/- 1/8
+#define TIME_DRIFT_PPM_RAW      10000   // Uncertainty of the nominal period, 1%
+#define TIME_DRIFT_PPM_CAL      1000    // Uncertainty once calibrated, 0.1%
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 28 bytes
+typedef struct
+{
+  uint32_t ticks;                   // 4   Ticks since first boot
+  uint32_t epoch;                   // 4   Unix time at the start of the anchor tick, 0 if never set
+  uint32_t tick;                    // 4   Anchor tick
+  uint32_t cal_epoch;               // 4   Calibration anchor
+  uint32_t cal_tick;                // 4
+  uint32_t period;                  // 4   Calibrated tick period (ms), 0 if not yet
+  uint16_t nominal;                 // 2   Nominal period it was calibrated for (s)
+  uint8_t  source;                  // 1   TIME_SOURCE_* of the anchor
+  uint8_t  fails;                   // 1   Consecutive SNTP failures
+} _timestate;
+
+#pragma pack(pop)
+
+void timeWake(uint16_t ticks);
+uint32_t timePeriod(void);
+uint32_t timeNow(void);
+uint32_t timeError(void);
+void timeSet(uint32_t epoch, uint8_t source);
+bool timeHttpDate(const char * date);
+bool timeSync(void);
+void timeJSON(String & r);
@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+
+#define UDP_REPORT_TRIES  2   // First send plus one retry when acknowledge is enabled
+
+bool udpReport(void);
@@ -1,5 +1,8 @@
 #pragma once
 #include "common.h"
 
-bool httpPost(const char* host, const uint16_t port, char * url, uint8_t* payload=NULL, const size_t size=0);
+#define HTTP_TIMEOUT      5000    // Reply wait (ms)
+
+bool httpPost(const char* host, const uint16_t port, char * url, uint8_t* payload=NULL, const size_t size=0, String* reply=NULL);
+void reportHandleReply(String & reply);
 bool reportPost(void);
@@ -3,6 +3,9 @@
 #include <ESP8266WebServer.h>
 #include <FS.h>
 
+// Background refresh of /wifiscan.json networks (ms)
+#define WIFI_SCAN_PERIOD 30000
+
 // Web response max size
 #define RESPONSE_BUFFER_SIZE 4096
 
@@ -23,6 +26,9 @@ void getSysJSONData(String & r);
 void sysJSONTable(void);
 void getConfJSONData(String & r);
 void confJSONTable(void);
+void logJSONTable(void);
+void schedJSONTable(void);
+void historyJSONTable(void);
 void getSpiffsJSONData(String & r);
 void sendJSON(void);
 void wifiScanJSON(void);
@@ -0,0 +1,20 @@
+#pragma once
+#include "common.h"
+
+#include <ESP8266WiFi.h>
+
+#define WIFI_CONNECT_TIMEOUT    10000 // Whole connection budget (ms)
+#define WIFI_CANDIDATE_TIMEOUT  4000  // Budget of one network when others are left (ms)
+#define WIFI_FAIL_PENALTY       10    // Ranking dB lost per consecutive failure
+#define WIFI_RSSI_UNKNOWN       -100  // Ranking of a never connected network
+
+// Time out learnt from past connections of each network
+#define WIFI_HIST_PERCENTILE    90    // Connections that must fit in the time out (%)
+#define WIFI_HIST_MIN           8     // Samples needed before trusting the histogram
+#define WIFI_HIST_MAX           64    // Histogram halved past this, recent ones weigh more
+#define WIFI_HIST_DISTRUST      2     // Failures in a row sending back to default time outs
+#define WIFI_TIMEOUT_MARGIN     500   // Added to the percentile (ms)
+#define WIFI_TIMEOUT_SCAN       1500  // Added when the AP channel is unknown (ms)
+#define WIFI_TIMEOUT_MIN        1000  // Floor (ms)
+
+bool wifiConnect(void);
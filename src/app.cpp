@@ -2,12 +2,22 @@
 #include "ota.h"
 #include "webserver.h"
 #include "webclient.h"
+#include "state.h"
+#include "fwupdate.h"
+#include "espnowclient.h"
+#include "policy.h"
+#include "wificonn.h"
+#include "power.h"
+#include "sampler.h"
+#include "stats.h"
+#include "timemodel.h"
+#include "sensor.h"
+#include "battery.h"
+#include "events.h"
+#include "scheduler.h"
+#include "history.h"
 
-#include <SPI.h>
-#include <BME280SpiSw.h>
 
-
-bool wifiConnect(void);
 int WifiHandleConn(boolean setup = false);
 
 void configMode(void);
@@ -16,178 +26,254 @@ void configMode(void);
 #define pinDONE     15  // write this PIN HIGH to kill your own power
 #define pinWAKE     16 // check this pin right when you boot up to see if the external switch woke you up - will be LOW if externally woken
 
-#define pinSPI_CSn  04
-#define pinSPI_SCLK 14
-#define pinSPI_MOSI 13
-#define pinSPI_MISO 12
-
-#define VBATT_MIN 3.4
-
-BME280SpiSw::Settings bme_settings
-(
-  pinSPI_CSn, 
-  pinSPI_MOSI, 
-  pinSPI_MISO, 
-  pinSPI_SCLK,
-  BME280::OSR_X16, // Temp
-  BME280::OSR_X16, // Humidity
-  BME280::OSR_X16, // Pressure
-  BME280::Mode_Forced,
-  BME280::StandbyTime_1000ms,
-  BME280::Filter_16
-);
-BME280SpiSw bme(bme_settings);
-
 void powerOff(uint16_t d)
 {
   dbg_s("Poweroff attempt (uptime %lds) !" EOL,millis()/1000);
-  dbgFlush();
+  logFlush(LOG_FLUSH_TIMEOUT);
+  if (featureBootBench)
+  {
+    // One line for tools/boot_bench.py, whatever the debug settings
+    if (!featureDebug)
+      Serial.begin(115200);
+    Serial.printf("BOOT %lu us, WAKE %lu ms\n", sysinfo.bootUs, millis());
+    Serial.flush();
+  }
   digitalWrite(pinDONE, HIGH);
   delay(d);
   digitalWrite(pinDONE, LOW);
   delay(d);
 }
 
-void setup()
+/* ======================================================================
+Function: samplesFeed
+Purpose : give this wake samples to the statistics and the history
+Input   : -
+Output  : -
+Comments: deep sleep mode, the samples stored in RTC memory since
+          the last upload wake, oldest first
+====================================================================== */
+static void samplesFeed(void)
 {
-  system_update_cpu_freq(160);
+  const _sample * s[SAMPLER_MAX];
+  uint8_t n = 0;
 
+  while (n < SAMPLER_MAX && (s[n] = samplerNext()) != NULL)
+    n++;
+  for (uint8_t i=0; i<n; i++)
+  {
+    statsAdd(*s[i]);
+    historyAdd(*s[i], n - 1 - i);
+  }
+}
+
+/* ======================================================================
+Function: wakeApply
+Purpose : update the state with a TPL5111 wake
+Input   : its journal record
+Output  : true if an external wake was only recorded, see eventWake()
+Comments: this wake, or one replayed from the journal: it may only
+          depend on the record, the state and the config
+====================================================================== */
+static bool wakeApply(const _wakerec & r)
+{
+  bool ext = r.flags & STATE_WAKE_EXTERNAL;
+
+  state.wakes++;
+  // An external wake is off the TPL5111 period, its timer keeps running
+  timeWake(ext ? 0 : 1);
+  statsAdd(r.s);
+  historyAdd(r.s, 0);
+  batteryUpdate(r.s.vbatt);
+  return eventWake(ext);
+}
+
+void setup()
+{
+  sysinfo.bootUs = micros();
   pinMode(pinWAKE, INPUT); 
   sysinfo.extWake = digitalRead(pinWAKE) == LOW;
   pinMode(pinDONE, OUTPUT);
   pinMode(pinLED,  OUTPUT); // Low to turn LED on
 
-  sysinfo.vBatt = (4 - 3.5)/(712 - 621) ;
-  sysinfo.vBatt = analogRead(A0) * sysinfo.vBatt + (4 - sysinfo.vBatt * 712);
+  // Config first, it holds the power profiles
+  dbgInit();
+  cfgInit();
+  logSetLevel((config.config & CFG_DEBUG) ? LOG_DEBUG : config.log_level);
+  powerPhase(POWER_PHASE_SENSOR);
 
-#ifdef HAS_BME280
-  if(bme.begin())
+  // Sensors convert while the battery is measured
+  sensorsStart();
+
+  batteryRead();
+
+  sensorsCollect();
+
+  if (samplerEnabled())
   {
-    delay(100);
-    bme.read(sysinfo.pressure, sysinfo.temperature, sysinfo.humidity, 
-              BME280::TempUnit_Celsius, BME280::PresUnit_hPa);
-    
+    // GPIO16 is wired to RST for the RTC timer, it tells nothing
+    sysinfo.extWake = false;
+
+    // Sample only wake, radio is off, no flash write
+    if (!samplerAdd())
+      samplerSleep();
   }
-#endif
 
-  dbgInit();
-  cfgInit();
+  stateInit();
+  bool coalesced = false;
+  if (samplerEnabled())
+  {
+    state.wakes++;
+    timeWake(samplerTaken());
+    samplesFeed();
+    batteryUpdate(sysinfo.vBatt * 1000 + 0.5);
+    eventWake(false);
+  }
+  else
+  {
+    _wakerec r;
+
+    // Wakes journaled since the state was last committed, then this one
+    while (stateReplay(r))
+      wakeApply(r);
+    r.flags = sysinfo.extWake ? STATE_WAKE_EXTERNAL : 0;
+    samplerTake(r.s);
+    // A history flush writes SPIFFS, it must not be replayed
+    bool flush = state.hist.count >= HIST_PENDING;
+    coalesced = wakeApply(r);
+    if (!flush)
+      stateWake(r);
+  }
 
   digitalWrite(pinLED, LOW);
   
   dbgF(EOL"" EOL"==============" EOL);
   dbgF("App "); dbgF(__version); dbgF(EOL);
   dbg_s("Wake source: %s" EOL, sysinfo.extWake ? "External": "Timer"); 
-  dbg_s("vBatt: %f" EOL, sysinfo.vBatt);
-#ifdef HAS_BME280
-  dbg_s("T %+7.3f°C P %+7.3fhPa %6.2f%%Hum" EOL,
-          sysinfo.temperature, sysinfo.pressure, sysinfo.humidity);
-#endif
+  dbg_s("Boot to setup: %luus" EOL, sysinfo.bootUs);
+  dbg_s("vBatt: %f (%u%%)" EOL, sysinfo.vBatt, batterySoc() / 100);
+  for (uint8_t i = 0; i < sensorChannels(); i++)
+  {
+    _sensorchannel desc;
+    float value;
+    if (sensorGet(i, desc, value))
+      dbg_s("%S: %.3f" EOL, desc.label, value);
+  }
   dbgFlush();
 
-#ifndef ALWAYS_REPORT
-  if (sysinfo.extWake ||
-        sysinfo.vBatt < VBATT_MIN
-      ) 
-#endif
+  bool reported = false;
+  if (batterySkip())
+    dbg_s("Battery saving, wake %lu skipped" EOL, (unsigned long) state.wakes);
+  else if (coalesced)
+    dbg_s("External wake recorded, %u waiting" EOL, eventCount());
+  else if (featureAlwaysReport || samplerEnabled() || eventPending() || policyShouldReport() || fwUpdatePending())
   {
-    // Connect to Wifi
-    dbgF("Connect to Wifi" EOL);
-    if(wifiConnect())
+    bool espnow = config.report.proto == CFG_REPORT_PROTO_ESPNOW;
+    if (espnow && !espnowReady())
+    {
+      // Unset gateway, report as HTTP rather than to nobody
+      logW("ESP-NOW gateway not set, HTTP report" EOL);
+      espnow = false;
+    }
+    if (espnow)
     {
-      // Push
-      dbgF("Push notification");
-      if(!reportPost())
-        dbgF(" failed" EOL);
+      // Straight to the gateway, no association
+      powerPhase(POWER_PHASE_TRANSFER);
+      dbgF("Push ESP-NOW frame");
+      reported = espnowReport();
+      if(!reported)
+        logE(" failed" EOL);
+      else
+      {
+        policyReported();
+        eventReported();
+      }
       dbgF(EOL);
     }
+    else
+    {
+      // Connect to Wifi
+      dbgF("Connect to Wifi" EOL);
+      powerPhase(POWER_PHASE_ASSOC);
+      if(wifiConnect())
+      {
+        powerPhase(POWER_PHASE_TRANSFER);
+
+        // Only when the time estimate drifted too much
+        timeSync();
+
+        // Push
+        dbgF("Push notification");
+        reported = reportPost();
+        if(!reported)
+          logE(" failed" EOL);
+        else
+          policyReported();
+        dbgF(EOL);
+
+        // Firmware update advertised by the server, get some more of it
+        fwUpdateStep(FW_UPDATE_WAKE_BUDGET);
+      }
+      else
+        logE("No Wifi network" EOL);
+    }
   }
 
-  powerOff(250);
-  dbgF("Still up ! Switch to Config Mode" EOL);
+  logSave(false);
+  stateSave();
+  if (samplerEnabled())
+  {
+    samplerFlushed(reported);
+    if (samplerTimerWake())
+      samplerSleep();
+    dbgF("Reset in deep sleep mode ! Switch to Config Mode for a while" EOL);
+  }
+  else
+  {
+    powerOff(250);
+    dbgF("Still up ! Switch to Config Mode" EOL);
+  }
+  powerApply(POWER_PROFILE_MAX_SPEED);
   configMode();  
 }
 
 void loop()
 {
-  server.handleClient();
-  ArduinoOTA.handle();
-  //delay(10);
+  schedRun();
 }
 
-#define DEBUG_APP_WIFI
-
-bool wifiConnect(void)
+/* ======================================================================
+Function: otaTask, logTask, samplerTask
+Purpose : config mode tasks, see scheduler.h
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+static void otaTask(void)
 {
-  if (!(*config.ssid))
-    return false;
-  int ret = WiFi.status();
-
-  uint16_t timeout = 500; // 25 * 200 ms = 5 sec time out
-  #ifdef DEBUG_APP_WIFI
-  dbgF("Connecting to: ");
-  dbg(config.ssid);
-  dbgFlush();
-  #endif
-
-  WiFi.mode(WIFI_STA);
-  // Static Address ?
-  if(config.netcfg.ip[0] != 0)
-  {
-    IPAddress ip,gw,msk,dns;
-    ip.fromString(String(config.netcfg.ip));
-    gw.fromString(String(config.netcfg.gw));
-    msk.fromString(String(config.netcfg.msk));
-    dns.fromString(String(config.netcfg.dns));
-    #ifdef DEBUG_APP_WIFI
-    dbgF("Using static IP configuration" EOL);
-    dbg_s("  IP : %s" EOL,ip.toString().c_str());
-    dbg_s("  MSK: %s" EOL,msk.toString().c_str());
-    dbg_s("  GW : %s" EOL,gw.toString().c_str());
-    dbg_s("  DNS: %s" EOL,dns.toString().c_str());
-    #endif
-    WiFi.config(ip, dns, gw, msk); 
-  }
-
-  // Do wa have a PSK ?
-  if (*config.psk) {
-    // protected network
-    #ifdef DEBUG_APP_WIFI
-    dbgF(" with key '");
-    dbg(config.psk);
-    dbgF("'...");
-    dbgFlush();
-    #endif
-    WiFi.begin(config.ssid, config.psk);
-  } else {
-    // Open network
-    #ifdef DEBUG_APP_WIFI
-    dbgF("unsecure AP");
-    dbgFlush();
-    #endif
-    WiFi.begin(config.ssid);
-  }
+  ArduinoOTA.handle();
+}
 
-  while ( ((ret = WiFi.status()) != WL_CONNECTED) && timeout )
-  {
-    delay(20);
-    --timeout;
-  }
+static void logTask(void)
+{
+  logPump();
+}
 
-  // connected ? disable AP, client mode only
-  #ifdef DEBUG_APP_WIFI
-  if (ret == WL_CONNECTED)
-  {
-    dbgF("Connected!" EOL);
-    dbg_s("IP address   : %s" EOL, WiFi.localIP().toString().c_str());
-    dbg_s("MAC address  : %s" EOL, WiFi.macAddress().c_str());
-  }
-  #endif
-  return ret == WL_CONNECTED;
+static void samplerTask(void)
+{
+  // Deep sleep mode, back to sampling after a while
+  if (samplerEnabled() && millis() > SAMPLER_CONFIG_TIME * 1000UL)
+    samplerSleep();
 }
 
 void configMode(void)
 {
+#ifdef FIELD_BUILD
+  // Minimal loader: only OTA, flash the dev build to configure the board
+  WifiHandleConn(true);
+  otaInit();
+  schedAdd(PSTR("ota"), otaTask, SCHED_PRIO_IO, 0, 50);
+  dbgF("OTA loader started" EOL);
+#else
   // Set WiFi to station mode and disconnect from an AP if it was previously connected
   //WiFi.mode(WIFI_AP_STA);
   //WiFi.disconnect();
@@ -208,18 +294,26 @@ void configMode(void)
       dbg_s("FS File: %s, size: %d\n", fileName.c_str(), fileSize);
     }
     dbgF(EOL);
+
+    // Recent samples readable at once from /history.json
+    historyFlush();
   }
 
   // start Wifi connect or soft AP
   WifiHandleConn(true);
 
   otaInit();
+  schedAdd(PSTR("ota"), otaTask, SCHED_PRIO_IO, 0, 50);
   webserverInit();
+  schedAdd(PSTR("sensors"), sensorsTask, SCHED_PRIO_BACKGROUND, SENSOR_REFRESH, 1000);
 
   // Display configuration
   cfgShow();
 
   dbgF("HTTP server started" EOL);
+#endif
+  schedAdd(PSTR("log"), logTask, SCHED_PRIO_SERVICE, 10, 100);
+  schedAdd(PSTR("sampler"), samplerTask, SCHED_PRIO_SERVICE, 1000, 1000);
 }
 
 int WifiHandleConn(boolean setup)
@@ -227,9 +321,9 @@ int WifiHandleConn(boolean setup)
   if (setup) 
   {
 
-    dbgF("========== SDK Saved parameters Start" EOL);
-    WiFi.printDiag(DEBUG_SERIAL);
-    dbgF("========== SDK Saved parameters End" EOL);
+    // SDK saved parameters, through the log rather than straight to the UART
+    logI("WiFi mode %d, channel %d, status %d, SDK SSID '%s'" EOL,
+         (int) WiFi.getMode(), WiFi.channel(), (int) WiFi.status(), WiFi.SSID());
     dbgFlush();
 
     // no correct SSID
@@ -0,0 +1,64 @@
+#include "config.h"
+#include "auth.h"
+
+#include <bearssl/bearssl.h>
+
+/* ======================================================================
+Function: authEnabled
+Purpose : tell if a shared key is configured
+Input   : -
+Output  : true if remote directives can be authenticated
+Comments: -
+====================================================================== */
+bool authEnabled(void)
+{
+  return *config.report_key != '\0';
+}
+
+/* ======================================================================
+Function: authHmac
+Purpose : compute the HMAC-SHA256 of a buffer with the shared key
+Input   : data, data size, MAC buffer and its size (truncated MAC)
+Output  : -
+Comments: -
+====================================================================== */
+void authHmac(const uint8_t * data, size_t len, uint8_t * mac, size_t mac_len)
+{
+  br_hmac_key_context kc;
+  br_hmac_context ctx;
+  uint8_t out[AUTH_HMAC_SIZE];
+
+  br_hmac_key_init(&kc, &br_sha256_vtable, config.report_key, strlen(config.report_key));
+  br_hmac_init(&ctx, &kc, 0);
+  br_hmac_update(&ctx, data, len);
+  br_hmac_out(&ctx, out);
+  memcpy(mac, out, min(mac_len, (size_t) AUTH_HMAC_SIZE));
+}
+
+/* ======================================================================
+Function: authCheckHex
+Purpose : check a buffer against an hexadecimal HMAC-SHA256
+Input   : data, data size, expected MAC as hex string
+Output  : true if key configured and MAC matches
+Comments: constant time comparison
+====================================================================== */
+bool authCheckHex(const uint8_t * data, size_t len, const char * hex)
+{
+  uint8_t mac[AUTH_HMAC_SIZE];
+  uint8_t diff = 0;
+  char    tmp[3];
+
+  if (!authEnabled() || strlen(hex) != 2 * AUTH_HMAC_SIZE)
+    return false;
+
+  authHmac(data, len, mac);
+
+  tmp[2] = '\0';
+  for (uint8_t i = 0; i < AUTH_HMAC_SIZE; i++)
+  {
+    tmp[0] = hex[2*i];
+    tmp[1] = hex[2*i+1];
+    diff |= mac[i] ^ (uint8_t) strtoul(tmp, NULL, 16);
+  }
+  return diff == 0;
+}
@@ -0,0 +1,194 @@
+#include "app.h"
+#include "sampler.h"
+#include "timemodel.h"
+#include "sensor.h"
+#include "batch.h"
+
+// Bit output of the heatshrink encoder, MSB first
+typedef struct
+{
+  uint8_t * p;
+  uint16_t  size;
+  uint16_t  len;
+  uint8_t   cur;
+  uint8_t   bits;
+} _bitwriter;
+
+/* ======================================================================
+Function: batchBits
+Purpose : output bits into the compressed stream
+Input   : writer, value, number of bits
+Output  : false if the output buffer is full
+Comments: -
+====================================================================== */
+static bool batchBits(_bitwriter & w, uint16_t v, uint8_t n)
+{
+  while (n--)
+  {
+    w.cur = (w.cur << 1) | ((v >> n) & 1);
+    if (++w.bits == 8)
+    {
+      if (w.len >= w.size)
+        return false;
+      w.p[w.len++] = w.cur;
+      w.cur = w.bits = 0;
+    }
+  }
+  return true;
+}
+
+/* ======================================================================
+Function: batchCompress
+Purpose : heatshrink compress a buffer
+Input   : data, its size, output buffer, its size
+Output  : compressed size, 0 if it does not fit
+Comments: whole buffer at once, so it is its own window and no
+          other RAM is needed. Back references shorter than 2 bytes
+          cost more than literals (13 bits vs 9 per byte)
+====================================================================== */
+static uint16_t batchCompress(const uint8_t * in, uint16_t len, uint8_t * out, uint16_t size)
+{
+  _bitwriter w = { out, size, 0, 0, 0 };
+  uint16_t i = 0;
+
+  while (i < len)
+  {
+    uint16_t lookahead = min(len - i, 1 << BATCH_HS_LOOKAHEAD);
+    uint16_t best = 0;
+    uint16_t offset = 0;
+
+    for (uint16_t j = i > (1 << BATCH_HS_WINDOW) ? i - (1 << BATCH_HS_WINDOW) : 0; j < i; j++)
+    {
+      uint16_t l = 0;
+      while (l < lookahead && in[j + l] == in[i + l])
+        l++;
+      if (l > best)
+      {
+        best = l;
+        offset = i - j;
+        if (l == lookahead)
+          break;
+      }
+    }
+
+    bool ok;
+    if (best >= 2)
+    {
+      ok = batchBits(w, 0, 1) &&
+           batchBits(w, offset - 1, BATCH_HS_WINDOW) &&
+           batchBits(w, best - 1, BATCH_HS_LOOKAHEAD);
+      i += best;
+    }
+    else
+    {
+      ok = batchBits(w, 1, 1) && batchBits(w, in[i], 8);
+      i++;
+    }
+    if (!ok)
+      return 0;
+  }
+
+  // Pad last byte with zeros, the decoder drops incomplete items
+  if (w.bits && !batchBits(w, 0, 8 - w.bits))
+    return 0;
+  return w.len;
+}
+
+/* ======================================================================
+Function: batchVarint
+Purpose : output a ZigZag varint
+Input   : destination, its end, signed value
+Output  : next destination byte, NULL if full
+Comments: small deltas of either sign take a single byte
+====================================================================== */
+static uint8_t * batchVarint(uint8_t * p, const uint8_t * end, int32_t v)
+{
+  uint32_t zz = ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+
+  do
+  {
+    if (p >= end)
+      return NULL;
+    *p++ = (zz & 0x7F) | (zz > 0x7F ? 0x80 : 0);
+    zz >>= 7;
+  } while (zz);
+  return p;
+}
+
+/* ======================================================================
+Function: batchEncode
+Purpose : encode the samples waiting in RTC memory
+Input   : batch buffer (BATCH_SIZE), true to compress
+Output  : batch size, 0 if the samples do not fit
+Comments: compressed data is only kept when smaller
+====================================================================== */
+uint16_t batchEncode(uint8_t * batch, bool compress)
+{
+  uint8_t raw[BATCH_SIZE];
+  uint8_t count = samplerCount();
+  uint8_t channels = BATCH_CH_VBATT;
+  uint32_t interval = (timePeriod() * samplerStretch() + 500) / 1000;
+  uint32_t time = timeNow();
+  uint8_t * p = raw;
+  uint32_t us = micros();
+
+  if (!count)
+    return 0;
+  if (sensorHas(SENSOR_HAS_TEMPERATURE))
+    channels |= BATCH_CH_TEMPERATURE;
+  if (sensorHas(SENSOR_HAS_HUMIDITY))
+    channels |= BATCH_CH_HUMIDITY;
+  if (sensorHas(SENSOR_HAS_PRESSURE))
+    channels |= BATCH_CH_PRESSURE;
+  if (time)
+    time -= millis() / 1000 + (count - 1) * interval;
+
+  // Channel after channel, deltas repeat better this way
+  for (uint8_t ch = BATCH_CH_TEMPERATURE; ch <= BATCH_CH_VBATT; ch <<= 1)
+  {
+    int32_t prev = 0;
+
+    if (!(channels & ch))
+      continue;
+    for (uint8_t i = 0; i < count && p; i++)
+    {
+      const _sample * s = samplerGet(i);
+      int32_t v = ch == BATCH_CH_TEMPERATURE ? s->temperature :
+                  ch == BATCH_CH_HUMIDITY    ? s->humidity :
+                  ch == BATCH_CH_PRESSURE    ? (int32_t) s->pressure : s->vbatt;
+      p = batchVarint(p, raw + BATCH_SIZE - BATCH_HEADER_SIZE, v - prev);
+      prev = v;
+    }
+    if (!p)
+      return 0;
+  }
+
+  uint16_t len = p - raw;
+  uint8_t flags = 0;
+  uint16_t packed = compress ? batchCompress(raw, len, batch + BATCH_HEADER_SIZE,
+                                             BATCH_SIZE - BATCH_HEADER_SIZE) : 0;
+  if (packed && packed < len)
+  {
+    flags |= BATCH_FLAG_HEATSHRINK;
+    len = packed;
+  }
+  else
+    memcpy(batch + BATCH_HEADER_SIZE, raw, len);
+
+  batch[0] = BATCH_MAGIC0;
+  batch[1] = BATCH_MAGIC1;
+  batch[2] = BATCH_VERSION;
+  batch[3] = flags;
+  uint32_t chip = ESP.getChipId();
+  memcpy(batch + 4, &chip, 4);
+  memcpy(batch + 8, &time, 4);
+  batch[12] = interval & 0xFF;
+  batch[13] = interval >> 8;
+  batch[14] = channels;
+  batch[15] = count;
+
+  // Encoding cost, to compare with the JSON report one
+  logD("Batch: %u samples, %u data bytes, %u sent, %luus" EOL, count,
+       (unsigned) (p - raw), len, (unsigned long) (micros() - us));
+  return BATCH_HEADER_SIZE + len;
+}
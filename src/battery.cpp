@@ -0,0 +1,220 @@
+#include "app.h"
+#include "state.h"
+#include "sampler.h"
+#include "timemodel.h"
+#include "battery.h"
+
+//#define DEBUG_BATTERY
+
+// LiPo open circuit voltage (mV) every 5% of charge, from 0 to 100%
+static const uint16_t battCurve[] PROGMEM =
+{
+  3270, 3610, 3690, 3710, 3730, 3750, 3770, 3790, 3800, 3820, 3840,
+  3850, 3870, 3910, 3950, 3980, 4020, 4080, 4110, 4150, 4200
+};
+#define BATT_CURVE_POINTS (sizeof(battCurve) / sizeof(battCurve[0]))
+#define BATT_CURVE_STEP   (10000 / (BATT_CURVE_POINTS - 1))  // 1/100 %
+
+/* ======================================================================
+Function: batteryAdc
+Purpose : read the battery ADC input
+Input   : -
+Output  : average of config.batt.oversample readings
+Comments: the fractional part is the oversampling extra resolution
+====================================================================== */
+float batteryAdc(void)
+{
+  uint8_t n = config.batt.oversample ? config.batt.oversample : BATT_DEFAULT_OVERSAMPLE;
+  uint32_t sum = 0;
+
+  for (uint8_t i = 0; i < n; i++)
+    sum += analogRead(A0);
+  return (float) sum / n;
+}
+
+/* ======================================================================
+Function: batteryRead
+Purpose : measure the battery voltage into sysinfo
+Input   : -
+Output  : -
+Comments: straight line through the two calibration points, defaults
+          are used until both are set apart
+====================================================================== */
+void batteryRead(void)
+{
+  const _battcfg & c = config.batt;
+  float adc = batteryAdc();
+
+  if (c.adc_hi != c.adc_lo)
+    sysinfo.vBatt = (c.mv_lo + (adc - c.adc_lo) * ((int32_t) c.mv_hi - c.mv_lo) / ((int32_t) c.adc_hi - c.adc_lo)) / 1000;
+  else
+    sysinfo.vBatt = (BATT_DEFAULT_MV_LO + (adc - BATT_DEFAULT_ADC_LO) * (BATT_DEFAULT_MV_HI - BATT_DEFAULT_MV_LO) /
+                     (BATT_DEFAULT_ADC_HI - BATT_DEFAULT_ADC_LO)) / 1000;
+
+  #ifdef DEBUG_BATTERY
+  dbg_s("Battery ADC %.2f: %.3fV" EOL, adc, sysinfo.vBatt);
+  #endif
+}
+
+/* ======================================================================
+Function: batteryCharge
+Purpose : state of charge of a LiPo cell
+Input   : open circuit voltage (mV)
+Output  : 1/100 %
+Comments: linear between the curve points
+====================================================================== */
+static uint16_t batteryCharge(uint16_t mv)
+{
+  uint16_t lo = pgm_read_word(&battCurve[0]);
+
+  if (mv <= lo)
+    return 0;
+  for (uint8_t i = 1; i < BATT_CURVE_POINTS; i++)
+  {
+    uint16_t hi = pgm_read_word(&battCurve[i]);
+    if (mv < hi)
+      return (i - 1) * BATT_CURVE_STEP + (uint32_t) (mv - lo) * BATT_CURVE_STEP / (hi - lo);
+    lo = hi;
+  }
+  return 10000;
+}
+
+/* ======================================================================
+Function: batterySoc
+Purpose : estimated state of charge
+Input   : -
+Output  : 1/100 %
+Comments: from the voltage smoothed over the wakes
+====================================================================== */
+uint16_t batterySoc(void)
+{
+  return batteryCharge(state.batt.mv ? state.batt.mv : sysinfo.vBatt * 1000);
+}
+
+/* ======================================================================
+Function: batteryStretch
+Purpose : report spacing for the current charge
+Input   : -
+Output  : 1 for every wake (or deep sleep upload), N for one in N
+Comments: grows linearly from 1 at config.batt.soc_low to
+          config.batt.stretch at config.batt.soc_crit
+====================================================================== */
+uint8_t batteryStretch(void)
+{
+  return state.batt.stretch ? state.batt.stretch : 1;
+}
+
+/* ======================================================================
+Function: batteryStretchAt
+Purpose : report spacing for a given charge
+Input   : state of charge (1/100 %)
+Output  : 1 for every wake, up to config.batt.stretch
+Comments: -
+====================================================================== */
+static uint8_t batteryStretchAt(uint16_t soc)
+{
+  const _battcfg & c = config.batt;
+
+  if (!c.soc_low || c.stretch <= 1 || soc >= c.soc_low * 100)
+    return 1;
+  if (soc <= c.soc_crit * 100 || c.soc_low <= c.soc_crit)
+    return c.stretch;
+  return 1 + ((uint32_t) (c.stretch - 1) * (c.soc_low * 100 - soc) +
+              (c.soc_low - c.soc_crit) * 50) / ((c.soc_low - c.soc_crit) * 100);
+}
+
+/* ======================================================================
+Function: batteryUpdate
+Purpose : track the charge over the wakes
+Input   : this wake voltage (mV)
+Output  : -
+Comments: called once the state is loaded. The discharge rate is
+          averaged over periods of BATT_RATE_SPAN, a charge restarts it.
+          The stretch goes down only once the charge is BATT_SOC_HYST
+          above the step, a charge sitting on it would flip every wake
+====================================================================== */
+void batteryUpdate(uint16_t mv)
+{
+  _battstate & b = state.batt;
+  uint32_t ticks = state.time.ticks;
+
+  // Light smoothing, ADC noise is about 10mV
+  if (!b.mv || abs((int32_t) mv - b.mv) > BATT_MV_JUMP)
+    b.mv = mv;
+  else
+    b.mv = (3UL * b.mv + mv + 2) / 4;
+
+  uint16_t soc = batterySoc();
+  if (!b.ref_tick || soc > b.ref_soc + BATT_SOC_CHARGE)
+  {
+    b.ref_soc = soc;
+    b.ref_tick = ticks;
+  }
+  else
+  {
+    uint32_t s = (uint64_t) (ticks - b.ref_tick) * timePeriod() / 1000;
+    if (s >= BATT_RATE_SPAN)
+    {
+      uint32_t r = (uint32_t) (soc < b.ref_soc ? b.ref_soc - soc : 0) * 86400 / s;
+      if (r > 0xFFFF)
+        r = 0xFFFF;
+      b.rate = b.rate ? (3UL * b.rate + r) / 4 : r;
+      b.ref_soc = soc;
+      b.ref_tick = ticks;
+    }
+  }
+
+  uint8_t stretch = batteryStretchAt(soc);
+  if (stretch < batteryStretch())
+  {
+    uint8_t hyst = batteryStretchAt(soc > BATT_SOC_HYST ? soc - BATT_SOC_HYST : 0);
+    stretch = hyst < batteryStretch() ? hyst : batteryStretch();
+  }
+  if (stretch != batteryStretch())
+    logI("Battery %u%%, one report every %u" EOL, soc / 100, stretch);
+  b.stretch = stretch;
+
+  #ifdef DEBUG_BATTERY
+  dbg_s("Battery %umV %u.%02u%% rate %u/day stretch %u" EOL, b.mv, soc / 100, soc % 100,
+        b.rate, stretch);
+  #endif
+}
+
+/* ======================================================================
+Function: batterySkip
+Purpose : check if this wake has to be skipped to save the battery
+Input   : -
+Output  : true if the radio has to stay off
+Comments: with the TPL5111 only, reports are at least batteryStretch()
+          wakes apart. External wakes are never skipped
+====================================================================== */
+bool batterySkip(void)
+{
+  if (samplerEnabled() || sysinfo.extWake || !state.last.wake)
+    return false;
+  return state.wakes - state.last.wake < batteryStretch();
+}
+
+/* ======================================================================
+Function: batteryJSON
+Purpose : append the battery estimates to a JSON report
+Input   : report being built, without its closing brace
+Output  : -
+Comments: ,"soc":%,"stretch":N then ,"discharge":%/day,"days":left
+          once the discharge rate is known
+====================================================================== */
+void batteryJSON(String & r)
+{
+  uint16_t soc = batterySoc();
+
+  r += F(",\"soc\":");
+  r += String(soc / 100.0, 1);
+  r += F(",\"stretch\":");
+  r += batteryStretch();
+  if (!state.batt.rate)
+    return;
+  r += F(",\"discharge\":");
+  r += String(state.batt.rate / 100.0, 2);
+  r += F(",\"days\":");
+  r += soc / state.batt.rate;
+}
@@ -0,0 +1,83 @@
+#include "app.h"
+#include "sensor.h"
+
+#include <SPI.h>
+#include <BME280SpiSw.h>
+
+#define pinSPI_CSn  04
+#define pinSPI_SCLK 14
+#define pinSPI_MOSI 13
+#define pinSPI_MISO 12
+
+// Forced mode conversion time with x16 oversampling everywhere (ms),
+// datasheet maximum 1.25 + 3 * 16 * 2.3 + 2 * 0.575
+#define BME280_CONVERSION_MS  113
+
+static const char bmeKey0[] PROGMEM = "temperature";
+static const char bmeKey1[] PROGMEM = "pressure";
+static const char bmeKey2[] PROGMEM = "humidity";
+static const char bmeLabel0[] PROGMEM = "Temperature (°C)";
+static const char bmeLabel1[] PROGMEM = "Pressure (hPa)";
+static const char bmeLabel2[] PROGMEM = "Humidity (%)";
+
+// Same order as BME280::read() values
+static const _sensorchannel bmeChannels[] PROGMEM =
+{
+  { bmeKey0, bmeLabel0, SENSOR_TEMPERATURE, 2 },
+  { bmeKey1, bmeLabel1, SENSOR_PRESSURE,    2 },
+  { bmeKey2, bmeLabel2, SENSOR_HUMIDITY,    2 },
+};
+
+BME280SpiSw::Settings bme_settings
+(
+  pinSPI_CSn,
+  pinSPI_MOSI,
+  pinSPI_MISO,
+  pinSPI_SCLK,
+  BME280::OSR_X16, // Temp
+  BME280::OSR_X16, // Humidity
+  BME280::OSR_X16, // Pressure
+  BME280::Mode_Forced,
+  BME280::StandbyTime_1000ms,
+  BME280::Filter_16
+);
+
+class BME280Sensor : public SensorDriver
+{
+public:
+  BME280Sensor() : bme(bme_settings), start(0) {}
+
+  // Writing the forced mode settings starts the first conversion
+  bool begin(void) { return bme.begin(); }
+  void startConversion(void) { start = millis(); }
+  bool poll(void) { return millis() - start >= BME280_CONVERSION_MS; }
+
+  bool read(float * values)
+  {
+    bme.read(values[1], values[0], values[2], BME280::TempUnit_Celsius, BME280::PresUnit_hPa);
+    return !isnan(values[0]);
+  }
+
+  const _sensorchannel * channels(uint8_t & count)
+  {
+    count = sizeof(bmeChannels) / sizeof(bmeChannels[0]);
+    return bmeChannels;
+  }
+
+private:
+  BME280SpiSw bme;
+  uint32_t start;
+};
+
+/* ======================================================================
+Function: bme280Driver
+Purpose : get the BME280 driver
+Input   : -
+Output  : driver
+Comments: -
+====================================================================== */
+SensorDriver * bme280Driver(void)
+{
+  static BME280Sensor driver;
+  return &driver;
+}
@@ -1,6 +1,17 @@
 #include "config.h"
+#include "policy.h"
+#include "power.h"
+#include "sampler.h"
+#include "stats.h"
+#include "timemodel.h"
+#include "batch.h"
+#include "battery.h"
+#include "events.h"
+#include "reporttpl.h"
+#include "state.h"
 
 #include <EEPROM.h>
+#include <IPAddress.h>
 
 // Configuration structure for whole program
 _Config config;
@@ -10,9 +21,9 @@ void cfgInit(void)
   // Clear our global flags
   config.config = 0;
 
-  // Our configuration is stored into EEPROM
+  // Our configuration is stored into EEPROM, followed by runtime state
   // EEPROM.begin(sizeof(_Config));
-  EEPROM.begin(1024);
+  EEPROM.begin(EEPROM_SIZE);
 
   dbgF("Config size="); dbg(sizeof(_Config));
   dbgF("  report=");   dbg(sizeof(_report));
@@ -84,67 +95,147 @@ void eepromDump(uint8_t bytesPerRow)
 }
 
 /* ======================================================================
-Function: readConfig
-Purpose : fill config structure with data located into eeprom
-Input 	: true if we need to clear actual struc in case of error
-Output	: true if config found and crc ok, false otherwise
-Comments: -
+Function: eepromReadBlock
+Purpose : fill a structure with data located into eeprom
+Input 	: eeprom address, structure, structure size (including trailing CRC)
+          true if we need to clear the structure in case of error
+Output	: true if block found and crc ok, false otherwise
+Comments: the last 2 bytes of the structure hold the CRC
 ====================================================================== */
-bool cfgRead(bool clear_on_error)
+bool eepromReadBlock(uint16_t addr, void * data, uint16_t size, bool clear_on_error)
 {
 	uint16_t crc = ~0;
-	uint8_t * pconfig = (uint8_t *) &config ;
-	uint8_t data ;
+	uint8_t * pdata = (uint8_t *) data ;
+	uint8_t b ;
 
-	// For whole size of config structure
-	for (uint16_t i = 0; i < sizeof(_Config); ++i) {
+	// For whole size of structure
+	for (uint16_t i = 0; i < size; ++i) {
 		// read data
-		data = EEPROM.read(i);
+		b = EEPROM.read(addr + i);
 
 		// save into struct
-		*pconfig++ = data ;
+		*pdata++ = b ;
 
 		// calc CRC
-		crc = crc16Update(crc, data);
+		crc = crc16Update(crc, b);
 	}
 
 	// CRC Error ?
 	if (crc != 0) {
-		// Clear config if wanted
+		// Clear struct if wanted
     if (clear_on_error)
-		  memset(&config, 0, sizeof( _Config ));
+		  memset(data, 0, size);
 		return false;
 	}
 
 	return true ;
 }
 
-bool cfgSave(void)
+/* ======================================================================
+Function: eepromWriteBlock
+Purpose : write a structure into eeprom, CRC is computed in its last 2 bytes
+Input 	: eeprom address, structure, structure size (including trailing CRC)
+          false to leave it in the buffer for the next commit
+Output	: -
+Comments: EEPROM.write() only flags the sector dirty on a real change,
+          so committing an unchanged block does not touch the flash
+====================================================================== */
+bool eepromWriteBlock(uint16_t addr, void * data, uint16_t size, bool commit)
 {
-  uint8_t * pconfig ;
-  bool ret_code;
-
-  //eepromDump(32);
+  uint8_t * pdata = (uint8_t *) data ;
+  uint16_t crc = ~0;
 
-  // Init pointer
-  pconfig = (uint8_t *) &config ;
+	// For whole size of structure, pre-calculate CRC
+  for (uint16_t i = 0; i < size - 2; ++i)
+    crc = crc16Update(crc, *pdata++);
 
-	// Init CRC
-  config.crc = ~0;
-
-	// For whole size of config structure, pre-calculate CRC
-  for (uint16_t i = 0; i < sizeof (_Config) - 2; ++i)
-    config.crc = crc16Update(config.crc, *pconfig++);
+  // Store CRC LSB first, so reading back the whole block gives 0
+  *pdata++ = crc & 0xFF;
+  *pdata   = crc >> 8;
 
 	// Re init pointer
-  pconfig = (uint8_t *) &config ;
+  pdata = (uint8_t *) data ;
 
-  // For whole size of config structure, write to EEP
-  for (uint16_t i = 0; i < sizeof(_Config); ++i)
-    EEPROM.write(i, *pconfig++);
+  // For whole size of structure, write to EEP
+  for (uint16_t i = 0; i < size; ++i)
+    EEPROM.write(addr + i, *pdata++);
 
   // Physically save
-  EEPROM.commit();
+  return commit ? EEPROM.commit() : true;
+}
+
+/* ======================================================================
+Function: readConfig
+Purpose : fill config structure with data located into eeprom
+Input 	: true if we need to clear actual struc in case of error
+Output	: true if config found and crc ok, false otherwise
+Comments: -
+====================================================================== */
+bool cfgRead(bool clear_on_error)
+{
+  return eepromReadBlock(EEPROM_CFG_ADDR, &config, sizeof(_Config), clear_on_error);
+}
+
+/* ======================================================================
+Function: cfgChanged
+Purpose : check if the configuration differs from the saved one
+Input   : -
+Output  : true if it has to be written
+Comments: fields changed are listed, a saved block with a bad CRC
+          always has to be written
+====================================================================== */
+static bool cfgChanged(void)
+{
+  const uint8_t * data = (const uint8_t *) &config;
+  uint16_t crc = ~0;
+  bool changed = false;
+  uint8_t b;
+
+  for (uint16_t i = 0; i < sizeof(_Config); i++) {
+    b = EEPROM.read(EEPROM_CFG_ADDR + i);
+    crc = crc16Update(crc, b);
+    if (i < offsetof(_Config, crc) && b != data[i])
+      changed = true;
+  }
+
+  if (crc)
+    return true;
+
+  if (featureDebug && changed) {
+    _cfgfield field;
+    for (uint8_t i = 0; cfgField(i, &field); i++) {
+      for (uint8_t j = 0; j < field.size; j++) {
+        if (EEPROM.read(EEPROM_CFG_ADDR + field.offset + j) != data[field.offset + j]) {
+          dbg_s("Changed %s" EOL, field.name);
+          break;
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+/* ======================================================================
+Function: cfgSave
+Purpose : write the configuration into eeprom
+Input   : -
+Output  : true if saved ok
+Comments: nothing is written when no field changed
+====================================================================== */
+bool cfgSave(void)
+{
+  bool ret_code;
+
+  if (!cfgChanged()) {
+    dbgF("Config unchanged" EOL);
+    return true;
+  }
+
+  //eepromDump(32);
+
+  // The commit erases the wake journal
+  stateStage();
+  eepromWriteBlock(EEPROM_CFG_ADDR, &config, sizeof(_Config));
 
   // Read Again to see if saved ok, but do
   // not clear if error this avoid clearing
@@ -156,7 +247,7 @@ bool cfgSave(void)
   if (ret_code)
     dbgF("OK!" EOL);
   else
-    dbgF("Error!" EOL);
+    logE("Error!" EOL);
 
   //eepromDump(32);
 
@@ -164,33 +255,323 @@ bool cfgSave(void)
   return (ret_code);
 }
 
+/* ======================================================================
+Function: cfgHash
+Purpose : hash of a configuration field name
+Input   : name, hash so far
+Output  : hash
+Comments: constexpr so that cfgFields[] holds it precomputed
+====================================================================== */
+static constexpr uint16_t cfgHash(const char * name, uint16_t hash = 5381)
+{
+  return *name ? cfgHash(name + 1, (uint16_t) (hash * 33) ^ (uint8_t) *name) : hash;
+}
+
+#define CFG_FIELD(name, member, type, flags, min, max) \
+  { name, cfgHash(name), offsetof(_Config, member), \
+    sizeof(((_Config *) 0)->member), type, flags, min, max }
+
+#define CFG_FIELD_NETWORK(i, n) \
+  CFG_FIELD("ssid" n,    networks[i].ssid, CFG_TYPE_STR, 0, 0, 0), \
+  CFG_FIELD("psk" n,     networks[i].psk,  CFG_TYPE_STR, 0, 0, 0), \
+  CFG_FIELD("net" n "_ip",  networks[i].ip,  CFG_TYPE_IP, 0, 0, 0), \
+  CFG_FIELD("net" n "_gw",  networks[i].gw,  CFG_TYPE_IP, 0, 0, 0), \
+  CFG_FIELD("net" n "_msk", networks[i].msk, CFG_TYPE_IP, 0, 0, 0), \
+  CFG_FIELD("net" n "_dns", networks[i].dns, CFG_TYPE_IP, 0, 0, 0)
+
+#define R CFG_FIELD_REMOTE
+
+// Web form and JSON fields, in the order of /config.json
+// WiFi, network and OTA settings are not remotely settable on purpose,
+// a bad value there would take the board off the network for good
+static const _cfgfield cfgFields[] PROGMEM =
+{
+  CFG_FIELD("ssid",             ssid,              CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("psk",              psk,               CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("host",             host,              CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("ap_psk",           ap_psk,            CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("ota_auth",         ota_auth,          CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("ota_port",         ota_port,          CFG_TYPE_UINT,  0, 1, 65535),
+  CFG_FIELD("net_ip",           netcfg.ip,         CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("net_gw",           netcfg.gw,         CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("net_msk",          netcfg.msk,        CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("net_dns",          netcfg.dns,        CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD_NETWORK(0, "1"),
+  CFG_FIELD_NETWORK(1, "2"),
+  CFG_FIELD("report_host",      report.host,       CFG_TYPE_STR,   R, 0, 0),
+  CFG_FIELD("report_port",      report.port,       CFG_TYPE_UINT,  R, 1, 65535),
+  CFG_FIELD("report_url",       report.url,        CFG_TYPE_STR,   R, 0, 0),
+  CFG_FIELD("report_msg",       report.msg,        CFG_TYPE_STR,   R, 0, 0),
+  CFG_FIELD("report_tpl",       report_tpl,        CFG_TYPE_TPL,   R, 0, 0),
+  CFG_FIELD("report_key",       report_key,        CFG_TYPE_STR,   0, 0, 0),
+  CFG_FIELD("report_proto",     report.proto,      CFG_TYPE_UINT,  R, 0, CFG_REPORT_PROTO_MAX),
+  CFG_FIELD("report_ack",       report_ack,        CFG_TYPE_UINT,  R, 0, 5000),
+  CFG_FIELD("report_batch",     report_batch,      CFG_TYPE_UINT,  R, BATCH_OFF, BATCH_MAX),
+  CFG_FIELD("espnow_mac",       espnow_mac,        CFG_TYPE_HEX,   0, 0, 0),
+  CFG_FIELD("espnow_channel",   espnow_channel,    CFG_TYPE_UINT,  0, 1, 14),
+  CFG_FIELD("policy_flags",     policy.flags,      CFG_TYPE_UINT,  R, 0, 255),
+  CFG_FIELD("policy_dtemp",     policy.dtemp,      CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("policy_dhum",      policy.dhum,       CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("policy_dpress",    policy.dpress,     CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("policy_vbatt_low", policy.vbatt_low,  CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("policy_vbatt_crit",policy.vbatt_crit, CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("policy_heartbeat", policy.heartbeat,  CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("power_sensor",     power.phase[POWER_PHASE_SENSOR],   CFG_TYPE_POWER, R, 0, 0),
+  CFG_FIELD("power_assoc",      power.phase[POWER_PHASE_ASSOC],    CFG_TYPE_POWER, R, 0, 0),
+  CFG_FIELD("power_transfer",   power.phase[POWER_PHASE_TRANSFER], CFG_TYPE_POWER, R, 0, 0),
+  CFG_FIELD("power_cpu",        power.custom.cpu,  CFG_TYPE_UINT,  R | CFG_FIELD_EITHER, 80, 160),
+  CFG_FIELD("power_tx",         power.custom.tx,   CFG_TYPE_UINT,  R, 0, POWER_TX_MAX),
+  CFG_FIELD("power_phy",        power.custom.phy,  CFG_TYPE_UINT,  R, WIFI_PHY_MODE_11B, WIFI_PHY_MODE_11N),
+  CFG_FIELD("power_sleep",      power.custom.sleep,CFG_TYPE_UINT,  R, WIFI_NONE_SLEEP, WIFI_MODEM_SLEEP),
+  CFG_FIELD("log_level",        log_level,         CFG_TYPE_UINT,  R, 0, LOG_DEBUG),
+  // Setting it remotely on a TPL5111 board is harmless, it still cuts power
+  CFG_FIELD("sleep_interval",   sleep.interval,    CFG_TYPE_UINT,  R | CFG_FIELD_ZERO, SAMPLER_INTERVAL_MIN, SAMPLER_INTERVAL_MAX),
+  CFG_FIELD("sleep_flush",      sleep.flush,       CFG_TYPE_UINT,  R, 1, SAMPLER_MAX),
+  CFG_FIELD("stats_window",     stats.window,      CFG_TYPE_UINT,  R, 0, STATS_WINDOW_MAX),
+  CFG_FIELD("stats_flags",      stats.flags,       CFG_TYPE_UINT,  R, 0, STATS_PER_REPORT | STATS_REPLACE),
+  CFG_FIELD("time_ntp",         time.ntp,          CFG_TYPE_STR,   R, 0, 0),
+  CFG_FIELD("time_drift",       time.drift,        CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("batt_adc_lo",      batt.adc_lo,       CFG_TYPE_UINT,  R, 0, 1023),
+  CFG_FIELD("batt_mv_lo",       batt.mv_lo,        CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("batt_adc_hi",      batt.adc_hi,       CFG_TYPE_UINT,  R, 0, 1023),
+  CFG_FIELD("batt_mv_hi",       batt.mv_hi,        CFG_TYPE_UINT,  R, 0, 65535),
+  CFG_FIELD("batt_oversample",  batt.oversample,   CFG_TYPE_UINT,  R, 1, BATT_OVERSAMPLE_MAX),
+  CFG_FIELD("batt_soc_low",     batt.soc_low,      CFG_TYPE_UINT,  R, 0, 100),
+  CFG_FIELD("batt_soc_crit",    batt.soc_crit,     CFG_TYPE_UINT,  R, 0, 100),
+  CFG_FIELD("batt_stretch",     batt.stretch,      CFG_TYPE_UINT,  R, 1, BATT_STRETCH_MAX),
+  CFG_FIELD("event_window",     event.window,      CFG_TYPE_UINT,  R, 0, 255),
+  CFG_FIELD("event_flags",      event.flags,       CFG_TYPE_UINT,  R, 0, EVENT_FIRST_NOW),
+  // Allows rolling the server certificate
+  CFG_FIELD("report_fp",        report_fp,         CFG_TYPE_HEX,   R, 0, 0),
+};
+
+#undef R
+
+#define CFG_FIELDS (sizeof(cfgFields) / sizeof(cfgFields[0]))
+
+/* ======================================================================
+Function: cfgField
+Purpose : get a configuration field descriptor
+Input   : index, where to copy the descriptor
+Output  : false past the last field
+Comments: for walking all the fields in /config.json order
+====================================================================== */
+bool cfgField(uint8_t index, _cfgfield * field)
+{
+  if (index >= CFG_FIELDS)
+    return false;
+  memcpy_P(field, &cfgFields[index], sizeof(_cfgfield));
+  return true;
+}
+
+/* ======================================================================
+Function: cfgFieldFind
+Purpose : get a configuration field descriptor by name
+Input   : web form field name, where to copy the descriptor
+Output  : false if there is no such field
+Comments: only descriptors with the same hash are copied and compared
+====================================================================== */
+bool cfgFieldFind(const char * name, _cfgfield * field)
+{
+  uint16_t hash = cfgHash(name);
+
+  for (uint8_t i = 0; i < CFG_FIELDS; i++)
+  {
+    if (pgm_read_word(&cfgFields[i].hash) != hash)
+      continue;
+    memcpy_P(field, &cfgFields[i], sizeof(_cfgfield));
+    if (!strcmp(field->name, name))
+      return true;
+  }
+  return false;
+}
+
+/* ======================================================================
+Function: cfgFieldSet
+Purpose : change a configuration field
+Input   : field descriptor, new value as posted by the web form
+Output  : false if the value is invalid, the field is then untouched
+Comments: only touches the config structure, caller has to cfgSave()
+====================================================================== */
+bool cfgFieldSet(const _cfgfield * field, const char * value)
+{
+  uint8_t * data = (uint8_t *) &config + field->offset;
+  char * end;
+  long itemp;
+  uint32_t addr;
+  IPAddress ip;
+
+  switch (field->type)
+  {
+    case CFG_TYPE_STR:
+      if (strlen(value) >= field->size) return false;
+      strncpy((char *) data, value, field->size);
+      return true;
+
+    case CFG_TYPE_UINT:
+      itemp = strtol(value, &end, 10);
+      if (!*value || *end) return false;
+      if (field->flags & CFG_FIELD_EITHER) {
+        if (itemp != field->min && itemp != field->max) return false;
+      } else if (itemp < field->min || itemp > field->max) {
+        if (itemp || !(field->flags & CFG_FIELD_ZERO)) return false;
+      }
+      // Both little endian, the low bytes of itemp
+      memcpy(data, &itemp, field->size);
+      return true;
+
+    case CFG_TYPE_HEX:
+      return hexToBytes(value, data, field->size);
+
+    case CFG_TYPE_IP:
+      if (*value && !ip.fromString(value)) return false;
+      addr = *value ? (uint32_t) ip : 0;
+      memcpy(data, &addr, sizeof(addr));
+      return true;
+
+    case CFG_TYPE_POWER:
+      itemp = powerProfileByName(value);
+      if (itemp < 0) return false;
+      *data = itemp;
+      return true;
+
+    case CFG_TYPE_TPL:
+      return tplCompile(value, data, field->size);
+  }
+  return false;
+}
+
+/* ======================================================================
+Function: cfgFieldValue
+Purpose : format a configuration field as the web form posts it
+Input   : field descriptor, buffer of CFG_FIELD_VALUE_SIZE bytes
+Output  : value, strings are not copied into the buffer
+Comments: -
+====================================================================== */
+const char * cfgFieldValue(const _cfgfield * field, char * buf)
+{
+  const uint8_t * data = (const uint8_t *) &config + field->offset;
+  uint32_t value = 0;
+
+  *buf = '\0';
+  switch (field->type)
+  {
+    case CFG_TYPE_STR:
+      return (const char *) data;
+
+    case CFG_TYPE_UINT:
+      memcpy(&value, data, field->size);
+      utoa(value, buf, 10);
+      break;
+
+    case CFG_TYPE_HEX:
+      bytesToHex(data, field->size, buf);
+      break;
+
+    case CFG_TYPE_IP:
+      memcpy(&value, data, sizeof(value));
+      if (value)
+        sprintf_P(buf, PSTR("%d.%d.%d.%d"), data[0], data[1], data[2], data[3]);
+      break;
+
+    case CFG_TYPE_POWER:
+      strcpy_P(buf, powerProfileName(*data));
+      break;
+
+    case CFG_TYPE_TPL:
+      tplSource(data, field->size, buf);
+      break;
+  }
+  return buf;
+}
+
 void cfgShow()
 {
-  dbgF("===== Wifi" EOL);
-  dbgF("ssid     :"); dbg(config.ssid); dbgF(EOL);
-  dbgF("psk      :"); dbg(config.psk); dbgF(EOL);
-  dbgF("host     :"); dbg(config.host); dbgF(EOL);
-  dbgF("ap_psk   :"); dbg(config.ap_psk); dbgF(EOL);
-  dbgF("===== Network" EOL);
-  dbgF("ip       :"); dbg(config.netcfg.ip); dbgF(EOL);
-  dbgF("netmask  :"); dbg(config.netcfg.msk); dbgF(EOL);
-  dbgF("gateway  :"); dbg(config.netcfg.gw); dbgF(EOL);
-  dbgF("dns      :"); dbg(config.netcfg.dns); dbgF(EOL);
-  dbgF("===== OTA" EOL);
-  dbgF("OTA auth :"); dbg(config.ota_auth); dbgF(EOL);
-  dbgF("OTA port :"); dbg(config.ota_port); dbgF(EOL);
+  _cfgfield field;
+  char buf[CFG_FIELD_VALUE_SIZE];
+
+  dbgF("===== Configuration" EOL);
+  for (uint8_t i = 0; cfgField(i, &field); i++)
+    dbg_s("%-17s:%s" EOL, field.name, cfgFieldValue(&field, buf));
   dbgF("===== System" EOL);
   dbgF("Config   :");
   if (config.config & CFG_DEBUG)   dbgF("DEBUG ");
   dbgF(EOL);
-  dbgF("===== POST Reporting" EOL);
-  dbgF("host     :"); dbg(config.report.host); dbgF(EOL);
-  dbgF("port     :"); dbg(config.report.port); dbgF(EOL);
-  dbgF("url      :"); dbg(config.report.url); dbgF(EOL);
-  dbgF("msg      :"); dbg(config.report.msg); dbgF(EOL);
+  dbgF("Log level:"); dbg(logGetLevel()); dbgF(EOL);
+}
 
+/* ======================================================================
+Function: cfgSetField
+Purpose : change one remotely settable configuration field
+Input   : form field name, new value
+Output  : false if field unknown, not remotely settable or value invalid
+Comments: only touches the config structure, caller has to cfgSave()
+====================================================================== */
+bool cfgSetField(const char * name, const char * value)
+{
+  _cfgfield field;
+
+  if (!cfgFieldFind(name, &field) || !(field.flags & CFG_FIELD_REMOTE))
+    return false;
+  return cfgFieldSet(&field, value);
 }
 
+/* ======================================================================
+Function: hexToBytes
+Purpose : parse an hexadecimal string such as a certificate fingerprint
+Input   : string ("" or "aa:bb:.." or "aabb.."), destination, its size
+Output  : false if the string does not hold exactly size bytes
+Comments: an empty string clears the destination
+====================================================================== */
+bool hexToBytes(const char * hex, uint8_t * data, uint8_t size)
+{
+  uint8_t tmp[32];
+  uint8_t n = 0;
+  char    byte[3] = { 0, 0, 0 };
+
+  if (!*hex) {
+    memset(data, 0, size);
+    return true;
+  }
+
+  while (*hex && n < sizeof(tmp)) {
+    if (*hex == ':' || *hex == ' ') {
+      hex++;
+      continue;
+    }
+    if (!isxdigit(hex[0]) || !isxdigit(hex[1]))
+      return false;
+    byte[0] = *hex++;
+    byte[1] = *hex++;
+    tmp[n++] = strtoul(byte, NULL, 16);
+  }
+
+  if (*hex || n != size)
+    return false;
+  memcpy(data, tmp, size);
+  return true;
+}
+
+/* ======================================================================
+Function: bytesToHex
+Purpose : format bytes as a colon separated hexadecimal string
+Input   : data, data size, destination (3*size bytes)
+Output  : -
+Comments: all zero data (not set) gives an empty string
+====================================================================== */
+void bytesToHex(const uint8_t * data, uint8_t size, char * hex)
+{
+  uint8_t i;
+
+  *hex = '\0';
+  for (i = 0; i < size && !data[i]; i++)
+    ;
+  if (i == size)
+    return;
+
+  for (i = 0; i < size; i++)
+    hex += sprintf_P(hex, i ? PSTR(":%02X") : PSTR("%02X"), data[i]);
+}
 
 void cfgReset(void)
 {
@@ -210,6 +591,35 @@ void cfgReset(void)
 
   strcpy_P(config.report.host, CFG_REPORT_DEFAULT_HOST);
   config.report.port = CFG_REPORT_DEFAULT_PORT;
+  config.report_ack = CFG_REPORT_DEFAULT_ACK;
+  config.espnow_channel = CFG_ESPNOW_DEFAULT_CHANNEL;
+
+  // Policy is disabled (report every wake), but ready to be turned on
+  config.policy.flags = POLICY_DEFAULT_FLAGS;
+  config.policy.dtemp = POLICY_DEFAULT_DTEMP;
+  config.policy.dhum = POLICY_DEFAULT_DHUM;
+  config.policy.dpress = POLICY_DEFAULT_DPRESS;
+  config.policy.vbatt_low = POLICY_DEFAULT_VBATT_LOW;
+  config.policy.vbatt_crit = POLICY_DEFAULT_VBATT_CRIT;
+  config.policy.heartbeat = POLICY_DEFAULT_HEARTBEAT;
+  // Custom power profile starts as max-speed
+  config.power.custom.cpu = 160;
+  config.power.custom.tx = POWER_TX_MAX;
+  config.power.custom.phy = WIFI_PHY_MODE_11N;
+  config.power.custom.sleep = WIFI_NONE_SLEEP;
+  // TPL5111 scheduling, deep sleep mode ready to be turned on
+  config.sleep.flush = CFG_SLEEP_DEFAULT_FLUSH;
+  config.stats.window = CFG_STATS_DEFAULT_WINDOW;
+  strcpy_P(config.time.ntp, PSTR(TIME_NTP_DEFAULT_SERVER));
+  config.time.drift = TIME_NTP_DEFAULT_DRIFT;
+  config.batt.adc_lo = BATT_DEFAULT_ADC_LO;
+  config.batt.mv_lo = BATT_DEFAULT_MV_LO;
+  config.batt.adc_hi = BATT_DEFAULT_ADC_HI;
+  config.batt.mv_hi = BATT_DEFAULT_MV_HI;
+  config.batt.oversample = BATT_DEFAULT_OVERSAMPLE;
+  config.batt.soc_low = BATT_DEFAULT_SOC_LOW;
+  config.batt.soc_crit = BATT_DEFAULT_SOC_CRIT;
+  config.batt.stretch = BATT_DEFAULT_STRETCH;
   strcpy_P(config.report.url, CFG_REPORT_DEFAULT_URL);
 
   // save back
@@ -0,0 +1,206 @@
+#include "app.h"
+#include "state.h"
+#include "dnscache.h"
+
+//#define DEBUG_DNS
+
+/* ======================================================================
+Function: dnsHostCrc
+Purpose : identify the cached host name
+Input   : host name
+Output  : CRC16 of the name
+Comments: -
+====================================================================== */
+static uint16_t dnsHostCrc(const char * host)
+{
+  uint16_t crc = ~0;
+  while (*host)
+    crc = crc16Update(crc, *host++);
+  return crc;
+}
+
+/* ======================================================================
+Function: dnsSkipName
+Purpose : skip an encoded domain name in a DNS message
+Input   : message, its size, current position
+Output  : position after the name, 0 on malformed message
+Comments: handles compression pointers
+====================================================================== */
+static uint16_t dnsSkipName(const uint8_t * msg, uint16_t len, uint16_t pos)
+{
+  while (pos < len)
+  {
+    if (!msg[pos])
+      return pos + 1;
+    if ((msg[pos] & 0xC0) == 0xC0)
+      return pos + 2;
+    pos += msg[pos] + 1;
+  }
+  return 0;
+}
+
+/* ======================================================================
+Function: dnsQuery
+Purpose : resolve an A record with its TTL
+Input   : host name, resolved address, TTL (s)
+Output  : true if resolved
+Comments: the system resolver does not expose the TTL, so do a minimal
+          recursive query to the DHCP/static DNS server ourselves. The
+          TTL is the smallest one along a CNAME chain.
+====================================================================== */
+static bool dnsQuery(const char * host, IPAddress & ip, uint32_t & ttl)
+{
+  uint8_t  msg[DNS_MSG_SIZE];
+  uint16_t id = RANDOM_REG32;
+  uint16_t len = 12, pos;
+  uint16_t answers;
+  uint32_t start;
+  WiFiUDP  udp;
+  const char * label = host;
+
+  if (strlen(host) > DNS_MSG_SIZE - 18)
+    return false;
+
+  // Header: id, recursion desired, 1 question
+  memset(msg, 0, len);
+  msg[0] = id >> 8;
+  msg[1] = id & 0xFF;
+  msg[2] = 0x01;
+  msg[5] = 1;
+
+  // Question: name as labels, type A, class IN
+  while (*label)
+  {
+    const char * dot = strchr(label, '.');
+    uint8_t n = dot ? dot - label : strlen(label);
+    msg[len++] = n;
+    memcpy(msg + len, label, n);
+    len += n;
+    label += n + (dot ? 1 : 0);
+  }
+  msg[len++] = 0;
+  msg[len++] = 0; msg[len++] = 1;
+  msg[len++] = 0; msg[len++] = 1;
+
+  if (!udp.begin(1024 + (RANDOM_REG32 & 0x7FFF)))
+    return false;
+  udp.beginPacket(WiFi.dnsIP(), DNS_PORT);
+  udp.write(msg, len);
+  if (!udp.endPacket())
+    return false;
+
+  start = millis();
+  while (!(len = udp.parsePacket()))
+  {
+    if (millis() - start > DNS_TIMEOUT)
+    {
+      udp.stop();
+      return false;
+    }
+    delay(1);
+  }
+  len = udp.read(msg, sizeof(msg));
+  udp.stop();
+
+  // Our reply, no error, not truncated
+  if (len < 12 || msg[0] != (id >> 8) || msg[1] != (id & 0xFF) ||
+      !(msg[2] & 0x80) || (msg[2] & 0x02) || (msg[3] & 0x0F))
+    return false;
+
+  answers = (msg[6] << 8) | msg[7];
+  pos = dnsSkipName(msg, len, 12);
+  if (!pos)
+    return false;
+  pos += 4;
+
+  ttl = DNS_MAX_TTL;
+  while (answers-- && pos && pos + 10 <= len)
+  {
+    pos = dnsSkipName(msg, len, pos);
+    if (!pos || pos + 10 > len)
+      return false;
+
+    uint16_t type  = (msg[pos] << 8) | msg[pos+1];
+    uint32_t rrttl = ((uint32_t) msg[pos+4] << 24) | ((uint32_t) msg[pos+5] << 16) |
+                     ((uint32_t) msg[pos+6] << 8) | msg[pos+7];
+    uint16_t rdlen = (msg[pos+8] << 8) | msg[pos+9];
+    pos += 10;
+
+    if (pos + rdlen > len)
+      return false;
+
+    ttl = min(ttl, rrttl);
+    if (type == 1 && rdlen == 4)
+    {
+      ip = IPAddress(msg[pos], msg[pos+1], msg[pos+2], msg[pos+3]);
+      return true;
+    }
+    pos += rdlen;
+  }
+  return false;
+}
+
+/* ======================================================================
+Function: dnsResolve
+Purpose : resolve a host name, through the flash cache when possible
+Input   : host name, resolved address
+Output  : true if resolved
+Comments: the cache expiry is counted in wakes, each one being worth
+          the TPL5111 period. A TTL of 0 is not cached
+====================================================================== */
+bool dnsResolve(const char * host, IPAddress & ip)
+{
+  uint16_t crc = dnsHostCrc(host);
+  uint32_t ttl = 0;
+
+  // Literal address, nothing to resolve
+  if (ip.fromString(host))
+    return true;
+
+  if (state.dns.ip && state.dns.host_crc == crc &&
+      (int32_t) (state.dns.expire - state.wakes) > 0)
+  {
+    ip = IPAddress(state.dns.ip);
+    #ifdef DEBUG_DNS
+    dbg_s("DNS cache: %s is %s" EOL, host, ip.toString().c_str());
+    #endif
+    return true;
+  }
+
+  if (!dnsQuery(host, ip, ttl))
+  {
+    // Fall back on the system resolver, unknown TTL
+    if (!WiFi.hostByName(host, ip))
+      return false;
+    ttl = DNS_DEFAULT_TTL;
+  }
+  ttl = min(ttl, (uint32_t) DNS_MAX_TTL);
+
+  #ifdef DEBUG_DNS
+  dbg_s("DNS: %s is %s, ttl %us" EOL, host, ip.toString().c_str(), ttl);
+  #endif
+
+  // Not to be kept, and no older address either
+  if (!ttl)
+  {
+    dnsInvalidate();
+    return true;
+  }
+
+  state.dns.host_crc = crc;
+  state.dns.ip = (uint32_t) ip;
+  state.dns.expire = state.wakes + ttl / WAKE_PERIOD;
+  return true;
+}
+
+/* ======================================================================
+Function: dnsInvalidate
+Purpose : drop the cached address
+Input   : -
+Output  : -
+Comments: to be called when connecting to the cached address failed
+====================================================================== */
+void dnsInvalidate(void)
+{
+  state.dns.ip = 0;
+}
@@ -0,0 +1,94 @@
+#include "app.h"
+#include "state.h"
+#include "frame.h"
+#include "espnowclient.h"
+
+extern "C" {
+#include <espnow.h>
+}
+
+//#define DEBUG_ESPNOW
+
+// Send status, written by the SDK callback
+static volatile uint8_t espnowStatus;
+
+#define ESPNOW_PENDING  0xFF
+
+/* ======================================================================
+Function: espnowSent
+Purpose : SDK send callback
+Input   : peer MAC, link layer status (0 acknowledged)
+Output  : -
+Comments: only the status of a frame to the configured gateway counts
+====================================================================== */
+static void espnowSent(uint8_t * mac, uint8_t status)
+{
+  if (!memcmp(mac, config.espnow_mac, sizeof(config.espnow_mac)))
+    espnowStatus = status;
+}
+
+/* ======================================================================
+Function: espnowReady
+Purpose : is the gateway set
+Input   : -
+Output  : false while espnow_mac is all zero, reports then go by HTTP
+Comments: -
+====================================================================== */
+bool espnowReady(void)
+{
+  for (uint8_t i = 0; i < sizeof(config.espnow_mac); i++)
+    if (config.espnow_mac[i])
+      return true;
+  return false;
+}
+
+/* ======================================================================
+Function: espnowReport
+Purpose : send sysinfo to the gateway with ESP-NOW
+Input   : -
+Output  : true if the gateway acknowledged the frame
+Comments: no association, no IP: the radio is only up for the frame and
+          its link layer acknowledge. Gateway MAC and WiFi channel come
+          from the configuration, the frame is the UDP one (frame.h).
+====================================================================== */
+bool espnowReport(void)
+{
+  uint8_t frame[FRAME_SIZE];
+  uint8_t len;
+  uint32_t start;
+
+  if (!espnowReady())
+    return false;
+
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();
+  wifi_set_channel(config.espnow_channel);
+
+  if (esp_now_init() != 0)
+    return false;
+  esp_now_set_self_role(ESP_NOW_ROLE_CONTROLLER);
+  esp_now_register_send_cb(espnowSent);
+  if (esp_now_add_peer(config.espnow_mac, ESP_NOW_ROLE_SLAVE, config.espnow_channel, NULL, 0) != 0)
+    return false;
+
+  len = frameEncode(frame, ++state.seq, 0);
+
+  for (uint8_t i = 0; i < ESPNOW_TRIES; i++)
+  {
+    espnowStatus = ESPNOW_PENDING;
+    if (esp_now_send(config.espnow_mac, frame, len) != 0)
+      continue;
+
+    start = millis();
+    while (espnowStatus == ESPNOW_PENDING && millis() - start < ESPNOW_TIMEOUT)
+      delay(1);
+
+    #ifdef DEBUG_ESPNOW
+    dbg_s("ESP-NOW frame #%u: %u after %lums" EOL, state.seq, espnowStatus, millis() - start);
+    #endif
+    if (espnowStatus == 0)
+      return true;
+  }
+  return false;
+}
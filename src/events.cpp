@@ -0,0 +1,159 @@
+#include "app.h"
+#include "state.h"
+#include "sampler.h"
+#include "timemodel.h"
+#include "events.h"
+
+//#define DEBUG_EVENT
+
+static bool eventFlush;             // Events have to be reported on this wake
+
+/* ======================================================================
+Function: eventRecord
+Purpose : record this external wake
+Input   : -
+Output  : -
+Comments: counts saturate, a burst is only started after a timer wake
+          or a report. Stamped with the time of the wake, not of now:
+          it is replayed from the wake journal, see state.h
+====================================================================== */
+static void eventRecord(void)
+{
+  _eventstate & e = state.event;
+
+  if ((!e.bursts || e.split) && e.bursts < EVENT_BURSTS)
+  {
+    e.burst[e.bursts].time = timeNow() ? timeNow() - millis() / 1000 : 0;
+    e.burst[e.bursts].count = 0;
+    e.bursts++;
+  }
+  e.split = 0;
+  if (e.burst[e.bursts - 1].count < 0xFFFF)
+    e.burst[e.bursts - 1].count++;
+  if (e.count < 0xFFFF)
+    e.count++;
+}
+
+/* ======================================================================
+Function: eventWake
+Purpose : handle the wake source for the coalescing window
+Input   : true for an external wake
+Output  : true if this wake was only recorded and must not report
+Comments: called once the state is loaded. A timer wake may close the
+          window, its events are then reported, see eventPending()
+====================================================================== */
+bool eventWake(bool ext)
+{
+  _eventstate & e = state.event;
+  bool coalesced = false;
+
+  eventFlush = false;
+  if (!config.event.window || samplerEnabled())
+  {
+    // Switched off with events left, send them
+    e.open = 0;
+    eventFlush = e.count != 0;
+    return false;
+  }
+
+  if (ext)
+  {
+    eventRecord();
+    if (e.open)
+      coalesced = true;
+    else
+    {
+      e.open = 1;
+      e.timers = 0;
+      if (config.event.flags & EVENT_FIRST_NOW)
+        eventFlush = true;
+      else
+        coalesced = true;
+    }
+  }
+  else
+  {
+    e.split = 1;
+    if (e.open && ++e.timers >= config.event.window)
+      e.open = 0;
+    eventFlush = !e.open && e.count;
+  }
+
+  #ifdef DEBUG_EVENT
+  dbg_s("Events: %u in %u bursts, window %s%s" EOL, e.count, e.bursts,
+        e.open ? "open" : "closed", coalesced ? ", coalesced" : "");
+  #endif
+  return coalesced;
+}
+
+/* ======================================================================
+Function: eventPending
+Purpose : check if events have to be reported on this wake
+Input   : -
+Output  : true when a window closed, or on the event opening one in
+          EVENT_FIRST_NOW mode
+Comments: they are also sent along with any other report
+====================================================================== */
+bool eventPending(void)
+{
+  return eventFlush;
+}
+
+/* ======================================================================
+Function: eventCount
+Purpose : number of events not reported yet
+Input   : -
+Output  : count, this wake one included
+Comments: -
+====================================================================== */
+uint16_t eventCount(void)
+{
+  return state.event.count;
+}
+
+/* ======================================================================
+Function: eventReported
+Purpose : forget the events successfully reported
+Input   : -
+Output  : -
+Comments: the window stays as it is
+====================================================================== */
+void eventReported(void)
+{
+  _eventstate & e = state.event;
+
+  e.count = 0;
+  e.bursts = 0;
+  eventFlush = false;
+}
+
+/* ======================================================================
+Function: eventJSON
+Purpose : append the events to a JSON report
+Input   : report being built, without its closing brace
+Output  : -
+Comments: ,"events":{"count":N,"bursts":[[time,count],..]} oldest first,
+          nothing if no event is waiting
+====================================================================== */
+void eventJSON(String & r)
+{
+  const _eventstate & e = state.event;
+
+  if (!e.count)
+    return;
+
+  r += F(",\"events\":{\"count\":");
+  r += e.count;
+  r += F(",\"bursts\":[");
+  for (uint8_t i = 0; i < e.bursts; i++)
+  {
+    if (i)
+      r += ',';
+    r += '[';
+    r += e.burst[i].time;
+    r += ',';
+    r += e.burst[i].count;
+    r += ']';
+  }
+  r += F("]}");
+}
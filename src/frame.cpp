@@ -0,0 +1,84 @@
+#include "app.h"
+#include "auth.h"
+#include "frame.h"
+#include "sensor.h"
+#include "events.h"
+
+/* ======================================================================
+Function: framePut
+Purpose : store a little endian value into a frame
+Input   : destination, value, size in bytes
+Output  : -
+Comments: -
+====================================================================== */
+static void framePut(uint8_t * p, uint32_t v, uint8_t size)
+{
+  while (size--)
+  {
+    *p++ = v & 0xFF;
+    v >>= 8;
+  }
+}
+
+/* ======================================================================
+Function: frameEncode
+Purpose : build a binary report frame out of sysinfo
+Input   : frame buffer (FRAME_SIZE), sequence number, extra flags
+Output  : frame size
+Comments: the MAC is left zeroed when no shared key is configured
+====================================================================== */
+uint8_t frameEncode(uint8_t * frame, uint32_t seq, uint8_t flags)
+{
+  memset(frame, 0, FRAME_SIZE);
+
+  if (sysinfo.extWake || eventCount())
+    flags |= FRAME_FLAG_EXTWAKE;
+  if (sensorHas(SENSOR_HAS_WEATHER))
+    flags |= FRAME_FLAG_SENSOR;
+
+  frame[0] = FRAME_MAGIC0;
+  frame[1] = FRAME_MAGIC1;
+  frame[2] = FRAME_VERSION;
+  frame[3] = flags;
+  framePut(frame + 4,  ESP.getChipId(), 4);
+  framePut(frame + 8,  seq, 4);
+  framePut(frame + 12, (uint16_t) (sysinfo.vBatt * 1000 + 0.5), 2);
+  if (sensorHas(SENSOR_HAS_WEATHER))
+  {
+    framePut(frame + 14, (uint16_t) (int16_t) lroundf(sysinfo.temperature * 100), 2);
+    framePut(frame + 16, (uint16_t) lroundf(sysinfo.humidity * 100), 2);
+    framePut(frame + 18, (uint32_t) lroundf(sysinfo.pressure * 100), 4);
+  }
+
+  if (authEnabled())
+    authHmac(frame, FRAME_DATA_SIZE, frame + FRAME_DATA_SIZE, FRAME_MAC_SIZE);
+
+  return FRAME_SIZE;
+}
+
+/* ======================================================================
+Function: frameCheckAck
+Purpose : check a datagram is the collector acknowledge of our frame
+Input   : received datagram, its size, sequence number expected
+Output  : true if it acknowledges that frame
+Comments: the MAC is only checked when a shared key is configured
+====================================================================== */
+bool frameCheckAck(const uint8_t * ack, uint8_t len, uint32_t seq)
+{
+  uint8_t expected[FRAME_ACK_SIZE];
+
+  if (len != FRAME_ACK_SIZE)
+    return false;
+
+  memset(expected, 0, sizeof(expected));
+  expected[0] = FRAME_MAGIC0;
+  expected[1] = FRAME_ACK_MAGIC1;
+  framePut(expected + 2, ESP.getChipId(), 4);
+  framePut(expected + 6, seq, 4);
+  if (authEnabled())
+    authHmac(expected, FRAME_ACK_DATA_SIZE, expected + FRAME_ACK_DATA_SIZE, FRAME_MAC_SIZE);
+  else
+    memcpy(expected + FRAME_ACK_DATA_SIZE, ack + FRAME_ACK_DATA_SIZE, FRAME_MAC_SIZE);
+
+  return !memcmp(expected, ack, FRAME_ACK_SIZE);
+}
@@ -0,0 +1,272 @@
+#include "app.h"
+#include "state.h"
+#include "fwupdate.h"
+
+#include <ESP8266HTTPClient.h>
+#include <MD5Builder.h>
+
+#define DEBUG_FW_UPDATE
+
+/* ======================================================================
+Function: fwUpdateClear
+Purpose : forget about the update and its staged image
+Input   : -
+Output  : -
+Comments: SPIFFS must be mounted
+====================================================================== */
+static void fwUpdateClear(void)
+{
+  memset(&state.fw, 0, sizeof(_fwupdate));
+  SPIFFS.remove(FW_UPDATE_FILE);
+}
+
+/* ======================================================================
+Function: fwUpdateFits
+Purpose : check there is room for an image
+Input   : image size
+Output  : true if it fits in SPIFFS, where it is staged, and in the
+          sketch space, where it is flashed
+Comments: SPIFFS must be mounted, the image staged for a previous offer
+          is counted as free since it is dropped
+====================================================================== */
+static bool fwUpdateFits(uint32_t size)
+{
+  FSInfo info;
+  uint32_t staged = 0;
+
+  if (size > ESP.getFreeSketchSpace() || !SPIFFS.info(info))
+    return false;
+
+  File f = SPIFFS.open(FW_UPDATE_FILE, "r");
+  if (f)
+  {
+    staged = f.size();
+    f.close();
+  }
+  return size <= info.totalBytes - info.usedBytes + staged;
+}
+
+/* ======================================================================
+Function: fwUpdateOffer
+Purpose : record a firmware update advertised by the report server
+Input   : version, image URL, image size and MD5 (hex)
+Output  : -
+Comments: the download itself is done by fwUpdateStep(), a new offer
+          (other version or URL) restarts the download from scratch.
+          An image that could not be staged or flashed is refused now,
+          rather than after downloading it over many wakes
+====================================================================== */
+void fwUpdateOffer(const char * ver, const char * url, uint32_t size, const char * md5)
+{
+  // Already running it, drop what is left of its download. Without an
+  // offer recorded no image can be staged, SPIFFS is not even mounted
+  if (!strcmp(ver, __version))
+  {
+    if (*state.fw.ver)
+    {
+      if (SPIFFS.begin())
+        fwUpdateClear();
+      else
+        memset(&state.fw, 0, sizeof(_fwupdate));
+    }
+    return;
+  }
+
+  // Same offer, keep going where we stopped
+  if (!strcmp(ver, state.fw.ver) && !strcmp(url, state.fw.url))
+    return;
+
+  if (!size || strlen(md5) != FW_MD5_SIZE ||
+      strlen(ver) > FW_VERSION_SIZE || strlen(url) > FW_URL_SIZE)
+  {
+    dbgF("Firmware offer ignored" EOL);
+    return;
+  }
+
+  if (!SPIFFS.begin() || !fwUpdateFits(size))
+  {
+    logW("Firmware %s does not fit (%u bytes)" EOL, ver, size);
+    return;
+  }
+
+  dbg_s("Firmware %s offered (%u bytes)" EOL, ver, size);
+  memset(&state.fw, 0, sizeof(_fwupdate));
+  strcpy(state.fw.ver, ver);
+  strcpy(state.fw.url, url);
+  strcpy(state.fw.md5, md5);
+  state.fw.size = size;
+
+  // Drop any image staged for a previous offer
+  SPIFFS.remove(FW_UPDATE_FILE);
+}
+
+/* ======================================================================
+Function: fwUpdatePending
+Purpose : tell if a firmware update download is in progress
+Input   : -
+Output  : true if an offer is pending
+Comments: an offer whose image failed too many times stays recorded
+          so that the server advertising it again is ignored
+====================================================================== */
+bool fwUpdatePending(void)
+{
+  return *state.fw.ver != '\0' && state.fw.failures < FW_UPDATE_MAX_FAILURES;
+}
+
+/* ======================================================================
+Function: fwUpdateFetch
+Purpose : append the next chunk of the image to the staged file
+Input   : staged file, time limit (millis)
+Output  : false on HTTP error
+Comments: uses a Range request, partial chunks count as progress
+====================================================================== */
+static bool fwUpdateFetch(File & f, uint32_t deadline)
+{
+  WiFiClient client;
+  HTTPClient http;
+  uint8_t buf[512];
+  uint32_t from = f.size();
+  uint32_t to = min(from + FW_UPDATE_CHUNK_SIZE, state.fw.size) - 1;
+  int len, code;
+
+  if (!http.begin(client, state.fw.url))
+    return false;
+
+  sprintf_P((char *) buf, PSTR("bytes=%u-%u"), from, to);
+  http.addHeader(F("Range"), (char *) buf);
+  code = http.GET();
+
+  // Servers ignoring Range are only usable for the first chunk
+  if (code != HTTP_CODE_PARTIAL_CONTENT && !(code == HTTP_CODE_OK && from == 0))
+  {
+    #ifdef DEBUG_FW_UPDATE
+    logW("Firmware fetch failed: %d" EOL, code);
+    #endif
+    http.end();
+    return false;
+  }
+
+  WiFiClient * stream = http.getStreamPtr();
+  len = to - from + 1;
+  while (len > 0 && http.connected() && (int32_t) (deadline - millis()) > 0)
+  {
+    size_t n = stream->available();
+    if (n)
+    {
+      n = stream->readBytes(buf, min(n, min(sizeof(buf), (size_t) len)));
+      f.write(buf, n);
+      len -= n;
+    }
+    else
+      delay(1);
+  }
+  f.flush();
+  http.end();
+  return true;
+}
+
+/* ======================================================================
+Function: fwUpdateInstall
+Purpose : check and flash the staged image, then reboot on it
+Input   : staged file
+Output  : false if the image is corrupted or could not be flashed
+Comments: the bootloader copy command lives in RTC memory, which the
+          TPL5111 power cut would lose, so restart right away
+====================================================================== */
+static bool fwUpdateInstall(File & f)
+{
+  MD5Builder md5;
+
+  f.seek(0, SeekSet);
+  md5.begin();
+  md5.addStream(f, f.size());
+  md5.calculate();
+  if (strcmp(md5.toString().c_str(), state.fw.md5))
+  {
+    dbgF("Firmware MD5 mismatch" EOL);
+    return false;
+  }
+
+  f.seek(0, SeekSet);
+  if (!Update.begin(state.fw.size) ||
+      !Update.setMD5(state.fw.md5) ||
+      Update.writeStream(f) != state.fw.size ||
+      !Update.end())
+  {
+    logE("Firmware update error %d" EOL, Update.getError());
+    return false;
+  }
+
+  dbg_s("Firmware %s installed, rebooting" EOL, state.fw.ver);
+  f.close();
+  fwUpdateClear();
+  stateSave();
+  dbgFlush();
+  ESP.restart();
+  return true;
+}
+
+/* ======================================================================
+Function: fwUpdateStep
+Purpose : make some progress on the pending firmware update
+Input   : time budget for this wake (ms)
+Output  : -
+Comments: WiFi must be connected, progress is the staged file itself.
+          A wake that could not add anything to it (server error, no
+          Range support, no connection) counts as a failure, so that an
+          image that can never be fetched is not retried on every wake
+====================================================================== */
+void fwUpdateStep(uint32_t budget)
+{
+  uint32_t deadline = millis() + budget;
+  uint32_t staged;
+
+  if (!fwUpdatePending())
+    return;
+
+  if (!SPIFFS.begin())
+  {
+    dbgF("SPIFFS Mount failed" EOL);
+    return;
+  }
+
+  File f = SPIFFS.open(FW_UPDATE_FILE, "a+");
+  if (!f)
+    return;
+
+  // Stale file from an aborted install, start over
+  if (f.size() > state.fw.size)
+  {
+    f.close();
+    SPIFFS.remove(FW_UPDATE_FILE);
+    f = SPIFFS.open(FW_UPDATE_FILE, "a+");
+    if (!f)
+      return;
+  }
+
+  staged = f.size();
+  while (f.size() < state.fw.size && (int32_t) (deadline - millis()) > 0)
+  {
+    if (!fwUpdateFetch(f, deadline))
+      break;
+  }
+
+  if (f.size() == staged && staged < state.fw.size)
+  {
+    ++state.fw.failures;
+    logW("Firmware %s: no progress, failure %u" EOL, state.fw.ver, state.fw.failures);
+  }
+
+  #ifdef DEBUG_FW_UPDATE
+  dbg_s("Firmware %s: %u/%u bytes" EOL, state.fw.ver, f.size(), state.fw.size);
+  #endif
+
+  if (f.size() == state.fw.size && !fwUpdateInstall(f))
+  {
+    f.close();
+    SPIFFS.remove(FW_UPDATE_FILE);
+    ++state.fw.failures;
+    return;
+  }
+  f.close();
+}
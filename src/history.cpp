@@ -0,0 +1,453 @@
+#include "app.h"
+#include "state.h"
+#include "history.h"
+#include "timemodel.h"
+
+//#define DEBUG_HISTORY
+
+// Per tier: records the file holds and rollup period (s), 0 for raw samples
+static const uint16_t histSlots[HIST_TIERS] PROGMEM = { HIST_RAW_SLOTS, HIST_10MIN_SLOTS, HIST_1HOUR_SLOTS };
+static const uint16_t histRes[HIST_TIERS] PROGMEM = { 0, 600, 3600 };
+
+/* ======================================================================
+Function: historyRecSize
+Purpose : size of a tier records
+Input   : tier
+Output  : bytes
+Comments: -
+====================================================================== */
+static uint8_t historyRecSize(uint8_t tier)
+{
+  return tier == HIST_RAW ? sizeof(_histrec) : sizeof(_histroll);
+}
+
+/* ======================================================================
+Function: historyOpen
+Purpose : open a tier ring file
+Input   : tier
+          header read
+          true to create it if missing or not valid
+Output  : file, closed if none
+Comments: a file left by another layout or cut short is started again
+====================================================================== */
+static File historyOpen(uint8_t tier, _histhdr & h, bool create)
+{
+  char name[16];
+  File f;
+
+  sprintf_P(name, PSTR(HIST_FILE), tier);
+  if (SPIFFS.exists(name))
+  {
+    f = SPIFFS.open(name, create ? "r+" : "r");
+    if (f && f.read((uint8_t *) &h, sizeof(h)) == sizeof(h) &&
+        h.magic == HIST_MAGIC && h.tier == tier && h.size == historyRecSize(tier) &&
+        h.slots == pgm_read_word(&histSlots[tier]) && h.head < h.slots && h.count <= h.slots &&
+        f.size() >= sizeof(h) + (uint32_t) h.count * h.size)
+      return f;
+    if (f)
+      f.close();
+    dbg_s("History: %s reset" EOL, name);
+  }
+  if (!create)
+    return File();
+
+  memset(&h, 0, sizeof(h));
+  h.magic = HIST_MAGIC;
+  h.tier = tier;
+  h.size = historyRecSize(tier);
+  h.slots = pgm_read_word(&histSlots[tier]);
+  f = SPIFFS.open(name, "w+");
+  if (f && f.write((const uint8_t *) &h, sizeof(h)) != sizeof(h))
+    f.close();
+  return f;
+}
+
+/* ======================================================================
+Function: historyAppend
+Purpose : write a record into the next ring slot
+Input   : opened file
+          its header, updated
+          record
+Output  : true if written
+Comments: in place, the oldest record is overwritten once full
+====================================================================== */
+static bool historyAppend(File & f, _histhdr & h, const void * rec)
+{
+  if (!f.seek(sizeof(h) + (uint32_t) h.head * h.size, SeekSet) ||
+      f.write((const uint8_t *) rec, h.size) != h.size)
+    return false;
+
+  h.head = (h.head + 1) % h.slots;
+  if (h.count < h.slots)
+    h.count++;
+  return true;
+}
+
+/* ======================================================================
+Function: historyRollup
+Purpose : rollup record of an accumulator
+Input   : accumulator, not empty
+          record filled
+Output  : -
+Comments: -
+====================================================================== */
+static void historyRollup(const _histacc & a, _histroll & r)
+{
+  r.time = a.time;
+  r.n = a.n;
+  r.min = a.min;
+  r.max = a.max;
+  r.mean.temperature = a.sum[0] / a.n;
+  r.mean.humidity = a.sum[1] / a.n;
+  r.mean.pressure = a.sum[2] / a.n;
+  r.mean.vbatt = a.sum[3] / a.n;
+}
+
+/* ======================================================================
+Function: historyAccumulate
+Purpose : add one sample to a rollup
+Input   : accumulator
+          sample
+Output  : -
+Comments: sums fit 32 bits for an hour of samples 10s apart
+====================================================================== */
+static void historyAccumulate(_histacc & a, const _sample & s)
+{
+  if (!a.n)
+  {
+    a.min = a.max = s;
+    memset(a.sum, 0, sizeof(a.sum));
+  }
+  a.n++;
+  a.sum[0] += s.temperature;
+  a.sum[1] += s.humidity;
+  a.sum[2] += s.pressure;
+  a.sum[3] += s.vbatt;
+  if (s.temperature < a.min.temperature) a.min.temperature = s.temperature;
+  if (s.humidity < a.min.humidity)       a.min.humidity = s.humidity;
+  if (s.pressure < a.min.pressure)       a.min.pressure = s.pressure;
+  if (s.vbatt < a.min.vbatt)             a.min.vbatt = s.vbatt;
+  if (s.temperature > a.max.temperature) a.max.temperature = s.temperature;
+  if (s.humidity > a.max.humidity)       a.max.humidity = s.humidity;
+  if (s.pressure > a.max.pressure)       a.max.pressure = s.pressure;
+  if (s.vbatt > a.max.vbatt)             a.max.vbatt = s.vbatt;
+}
+
+/* ======================================================================
+Function: historyFlush
+Purpose : write the pending samples to the ring files
+Input   : -
+Output  : true if done, samples are kept on failure
+Comments: raw records go straight to their slot, rollups are built in
+          the file header and only written once their period is over.
+          Each file is written in place, nothing grows past its slots.
+          Tiers done by a flush that failed on a later one only get the
+          samples newer than their last one. Any other tier newer than
+          the samples was written before a state reset, times restarted
+          from 0 then: it is started again
+====================================================================== */
+bool historyFlush(void)
+{
+  _histstate & hs = state.hist;
+
+  if (!hs.count)
+    return true;
+  if (!SPIFFS.begin())
+    return false;
+
+  for (uint8_t tier=0; tier<HIST_TIERS; tier++)
+  {
+    _histhdr h;
+    File f = historyOpen(tier, h, true);
+    uint16_t res = pgm_read_word(&histRes[tier]);
+    bool ok = f;
+
+    if (ok && !(hs.done & (1 << tier)) && hs.pending[0].time < h.last)
+    {
+      dbg_s("History: tier %u time went back, reset" EOL, tier);
+      h.head = h.count = 0;
+      h.acc.n = 0;
+    }
+
+    for (uint8_t i=0; ok && i<hs.count; i++)
+    {
+      const _histrec & rec = hs.pending[i];
+
+      // Written by a previous flush that failed on a later tier
+      if ((hs.done & (1 << tier)) && rec.time <= h.last)
+        continue;
+      h.last = rec.time;
+
+      if (!res)
+      {
+        ok = historyAppend(f, h, &rec);
+        continue;
+      }
+
+      uint32_t bucket = rec.time - rec.time % res;
+      if (h.acc.n && h.acc.time != bucket)
+      {
+        _histroll roll;
+        historyRollup(h.acc, roll);
+        ok = historyAppend(f, h, &roll);
+        h.acc.n = 0;
+      }
+      h.acc.time = bucket;
+      historyAccumulate(h.acc, rec.s);
+    }
+
+    if (ok)
+      ok = f.seek(0, SeekSet) && f.write((const uint8_t *) &h, sizeof(h)) == sizeof(h);
+    if (f)
+      f.close();
+    if (!ok)
+    {
+      dbg_s("History: tier %u write failed" EOL, tier);
+      return false;
+    }
+    hs.done |= 1 << tier;
+  }
+
+  #ifdef DEBUG_HISTORY
+  dbg_s("History: %u samples flushed" EOL, hs.count);
+  #endif
+  hs.count = 0;
+  hs.done = 0;
+  return true;
+}
+
+/* ======================================================================
+Function: historyAdd
+Purpose : record one sample
+Input   : sample
+          number of sample intervals since it was taken
+Output  : -
+Comments: stamped with the wall clock once known, before that with the
+          seconds since first boot counted by the time model. Samples
+          are flushed to SPIFFS when HIST_PENDING wait, if that fails
+          the oldest one is dropped
+====================================================================== */
+void historyAdd(const _sample & s, uint8_t ago)
+{
+#ifndef FIELD_BUILD
+  _histstate & hs = state.hist;
+  uint32_t interval = (timePeriod() * samplerStretch() + 500) / 1000;
+  uint32_t t = timeNow() ? timeNow() - millis() / 1000 :
+               (uint64_t) state.time.ticks * timePeriod() / 1000;
+
+  t -= min(t, ago * interval);
+  if (t < hs.last)
+    t = hs.last;
+  hs.last = t;
+
+  if (hs.count >= HIST_PENDING && !historyFlush())
+    memmove(&hs.pending[0], &hs.pending[1], --hs.count * sizeof(_histrec));
+
+  hs.pending[hs.count].time = t;
+  hs.pending[hs.count].s = s;
+  hs.count++;
+
+  #ifdef DEBUG_HISTORY
+  dbg_s("History: sample at %lu, %u pending" EOL, (unsigned long) t, hs.count);
+  #endif
+#endif
+}
+
+/* ======================================================================
+Function: historyRead
+Purpose : read a record of a ring file
+Input   : opened file
+          its header
+          index, 0 is the oldest record
+          record read, large enough for a _histroll
+Output  : true if read
+Comments: -
+====================================================================== */
+static bool historyRead(File & f, const _histhdr & h, uint16_t i, void * rec)
+{
+  uint16_t slot = (h.head + h.slots - h.count + i) % h.slots;
+
+  return f.seek(sizeof(h) + (uint32_t) slot * h.size, SeekSet) &&
+         f.read((uint8_t *) rec, h.size) == h.size;
+}
+
+/* ======================================================================
+Function: historyFirst
+Purpose : oldest record of a ring file at or after a time
+Input   : opened file
+          its header
+          time
+Output  : index, h.count if none
+Comments: binary search, records are in time order
+====================================================================== */
+static uint16_t historyFirst(File & f, const _histhdr & h, uint32_t from)
+{
+  uint16_t lo = 0, hi = h.count;
+
+  while (lo < hi)
+  {
+    uint16_t mid = (lo + hi) / 2;
+    _histroll rec;
+
+    if (!historyRead(f, h, mid, &rec))
+      return h.count;
+    if (rec.time < from)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* ======================================================================
+Function: historyTier
+Purpose : tier for a /history.json query
+Input   : res argument, raw, 10m, 1h or the period in seconds, empty
+          for the finest tier still holding the start of the range
+          start of the range
+Output  : HIST_* tier, -1 if res is not known
+Comments: -
+====================================================================== */
+int8_t historyTier(const char * res, uint32_t from)
+{
+  if (!res || !*res)
+  {
+    for (uint8_t tier=0; tier<HIST_TIERS-1; tier++)
+    {
+      _histhdr h;
+      _histroll rec;
+      File f = historyOpen(tier, h, false);
+      bool held = f && h.count && historyRead(f, h, 0, &rec) && rec.time <= from;
+
+      if (f)
+        f.close();
+      if (held)
+        return tier;
+    }
+    return HIST_TIERS - 1;
+  }
+
+  if (!strcmp_P(res, PSTR("raw")) || !strcmp_P(res, PSTR("0")))
+    return HIST_RAW;
+  if (!strcmp_P(res, PSTR("10m")) || !strcmp_P(res, PSTR("600")))
+    return HIST_10MIN;
+  if (!strcmp_P(res, PSTR("1h")) || !strcmp_P(res, PSTR("3600")))
+    return HIST_1HOUR;
+  return -1;
+}
+
+/* ======================================================================
+Function: historySample
+Purpose : append sample values to a JSON row
+Input   : row being built
+          sample
+Output  : -
+Comments: -
+====================================================================== */
+static void historySample(String & r, const _sample & s)
+{
+  r += ',';
+  r += s.temperature;
+  r += ',';
+  r += s.humidity;
+  r += ',';
+  r += (unsigned long) s.pressure;
+  r += ',';
+  r += s.vbatt;
+}
+
+/* ======================================================================
+Function: historyRow
+Purpose : append one record to the JSON answer
+Input   : answer being built
+          tier
+          record
+          true for the first row
+Output  : -
+Comments: raw [t,temp,hum,press,vbatt], rollups [t,n,then min, mean and
+          max of each channel]
+====================================================================== */
+static void historyRow(String & r, uint8_t tier, const void * rec, bool first)
+{
+  if (!first)
+    r += ',';
+  r += '[';
+  if (tier == HIST_RAW)
+  {
+    const _histrec & h = *(const _histrec *) rec;
+    r += (unsigned long) h.time;
+    historySample(r, h.s);
+  }
+  else
+  {
+    const _histroll & h = *(const _histroll *) rec;
+    r += (unsigned long) h.time;
+    r += ',';
+    r += h.n;
+    historySample(r, h.min);
+    historySample(r, h.mean);
+    historySample(r, h.max);
+  }
+  r += ']';
+}
+
+/* ======================================================================
+Function: historyJSON
+Purpose : records of a tier within a time range, as JSON
+Input   : tier
+          range, inclusive
+          answer, empty
+          called to send the answer each HIST_CHUNK bytes, it has to
+          empty it
+Output  : -
+Comments: {"res":s,"fields":[..],"rows":[[..],..]} in time order, values
+          in 1/100 °C, 1/100 %, Pa and mV as in reports. Records are read
+          one by one, only a chunk is ever held in RAM. The rollup being
+          built and samples not flushed yet come last
+====================================================================== */
+void historyJSON(uint8_t tier, uint32_t from, uint32_t to, String & r, void (* flush)(String & r))
+{
+  _histhdr h;
+  File f = historyOpen(tier, h, false);
+  bool first = true;
+
+  r += F("{\"res\":");
+  r += pgm_read_word(&histRes[tier]);
+  r += F(",\"fields\":[\"temperature\",\"humidity\",\"pressure\",\"battery\"],\"rows\":[");
+
+  if (f)
+  {
+    _histroll rec;    // Large enough for both kinds
+
+    for (uint16_t i=historyFirst(f, h, from); i<h.count && historyRead(f, h, i, &rec); i++)
+    {
+      if (rec.time > to)
+        break;
+      historyRow(r, tier, &rec, first);
+      first = false;
+      if (r.length() >= HIST_CHUNK)
+        flush(r);
+    }
+    f.close();
+
+    if (tier != HIST_RAW && h.acc.n && h.acc.time >= from && h.acc.time <= to)
+    {
+      historyRollup(h.acc, rec);
+      historyRow(r, tier, &rec, first);
+      first = false;
+    }
+  }
+
+  if (tier == HIST_RAW)
+  {
+    const _histstate & hs = state.hist;
+    for (uint8_t i=0; i<hs.count; i++)
+    {
+      if (hs.pending[i].time < from || hs.pending[i].time > to)
+        continue;
+      historyRow(r, tier, &hs.pending[i], first);
+      first = false;
+    }
+  }
+  r += F("]}");
+}
@@ -0,0 +1,761 @@
+#include "common.h"
+#include "state.h"
+#include "sampler.h"
+
+#include <EEPROM.h>
+#include <esp8266_peri.h>
+extern "C" {
+#include "ets_sys.h"
+#include "user_interface.h"
+}
+
+// Record header: length, level, time (ms), format
+#define LOG_HDR_SIZE    10
+#define LOG_TX_MASK     (LOG_TX_SIZE - 1)
+#define LOG_UART_FIFO   128
+
+// Saved log header: magic, build, wake, length
+#define LOG_SAVE_MAGIC  0x474C  // "LG"
+#define LOG_SAVE_HDR    10
+
+// Crash log in RTC user memory: magic, build, length, CRC, then records.
+// After the samples in deep sleep mode, in their place otherwise
+#define LOG_RTC_MAGIC   0x5243  // "CR"
+#define LOG_RTC_HDR     8
+#define LOG_RTC_END     128     // RTC user memory blocks
+
+// Binary records, oldest at logHead, next UART output at logOut
+static uint8_t  logRing[LOG_RING_SIZE];
+static uint16_t logHead, logTail, logOut, logUsed;
+static uint16_t logLost;
+static uint8_t  logLevel = LOG_LEVEL_DEFAULT;
+static bool     logError;
+static bool     logPending;     // Saved to the EEPROM buffer, not committed yet
+static bool     logUart;
+static uint8_t  logRtcAt;       // RTC block of the crash log restored, 0 if none
+
+// Text for the UART, filled by logPump(), emptied by the UART interrupt
+static char     logTx[LOG_TX_SIZE];
+static volatile uint16_t logTxHead, logTxTail;
+
+/* ======================================================================
+Function: logBuild
+Purpose : identify the firmware build
+Input   : -
+Output  : CRC16 of the build date
+Comments: saved records point to format strings in flash, they can only
+          be read back by the same build
+====================================================================== */
+static uint16_t logBuild(void)
+{
+  const char * p = PSTR(__DATE__ " " __TIME__);
+  uint16_t crc = ~0;
+  char c;
+
+  while ((c = pgm_read_byte(p++)))
+    crc = crc16Update(crc, c);
+  return crc;
+}
+
+/* ======================================================================
+Function: logUartIsr
+Purpose : UART0 interrupt, moves text from the ring to the TX FIFO
+Input   : -
+Output  : -
+Comments: the serial port is opened TX only, so the core does not use
+          this interrupt
+====================================================================== */
+static void ICACHE_RAM_ATTR logUartIsr(void * arg)
+{
+  uint32_t status = USIS(0);
+  uint16_t tail = logTxTail;
+
+  (void) arg;
+  while (tail != logTxHead && ((USS(0) >> USTXC) & 0xFF) < LOG_UART_FIFO - 1)
+    USF(0) = logTx[tail++ & LOG_TX_MASK];
+  logTxTail = tail;
+
+  // Nothing more to send, stop being called
+  if (tail == logTxHead)
+    USIE(0) &= ~(1 << UIFE);
+  USIC(0) = status;
+}
+
+/* ======================================================================
+Function: logRtcOffset
+Purpose : RTC user memory block of the crash log
+Input   : true in deep sleep mode
+Output  : block, the log goes up to LOG_RTC_END
+Comments: the samples must not be overwritten, they are still to upload
+====================================================================== */
+static uint8_t logRtcOffset(bool sampler)
+{
+  return sampler ? SAMPLER_RTC_OFFSET + SAMPLER_RTC_BLOCKS : SAMPLER_RTC_OFFSET;
+}
+
+/* ======================================================================
+Function: logRtcLoad
+Purpose : put the crash log saved in RTC memory back into the ring
+Input   : -
+Output  : -
+Comments: the ring must be empty. Both places are tried, the config is
+          not loaded yet. It is cleared once saved in EEPROM, see logSave()
+====================================================================== */
+static void logRtcLoad(void)
+{
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    uint8_t  at = logRtcOffset(!i);
+    uint16_t hdr[LOG_RTC_HDR / 2];
+    uint16_t crc = ~0;
+    uint32_t w;
+
+    ESP.rtcUserMemoryRead(at, (uint32_t *) hdr, LOG_RTC_HDR);
+    if (hdr[0] != LOG_RTC_MAGIC || hdr[1] != logBuild() ||
+        hdr[2] > (LOG_RTC_END - at) * 4 - LOG_RTC_HDR)
+      continue;
+
+    for (uint8_t j = 0; j < 6; j++)
+      crc = crc16Update(crc, ((uint8_t *) hdr)[j]);
+    for (uint16_t j = 0; j < hdr[2]; j++)
+    {
+      if (!(j & 3))
+        ESP.rtcUserMemoryRead(at + (LOG_RTC_HDR + j) / 4, &w, 4);
+      logRing[j] = ((uint8_t *) &w)[j & 3];
+      crc = crc16Update(crc, logRing[j]);
+    }
+    if (crc != hdr[3])
+      continue;
+
+    logTail = logUsed = hdr[2];
+    logRtcAt = at;
+    logError = true;
+    return;
+  }
+}
+
+/* ======================================================================
+Function: logInit
+Purpose : start logging
+Input   : -
+Output  : -
+Comments: records why we restarted if it was not a power on, after the
+          records saved by the crash if any
+====================================================================== */
+void logInit(void)
+{
+  struct rst_info * ri = ESP.getResetInfoPtr();
+
+  if (featureDebug)
+  {
+    DEBUG_SERIAL.begin(115200, SERIAL_8N1, SERIAL_TX_ONLY);
+    ETS_UART_INTR_DISABLE();
+    USC1(0) = (USC1(0) & ~(0x7F << UCFET)) | (LOG_TX_FIFO_LOW << UCFET);
+    USIC(0) = 0xFFFF;
+    USIE(0) = 0;
+    ETS_UART_INTR_ATTACH(logUartIsr, NULL);
+    ETS_UART_INTR_ENABLE();
+    logUart = true;
+  }
+
+  logRtcLoad();
+  if (ri->reason == REASON_WDT_RST || ri->reason == REASON_EXCEPTION_RST ||
+      ri->reason == REASON_SOFT_WDT_RST)
+  {
+    logW("Reset reason %d, exception %d at 0x%08X" EOL,
+          ri->reason, ri->exccause, ri->epc1);
+  }
+}
+
+/* ======================================================================
+Function: logSetLevel
+Purpose : set the runtime log level
+Input   : LOG_ERROR to LOG_DEBUG, 0 for default
+Output  : -
+Comments: errors are always kept, whatever the level
+====================================================================== */
+void logSetLevel(uint8_t level)
+{
+  if (!level || level > LOG_DEBUG)
+    level = LOG_LEVEL_DEFAULT;
+  logLevel = level;
+}
+
+uint8_t logGetLevel(void)
+{
+  return logLevel;
+}
+
+/* ======================================================================
+Function: logRingGet
+Purpose : copy bytes out of the record ring
+Input   : ring position, destination, size
+Output  : -
+Comments: handles wrapping
+====================================================================== */
+static void logRingGet(uint16_t pos, uint8_t * data, uint16_t size)
+{
+  pos %= LOG_RING_SIZE;
+  while (size--)
+  {
+    *data++ = logRing[pos++];
+    if (pos == LOG_RING_SIZE)
+      pos = 0;
+  }
+}
+
+/* ======================================================================
+Function: logNext
+Purpose : get the position of the record after one
+Input   : record position
+Output  : next record position
+Comments: -
+====================================================================== */
+static uint16_t logNext(uint16_t pos)
+{
+  return (pos + logRing[pos]) % LOG_RING_SIZE;
+}
+
+/* ======================================================================
+Function: logSpec
+Purpose : find the next conversion in a format
+Input   : format position (PROGMEM), where to copy the specification
+Output  : conversion character, 0 at end of format
+Comments: literal text before it is skipped, "%%" is literal text.
+          Length modifiers are dropped, arguments are all 32 bits.
+====================================================================== */
+static char logSpec(PGM_P & fmt, char * spec, uint8_t size)
+{
+  char c;
+
+  while ((c = pgm_read_byte(fmt++)))
+  {
+    if (c != '%')
+      continue;
+    if (pgm_read_byte(fmt) == '%') {
+      fmt++;
+      continue;
+    }
+
+    uint8_t n = 0;
+    spec[n++] = '%';
+    while ((c = pgm_read_byte(fmt)) && strchr("-+ #0123456789.hlLqjzt", c))
+    {
+      if (!strchr("hlLqjzt", c) && n < size - 2)
+        spec[n++] = c;
+      fmt++;
+    }
+    if (!c)
+      return 0;
+    fmt++;
+    spec[n++] = c;
+    spec[n] = '\0';
+    return c;
+  }
+  --fmt;
+  return 0;
+}
+
+/* ======================================================================
+Function: logWrite
+Purpose : add a record to the log
+Input   : level (| LOG_RAW), format (PROGMEM), arguments
+Output  : -
+Comments: arguments are stored in binary form following the format,
+          strings are copied. Oldest records make room if needed.
+          Nothing is formatted here, see logPump()
+====================================================================== */
+void logWrite(uint8_t level, PGM_P fmt, const logArg * args, uint8_t n)
+{
+  uint8_t  rec[LOG_REC_SIZE];
+  uint8_t  len = LOG_HDR_SIZE;
+  uint32_t v;
+  char     spec[16];
+  char     c;
+
+  if ((level & ~LOG_RAW) > logLevel)
+    return;
+
+  v = millis();
+  rec[1] = level;
+  memcpy(&rec[2], &v, 4);
+  v = (uint32_t) (uintptr_t) fmt;
+  memcpy(&rec[6], &v, 4);
+
+  if (!(level & LOG_RAW))
+  {
+    for (uint8_t i = 0; i < n && (c = logSpec(fmt, spec, sizeof(spec))); i++)
+    {
+      const logArg & a = args[i];
+
+      if (c == 's' || c == 'S')
+      {
+        // String copied with its length
+        const char * s = a.s;
+        uint8_t l = 0;
+        if (len + 1 > LOG_REC_SIZE)
+          break;
+        if (a.type == 'P' || c == 'S')
+          while (s && len + 1 + l < LOG_REC_SIZE && (rec[len + 1 + l] = pgm_read_byte(s + l)))
+            l++;
+        else if (a.type == 's')
+          while (s && len + 1 + l < LOG_REC_SIZE && (rec[len + 1 + l] = s[l]))
+            l++;
+        rec[len] = l;
+        len += 1 + l;
+        continue;
+      }
+
+      if (len + 4 > LOG_REC_SIZE)
+        break;
+      if (strchr("feEgGaA", c)) {
+        float f = a.type == 'f' ? a.f : a.type == 'i' ? (float) a.i : (float) a.u;
+        memcpy(&rec[len], &f, 4);
+      } else {
+        v = a.type == 'f' ? (uint32_t) (int32_t) a.f : a.u;
+        memcpy(&rec[len], &v, 4);
+      }
+      len += 4;
+    }
+  }
+  rec[0] = len;
+
+  // Make room, dropping oldest records
+  while (LOG_RING_SIZE - logUsed < len)
+  {
+    if (logOut == logHead && logOut != logTail) {
+      logOut = logNext(logOut);
+      logLost++;
+    }
+    logUsed -= logRing[logHead];
+    logHead = logNext(logHead);
+  }
+
+  for (uint8_t i = 0; i < len; i++)
+  {
+    logRing[logTail++] = rec[i];
+    if (logTail == LOG_RING_SIZE)
+      logTail = 0;
+  }
+  logUsed += len;
+
+  // Snapshot what led to the error now, before newer records push it out
+  if ((level & ~LOG_RAW) == LOG_ERROR) {
+    logError = true;
+    logSave(false);
+  }
+}
+
+/* ======================================================================
+Function: logValue
+Purpose : log a single value, as Serial.print() would
+Input   : value
+Output  : -
+Comments: -
+====================================================================== */
+void logValue(const logArg & v)
+{
+  switch (v.type)
+  {
+    case 'i': logWrite(LOG_INFO, PSTR("%d"), &v, 1); break;
+    case 'u': logWrite(LOG_INFO, PSTR("%u"), &v, 1); break;
+    case 'f': logWrite(LOG_INFO, PSTR("%.2f"), &v, 1); break;
+    default:  logWrite(LOG_INFO, PSTR("%s"), &v, 1); break;
+  }
+}
+
+/* ======================================================================
+Function: logFormat
+Purpose : format a record as text
+Input   : record, destination, its size
+Output  : text length
+Comments: -
+====================================================================== */
+static uint16_t logFormat(const uint8_t * rec, char * out, uint16_t size)
+{
+  uint32_t v;
+  PGM_P    fmt;
+  PGM_P    lit;
+  uint16_t len = 0;
+  uint8_t  pos = LOG_HDR_SIZE;
+  char     spec[16];
+  char     c;
+
+  memcpy(&v, &rec[6], 4);
+  fmt = (PGM_P) (uintptr_t) v;
+
+  if (rec[1] & LOG_RAW)
+  {
+    strncpy_P(out, fmt, size - 1);
+    out[size - 1] = '\0';
+    return strlen(out);
+  }
+
+  for (;;)
+  {
+    lit = fmt;
+    c = logSpec(fmt, spec, sizeof(spec));
+
+    // Literal text up to the conversion, "%%" becomes "%"
+    while (lit < fmt && len < size - 1)
+    {
+      char l = pgm_read_byte(lit++);
+      if (l == '%')
+      {
+        if (pgm_read_byte(lit) != '%')
+          break;
+        lit++;
+      }
+      out[len++] = l;
+    }
+    if (!c || pos >= rec[0])
+      break;
+
+    int r;
+    if (c == 's' || c == 'S')
+    {
+      char s[LOG_REC_SIZE];
+      uint8_t l = rec[pos];
+      memcpy(s, &rec[pos + 1], l);
+      s[l] = '\0';
+      spec[strlen(spec) - 1] = 's';
+      r = snprintf(out + len, size - len, spec, s);
+      pos += 1 + l;
+    }
+    else
+    {
+      memcpy(&v, &rec[pos], 4);
+      pos += 4;
+      if (strchr("feEgGaA", c)) {
+        float f;
+        memcpy(&f, &v, 4);
+        r = snprintf(out + len, size - len, spec, (double) f);
+      } else if (strchr("di", c)) {
+        r = snprintf(out + len, size - len, spec, (int) v);
+      } else {
+        r = snprintf(out + len, size - len, spec, (unsigned int) v);
+      }
+    }
+    if (r > 0)
+      len += r;
+    if (len >= size - 1) {
+      len = size - 1;
+      break;
+    }
+  }
+  out[len] = '\0';
+  return len;
+}
+
+/* ======================================================================
+Function: logPump
+Purpose : format pending records for the UART
+Input   : -
+Output  : -
+Comments: never waits, what does not fit yet goes on next call. Main
+          loop only (dbgFlush(), logFlush(), scheduler log task), never
+          from logWrite() which may run in a callback
+====================================================================== */
+void logPump(void)
+{
+  uint8_t rec[LOG_REC_SIZE];
+  char    line[LOG_LINE_SIZE];
+  bool    sent = false;
+
+  if (!logUart)
+    return;
+
+  if (logLost && LOG_TX_SIZE - (uint16_t) (logTxHead - logTxTail) >= LOG_LINE_SIZE)
+  {
+    uint16_t len = snprintf_P(line, sizeof(line), PSTR("[%u lost]" EOL), logLost);
+    for (uint16_t i = 0; i < len; i++)
+      logTx[(logTxHead + i) & LOG_TX_MASK] = line[i];
+    logTxHead += len;
+    logLost = 0;
+    sent = true;
+  }
+
+  while (logOut != logTail && LOG_TX_SIZE - (uint16_t) (logTxHead - logTxTail) >= LOG_LINE_SIZE)
+  {
+    logRingGet(logOut, rec, logRing[logOut]);
+    uint16_t len = logFormat(rec, line, sizeof(line));
+    for (uint16_t i = 0; i < len; i++)
+      logTx[(logTxHead + i) & LOG_TX_MASK] = line[i];
+    logTxHead += len;
+    logOut = logNext(logOut);
+    sent = true;
+  }
+
+  if (sent)
+  {
+    ETS_UART_INTR_DISABLE();
+    USIE(0) |= (1 << UIFE);
+    ETS_UART_INTR_ENABLE();
+  }
+}
+
+/* ======================================================================
+Function: logFlush
+Purpose : wait for the log to be sent out
+Input   : time out (ms)
+Output  : -
+Comments: only before cutting power, nothing else should wait on logs
+====================================================================== */
+void logFlush(uint16_t timeout)
+{
+  uint32_t start = millis();
+
+  if (!logUart)
+    return;
+
+  do
+  {
+    logPump();
+    if (logOut == logTail && logTxHead == logTxTail && !((USS(0) >> USTXC) & 0xFF))
+      break;
+    delay(1);
+  }
+  while (millis() - start < timeout);
+}
+
+/* ======================================================================
+Function: logSave
+Purpose : save the log records in EEPROM
+Input   : true to write flash now, false to leave it to the next
+          EEPROM commit (stateSave)
+Output  : true if saved
+Comments: only when an error was logged since last save, the newest
+          records that fit. If EEPROM is not opened yet, it will be done
+          on next call.
+====================================================================== */
+bool logSave(bool commit)
+{
+  uint16_t addr = EEPROM_LOG_ADDR;
+  uint16_t crc = ~0;
+  uint16_t pos = logHead;
+  uint16_t len = logUsed;
+  uint8_t  hdr[LOG_SAVE_HDR];
+  uint16_t v;
+  uint8_t  b;
+
+  if (!logError || !EEPROM.length())
+    return false;
+
+  while (len > LOG_SAVE_SIZE)
+  {
+    len -= logRing[pos];
+    pos = logNext(pos);
+  }
+
+  v = LOG_SAVE_MAGIC;
+  memcpy(&hdr[0], &v, 2);
+  v = logBuild();
+  memcpy(&hdr[2], &v, 2);
+  memcpy(&hdr[4], &state.wakes, 4);
+  memcpy(&hdr[8], &len, 2);
+
+  for (uint16_t i = 0; i < LOG_SAVE_HDR + LOG_SAVE_SIZE; i++)
+  {
+    if (i < LOG_SAVE_HDR)
+      b = hdr[i];
+    else if (i < LOG_SAVE_HDR + len) {
+      b = logRing[pos++];
+      if (pos == LOG_RING_SIZE)
+        pos = 0;
+    } else
+      b = 0;
+    crc = crc16Update(crc, b);
+    EEPROM.write(addr++, b);
+  }
+  // CRC LSB first, as eepromWriteBlock()
+  EEPROM.write(addr++, crc & 0xFF);
+  EEPROM.write(addr, crc >> 8);
+
+  logError = false;
+
+  // The crash log restored is in there now
+  if (logRtcAt)
+  {
+    uint32_t w = 0;
+    ESP.rtcUserMemoryWrite(logRtcAt, &w, 4);
+    logRtcAt = 0;
+  }
+
+  if (!commit)
+    return logPending = true;
+  stateStage();
+  logPending = false;
+  return EEPROM.commit();
+}
+
+/* ======================================================================
+Function: logStaged
+Purpose : check if saved records wait for an EEPROM commit
+Input   : -
+Output  : true after logSave(false) saved some
+Comments: the wake journal must not be used then, see stateSave()
+====================================================================== */
+bool logStaged(void)
+{
+  return logPending;
+}
+
+/* ======================================================================
+Function: logJSONRecords
+Purpose : add records to a JSON array, one entry per line of text
+Input   : JSON string, record reader, first position, bytes to read
+Output  : -
+Comments: -
+====================================================================== */
+template<typename R> static void logJSONRecords(String & r, R get, uint16_t pos, uint16_t len)
+{
+  uint8_t  rec[LOG_REC_SIZE];
+  char     text[LOG_LINE_SIZE];
+  String   line;
+  uint32_t ms = 0;
+  uint8_t  level = LOG_DEBUG;
+  bool     first = true;
+
+  while (len)
+  {
+    get(pos, rec, 1);
+    if (rec[0] < LOG_HDR_SIZE || rec[0] > len)
+      break;
+    get(pos, rec, rec[0]);
+    pos += rec[0];
+    len -= rec[0];
+
+    if (!line.length()) {
+      memcpy(&ms, &rec[2], 4);
+      level = LOG_DEBUG;
+    }
+    if ((rec[1] & ~LOG_RAW) < level)
+      level = rec[1] & ~LOG_RAW;
+    logFormat(rec, text, sizeof(text));
+    line += text;
+
+    if (line.endsWith("\n") || !len || line.length() > 200)
+    {
+      line.trim();
+      if (!first)
+        r += ',';
+      first = false;
+      r += F("\r\n{\"ms\":");
+      r += ms;
+      r += F(",\"lvl\":");
+      r += level;
+      r += F(",\"msg\":\"");
+      for (const char * p = line.c_str(); *p; p++)
+      {
+        if (*p == '"' || *p == '\\') {
+          r += '\\';
+          r += *p;
+        } else if ((uint8_t) *p >= ' ')
+          r += *p;
+      }
+      r += F("\"}");
+      line = "";
+    }
+  }
+}
+
+/* ======================================================================
+Function: logJSON
+Purpose : dump the saved log and the current one as JSON
+Input   : JSON string
+Output  : -
+Comments: saved records of another firmware build can't be decoded
+====================================================================== */
+void logJSON(String & r)
+{
+  uint16_t addr = EEPROM_LOG_ADDR;
+  uint16_t crc = ~0;
+  uint16_t magic, build, len;
+  uint32_t wake;
+
+  for (uint16_t i = 0; i < LOG_SAVE_HDR + LOG_SAVE_SIZE + 2; i++)
+    crc = crc16Update(crc, EEPROM.read(addr + i));
+  magic = EEPROM.read(addr) | EEPROM.read(addr + 1) << 8;
+  build = EEPROM.read(addr + 2) | EEPROM.read(addr + 3) << 8;
+  wake  = EEPROM.read(addr + 4) | EEPROM.read(addr + 5) << 8 |
+          (uint32_t) EEPROM.read(addr + 6) << 16 | (uint32_t) EEPROM.read(addr + 7) << 24;
+  len   = EEPROM.read(addr + 8) | EEPROM.read(addr + 9) << 8;
+
+  r = F("{\"level\":");
+  r += logLevel;
+  r += F(",\"saved\":{");
+  if (!crc && magic == LOG_SAVE_MAGIC && len <= LOG_SAVE_SIZE)
+  {
+    r += F("\"wake\":");
+    r += wake;
+    r += F(",\"records\":[");
+    if (build == logBuild())
+      logJSONRecords(r, [](uint16_t pos, uint8_t * data, uint16_t size) {
+          while (size--)
+            *data++ = EEPROM.read(EEPROM_LOG_ADDR + LOG_SAVE_HDR + pos++);
+        }, 0, len);
+    r += ']';
+  }
+  r += F("},\"live\":[");
+  logJSONRecords(r, logRingGet, logHead, logUsed);
+  r += F("]}\r\n");
+}
+
+/* ======================================================================
+Function: logRtcSave
+Purpose : save the newest records in RTC memory
+Input   : -
+Output  : -
+Comments: no flash access, safe from the crash callback. One block at a
+          time, records first, the header last
+====================================================================== */
+static void logRtcSave(void)
+{
+  uint8_t  at = logRtcOffset(samplerEnabled());
+  uint16_t hdr[LOG_RTC_HDR / 2];
+  uint16_t pos = logHead;
+  uint16_t len = logUsed;
+  uint16_t crc = ~0;
+  uint32_t w = 0;
+
+  while (len > (LOG_RTC_END - at) * 4 - LOG_RTC_HDR)
+  {
+    len -= logRing[pos];
+    pos = logNext(pos);
+  }
+
+  hdr[0] = LOG_RTC_MAGIC;
+  hdr[1] = logBuild();
+  hdr[2] = len;
+  for (uint8_t i = 0; i < 6; i++)
+    crc = crc16Update(crc, ((uint8_t *) hdr)[i]);
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    ((uint8_t *) &w)[i & 3] = logRing[pos];
+    crc = crc16Update(crc, logRing[pos]);
+    if (++pos == LOG_RING_SIZE)
+      pos = 0;
+    if ((i & 3) == 3 || i == len - 1)
+      ESP.rtcUserMemoryWrite(at + (LOG_RTC_HDR + i) / 4, &w, 4);
+  }
+
+  hdr[3] = crc;
+  ESP.rtcUserMemoryWrite(at, (uint32_t *) hdr, LOG_RTC_HDR);
+}
+
+/* ======================================================================
+Function: custom_crash_callback
+Purpose : core hook called on exception or watchdog reset
+Input   : reset information, stack
+Output  : -
+Comments: saves the records that led there in RTC memory, the next boot
+          puts them in EEPROM: no flash write from an exception
+====================================================================== */
+extern "C" void custom_crash_callback(struct rst_info * ri, uint32_t stack, uint32_t stack_end)
+{
+  (void) stack;
+  (void) stack_end;
+  logE("Crash %d, exception %d at 0x%08X" EOL, ri->reason, ri->exccause, ri->epc1);
+  logRtcSave();
+}
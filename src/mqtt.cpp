@@ -0,0 +1,400 @@
+#include "app.h"
+#include "state.h"
+#include "dnscache.h"
+#include "mqtt.h"
+#include "sensor.h"
+#include "events.h"
+#include "sampler.h"
+
+//#define DEBUG_MQTT
+
+// Packets are built in one buffer and sent with a single write
+static uint8_t  mqttBuf[MQTT_BUFFER_SIZE];
+static uint16_t mqttLen;
+
+// PUBLISH packets in the buffer: start (then end of the last) and id
+static uint16_t mqttAt[MQTT_PUB_MAX + 1];
+static uint16_t mqttPids[MQTT_PUB_MAX];
+static uint8_t  mqttCount;
+
+/* ======================================================================
+Function: mqttPid
+Purpose : next QoS 1 packet identifier
+Input   : -
+Output  : identifier, never 0
+Comments: own counter in state, the persistent session may still hold
+          unacknowledged ids of the previous wakes
+====================================================================== */
+static uint16_t mqttPid(void)
+{
+  if (!++state.mqtt_pid)
+    state.mqtt_pid = 1;
+  return state.mqtt_pid;
+}
+
+/* ======================================================================
+Function: mqttPutString
+Purpose : append a length prefixed string
+Input   : string, its size
+Output  : false if the buffer is full
+Comments: -
+====================================================================== */
+static bool mqttPutString(const char * s, uint16_t len)
+{
+  if (mqttLen + 2 + len > MQTT_BUFFER_SIZE)
+    return false;
+  mqttBuf[mqttLen++] = len >> 8;
+  mqttBuf[mqttLen++] = len & 0xFF;
+  memcpy(mqttBuf + mqttLen, s, len);
+  mqttLen += len;
+  return true;
+}
+
+/* ======================================================================
+Function: mqttBegin / mqttEnd
+Purpose : open and close a packet in the buffer
+Input   : packet type and flags / packet start returned by mqttBegin
+Output  : packet start, MQTT_BUFFER_SIZE if full / false if failed
+Comments: remaining length is written on mqttEnd(), with room reserved
+          for 2 bytes (up to 16383 bytes), moved down if only one is used
+====================================================================== */
+static uint16_t mqttBegin(uint8_t type)
+{
+  uint16_t start = mqttLen;
+  if (mqttLen + 3 > MQTT_BUFFER_SIZE)
+    return MQTT_BUFFER_SIZE;
+  mqttBuf[mqttLen] = type;
+  mqttLen += 3;
+  return start;
+}
+
+static bool mqttEnd(uint16_t start)
+{
+  uint16_t len;
+
+  if (start >= MQTT_BUFFER_SIZE)
+    return false;
+
+  len = mqttLen - start - 3;
+  if (len < 128)
+  {
+    mqttBuf[start + 1] = len;
+    memmove(mqttBuf + start + 2, mqttBuf + start + 3, len);
+    mqttLen--;
+  }
+  else
+  {
+    mqttBuf[start + 1] = (len & 0x7F) | 0x80;
+    mqttBuf[start + 2] = len >> 7;
+  }
+  return true;
+}
+
+/* ======================================================================
+Function: mqttConnect
+Purpose : append the CONNECT packet
+Input   : client identifier
+Output  : false if the buffer is full
+Comments: persistent session (clean session = 0) so QoS 1 messages are
+          not lost by the broker between wakes. The shared key, if any,
+          is the password, with the client ID as user name.
+====================================================================== */
+static bool mqttConnect(const char * id)
+{
+  uint16_t start = mqttBegin(MQTT_CONNECT);
+  uint8_t flags = 0x00;
+
+  if (*config.report_key)
+    flags |= 0x80 | 0x40;
+
+  if (start >= MQTT_BUFFER_SIZE ||
+      !mqttPutString("MQTT", 4) || mqttLen + 4 > MQTT_BUFFER_SIZE)
+    return false;
+  mqttBuf[mqttLen++] = 4;    // 3.1.1
+  mqttBuf[mqttLen++] = flags;
+  mqttBuf[mqttLen++] = MQTT_KEEPALIVE >> 8;
+  mqttBuf[mqttLen++] = MQTT_KEEPALIVE & 0xFF;
+
+  if (!mqttPutString(id, strlen(id)))
+    return false;
+  if (flags && (!mqttPutString(id, strlen(id)) ||
+                !mqttPutString(config.report_key, strlen(config.report_key))))
+    return false;
+  return mqttEnd(start);
+}
+
+/* ======================================================================
+Function: mqttPublish
+Purpose : append a PUBLISH packet
+Input   : topic template, client id, channel name, value, packet id
+          (0 for QoS 0)
+Output  : false if the buffer is full
+Comments: topic template placeholders {id} and {ch} are replaced by the
+          client id and the channel name. The packet is recorded in
+          mqttAt / mqttPids for mqttResend()
+====================================================================== */
+static bool mqttPublish(const char * tpl, const char * id, const char * ch,
+                        const char * value, uint16_t pid)
+{
+  char topic[MQTT_TOPIC_SIZE + 1];
+  uint8_t n = 0;
+  uint16_t start;
+
+  if (mqttCount >= MQTT_PUB_MAX)
+    return false;
+
+  while (*tpl && n < MQTT_TOPIC_SIZE)
+  {
+    const char * sub = NULL;
+    if (!strncmp_P(tpl, PSTR("{id}"), 4))
+      sub = id;
+    else if (!strncmp_P(tpl, PSTR("{ch}"), 4))
+      sub = ch;
+
+    if (sub)
+    {
+      while (*sub && n < MQTT_TOPIC_SIZE)
+        topic[n++] = *sub++;
+      tpl += 4;
+    }
+    else
+      topic[n++] = *tpl++;
+  }
+  topic[n] = '\0';
+
+  start = mqttBegin(MQTT_PUBLISH | (pid ? MQTT_QOS1 : 0x00));
+  if (start >= MQTT_BUFFER_SIZE)
+    return false;
+
+  // Drop the partial packet if it does not fit
+  if (!mqttPutString(topic, n) ||
+      mqttLen + (pid ? 2 : 0) + strlen(value) > MQTT_BUFFER_SIZE)
+  {
+    mqttLen = start;
+    return false;
+  }
+  if (pid)
+  {
+    mqttBuf[mqttLen++] = pid >> 8;
+    mqttBuf[mqttLen++] = pid & 0xFF;
+  }
+  n = strlen(value);
+  memcpy(mqttBuf + mqttLen, value, n);
+  mqttLen += n;
+  if (!mqttEnd(start))
+    return false;
+  mqttAt[mqttCount] = start;
+  mqttPids[mqttCount++] = pid;
+  mqttAt[mqttCount] = mqttLen;
+  return true;
+}
+
+/* ======================================================================
+Function: mqttResend
+Purpose : keep in the buffer the CONNECT and the PUBLISH not acknowledged
+Input   : mask of the acknowledged ones, bit n for mqttPids[n]
+Output  : -
+Comments: they are flagged DUP, as MQTT 3.1.1 wants when sent again on a
+          new connection of the persistent session
+====================================================================== */
+static void mqttResend(uint64_t acked)
+{
+  uint16_t len = mqttAt[0];
+  uint8_t n = 0;
+
+  for (uint8_t i = 0; i < mqttCount; i++)
+  {
+    uint16_t size = mqttAt[i + 1] - mqttAt[i];
+
+    if (acked & (1ULL << i))
+      continue;
+    // Moves down only, the packets keep their order
+    memmove(mqttBuf + len, mqttBuf + mqttAt[i], size);
+    mqttBuf[len] |= MQTT_DUP;
+    mqttAt[n] = len;
+    mqttPids[n++] = mqttPids[i];
+    len += size;
+  }
+  mqttAt[n] = len;
+  mqttCount = n;
+  mqttLen = len;
+}
+
+/* ======================================================================
+Function: mqttWaitAcks
+Purpose : read the CONNACK and the PUBACKs of the burst
+Input   : client
+          mask of the PUBLISH acknowledged, bit n for mqttPids[n]
+Output  : true if connection accepted and everything acknowledged
+Comments: a PUBACK of an id not in the burst is a protocol error
+====================================================================== */
+static bool mqttWaitAcks(WiFiClient & client, uint64_t & acked)
+{
+  uint8_t pkt[4];
+  bool connack = false;
+  uint64_t all = (1ULL << mqttCount) - 1;
+  uint32_t start = millis();
+
+  acked = 0;
+  while ((!connack || acked != all) && millis() - start < MQTT_TIMEOUT)
+  {
+    if (client.available() < 4)
+    {
+      if (!client.connected())
+        return false;
+      delay(1);
+      continue;
+    }
+    client.read(pkt, 4);
+    if (pkt[0] == MQTT_CONNACK && pkt[1] == 2)
+    {
+      // Return code
+      if (pkt[3])
+        return false;
+      connack = true;
+    }
+    else if (pkt[0] == MQTT_PUBACK && pkt[1] == 2)
+    {
+      uint16_t pid = pkt[2] << 8 | pkt[3];
+      uint8_t i = 0;
+
+      while (i < mqttCount && mqttPids[i] != pid)
+        i++;
+      if (i == mqttCount)
+        return false;
+      acked |= 1ULL << i;
+    }
+    else
+      return false;
+  }
+  return connack && acked == all;
+}
+
+/* ======================================================================
+Function: mqttReport
+Purpose : publish sysinfo to the MQTT broker
+Input   : -
+Output  : true if published (and acknowledged with QoS 1)
+Comments: broker is report host and port, topic template is report url.
+          CONNECT and every PUBLISH leave in a single TCP write, a client
+          may publish without waiting for CONNACK. QoS 1 is used when
+          report_ack is set, and acknowledges are then waited for: the
+          PUBLISH not acknowledged are sent once again, with DUP set, on
+          a new connection. Deep sleep samples are published one per
+          PUBLISH, in the same write.
+====================================================================== */
+bool mqttReport(void)
+{
+  char id[24];
+  char value[16];
+  uint8_t qos1 = config.report_ack ? 1 : 0;
+  uint64_t acked = 0;
+  bool samples = true;
+  bool ret;
+  IPAddress ip;
+  WiFiClient client;
+
+  sprintf_P(id, PSTR(__appName "-%06X"), ESP.getChipId());
+
+  #define MQTT_PUB(ch, v) do { mqttPublish(config.report.url, id, ch, v, qos1 ? mqttPid() : 0); } while (0)
+
+  mqttLen = 0;
+  mqttCount = 0;
+  ret = mqttConnect(id);
+  mqttAt[0] = mqttLen;
+
+  dtostrf(sysinfo.vBatt, 1, 2, value);
+  MQTT_PUB("battery", value);
+  MQTT_PUB("wakeSource", sysinfo.extWake ? "External" : "Timer");
+  if (eventCount())
+  {
+    utoa(eventCount(), value, 10);
+    MQTT_PUB("events", value);
+  }
+  if (*config.report.msg)
+    MQTT_PUB("message", config.report.msg);
+  for (uint8_t i = 0; i < sensorChannels(); i++)
+  {
+    _sensorchannel desc;
+    char key[24];
+    float v;
+
+    if (!sensorGet(i, desc, v))
+      continue;
+    strncpy_P(key, desc.key, sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+    dtostrf(v, 1, desc.decimals, value);
+    MQTT_PUB(key, value);
+  }
+
+  // Deep sleep mode samples, oldest first, as in the JSON report
+  if (samplerCount())
+  {
+    char sample[48];
+    utoa(config.sleep.interval * samplerStretch(), value, 10);
+    MQTT_PUB("interval", value);
+    for (uint8_t i = 0; i < samplerCount(); i++)
+    {
+      const _sample * s = samplerGet(i);
+      uint8_t n = mqttCount;
+      sprintf_P(sample, PSTR("[%d,%u,%lu,%u]"), s->temperature, s->humidity,
+                (unsigned long) s->pressure, s->vbatt);
+      MQTT_PUB("sample", sample);
+      if (mqttCount == n)
+        samples = false;
+    }
+  }
+
+  #undef MQTT_PUB
+
+  if (!ret || !mqttCount)
+    return false;
+
+  // Nothing to wait for with QoS 0, disconnect in the same write
+  if (!qos1 && mqttLen + 2 <= MQTT_BUFFER_SIZE)
+  {
+    mqttBuf[mqttLen++] = MQTT_DISCONNECT;
+    mqttBuf[mqttLen++] = 0;
+  }
+
+  if (!dnsResolve(config.report.host, ip))
+    return false;
+
+  for (uint8_t retry = 0; retry < 2; retry++)
+  {
+    if (retry)
+    {
+      mqttResend(acked);
+      #ifdef DEBUG_MQTT
+      dbg_s("MQTT: resend %u" EOL, mqttCount);
+      #endif
+    }
+    if (!client.connect(ip, config.report.port))
+    {
+      dnsInvalidate();
+      return false;
+    }
+    client.setNoDelay(true);
+
+    #ifdef DEBUG_MQTT
+    dbg_s("MQTT: %u publish, %u bytes" EOL, mqttCount, mqttLen);
+    #endif
+
+    ret = client.write(mqttBuf, mqttLen) == mqttLen;
+    if (ret && qos1)
+    {
+      ret = mqttWaitAcks(client, acked);
+      const uint8_t disconnect[] = { MQTT_DISCONNECT, 0 };
+      client.write(disconnect, sizeof(disconnect));
+    }
+    client.flush();
+    client.stop();
+    if (ret || !qos1)
+      break;
+  }
+
+  // Those left out are sent again with the next report
+  if (ret && samples)
+    samplerReported();
+  return ret;
+}
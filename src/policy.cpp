@@ -0,0 +1,96 @@
+#include "app.h"
+#include "state.h"
+#include "policy.h"
+#include "sensor.h"
+
+//#define DEBUG_POLICY
+
+/* ======================================================================
+Function: policyBattZone
+Purpose : classify the battery voltage against the policy thresholds
+Input   : -
+Output  : 0 ok, 1 below low threshold, 2 below critical threshold
+Comments: a 0 threshold is disabled
+====================================================================== */
+static uint8_t policyBattZone(void)
+{
+  uint16_t mv = sysinfo.vBatt * 1000;
+
+  if (config.policy.vbatt_crit && mv < config.policy.vbatt_crit)
+    return 2;
+  if (config.policy.vbatt_low && mv < config.policy.vbatt_low)
+    return 1;
+  return 0;
+}
+
+/* ======================================================================
+Function: policyDelta
+Purpose : check if a value moved beyond its threshold since last report
+Input   : current value, last reported value, threshold (0 disabled)
+Output  : true if moved enough
+Comments: -
+====================================================================== */
+static bool policyDelta(int32_t now, int32_t last, uint16_t threshold)
+{
+  return threshold && (uint32_t) abs(now - last) >= threshold;
+}
+
+/* ======================================================================
+Function: policyShouldReport
+Purpose : decide if this wake has something worth reporting
+Input   : -
+Output  : true if WiFi has to be brought up and a report sent
+Comments: values are compared with the last ones successfully reported,
+          kept in state, so a failed report is retried on next wake
+====================================================================== */
+bool policyShouldReport(void)
+{
+  _policy & p = config.policy;
+  _lastreport & l = state.last;
+  const char * why = NULL;
+
+  if (!(p.flags & POLICY_ENABLED))
+    why = PSTR("policy disabled");
+  else if (!l.wake)
+    why = PSTR("first report");
+  else if (sysinfo.extWake && (p.flags & POLICY_EXTWAKE))
+    why = PSTR("external wake");
+  else if (policyBattZone() != l.batt_zone)
+    why = PSTR("battery threshold");
+  else if (p.heartbeat && state.wakes - l.wake >= p.heartbeat)
+    why = PSTR("heartbeat");
+  else if (sensorHas(SENSOR_HAS_TEMPERATURE) && policyDelta(lroundf(sysinfo.temperature * 100), l.temperature, p.dtemp))
+    why = PSTR("temperature");
+  else if (sensorHas(SENSOR_HAS_HUMIDITY) && policyDelta(lroundf(sysinfo.humidity * 100), l.humidity, p.dhum))
+    why = PSTR("humidity");
+  else if (sensorHas(SENSOR_HAS_PRESSURE) && policyDelta(lroundf(sysinfo.pressure * 100), l.pressure, p.dpress))
+    why = PSTR("pressure");
+
+  #ifdef DEBUG_POLICY
+  dbgF("Report: ");
+  dbg(why ? FPSTR(why) : F("nothing new"));
+  dbgF(EOL);
+  #endif
+  return why != NULL;
+}
+
+/* ======================================================================
+Function: policyReported
+Purpose : remember what was successfully reported
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+void policyReported(void)
+{
+  _lastreport & l = state.last;
+
+  l.wake = state.wakes;
+  l.batt_zone = policyBattZone();
+  if (sensorHas(SENSOR_HAS_TEMPERATURE))
+    l.temperature = lroundf(sysinfo.temperature * 100);
+  if (sensorHas(SENSOR_HAS_HUMIDITY))
+    l.humidity = lroundf(sysinfo.humidity * 100);
+  if (sensorHas(SENSOR_HAS_PRESSURE))
+    l.pressure = lroundf(sysinfo.pressure * 100);
+}
@@ -0,0 +1,100 @@
+#include "app.h"
+#include "power.h"
+
+//#define DEBUG_POWER
+
+// Built in profiles
+static const _powerprofile powerProfiles[POWER_PROFILE_CUSTOM] PROGMEM =
+{
+  { 160, POWER_TX_MAX, WIFI_PHY_MODE_11N, WIFI_NONE_SLEEP  },  // max-speed
+  {  80, 68,           WIFI_PHY_MODE_11N, WIFI_MODEM_SLEEP },  // balanced
+  {  80, 48,           WIFI_PHY_MODE_11N, WIFI_LIGHT_SLEEP },  // min-energy
+};
+
+static const char powerName0[] PROGMEM = "max-speed";
+static const char powerName1[] PROGMEM = "balanced";
+static const char powerName2[] PROGMEM = "min-energy";
+static const char powerName3[] PROGMEM = "custom";
+static const char * const powerNames[POWER_PROFILE_MAX+1] PROGMEM =
+  { powerName0, powerName1, powerName2, powerName3 };
+
+/* ======================================================================
+Function: powerProfileName
+Purpose : get a profile name
+Input   : profile
+Output  : name (PROGMEM)
+Comments: -
+====================================================================== */
+const char * powerProfileName(uint8_t profile)
+{
+  if (profile > POWER_PROFILE_MAX)
+    profile = POWER_PROFILE_MAX_SPEED;
+  return (const char *) pgm_read_ptr(&powerNames[profile]);
+}
+
+/* ======================================================================
+Function: powerProfileByName
+Purpose : find a profile from its name or number
+Input   : name ("balanced") or number ("1")
+Output  : profile, -1 if unknown
+Comments: -
+====================================================================== */
+int8_t powerProfileByName(const char * name)
+{
+  if (isdigit(*name))
+  {
+    long profile = atol(name);
+    return (profile <= POWER_PROFILE_MAX) ? profile : -1;
+  }
+  for (uint8_t i=0; i<=POWER_PROFILE_MAX; i++)
+    if (!strcmp_P(name, powerProfileName(i)))
+      return i;
+  return -1;
+}
+
+/* ======================================================================
+Function: powerApply
+Purpose : switch to a power profile
+Input   : profile, false to leave the radio settings alone
+Output  : -
+Comments: the PHY mode can't change while associated, it is only set
+          when the radio is not connected yet
+====================================================================== */
+void powerApply(uint8_t profile, bool radio)
+{
+  _powerprofile p;
+
+  if (profile == POWER_PROFILE_CUSTOM)
+    p = config.power.custom;
+  else
+    memcpy_P(&p, &powerProfiles[profile < POWER_PROFILE_CUSTOM ? profile : 0], sizeof(p));
+
+  #ifdef DEBUG_POWER
+  dbg_s("Power %S: %dMHz tx %d phy %d sleep %d" EOL, powerProfileName(profile),
+         p.cpu, p.tx, p.phy, p.sleep);
+  #endif
+
+  if (p.cpu == 80 || p.cpu == 160)
+    system_update_cpu_freq(p.cpu);
+
+  if (!radio)
+    return;
+
+  if (WiFi.status() != WL_CONNECTED && p.phy >= WIFI_PHY_MODE_11B && p.phy <= WIFI_PHY_MODE_11N)
+    WiFi.setPhyMode((WiFiPhyMode_t) p.phy);
+  WiFi.setOutputPower(p.tx <= POWER_TX_MAX ? p.tx / 4.0f : POWER_TX_MAX / 4.0f);
+  if (p.sleep <= WIFI_MODEM_SLEEP)
+    WiFi.setSleepMode((WiFiSleepType_t) p.sleep);
+}
+
+/* ======================================================================
+Function: powerPhase
+Purpose : entering a wake phase, switch to its profile
+Input   : POWER_PHASE_*
+Output  : -
+Comments: radio is not touched in the sensor phase
+====================================================================== */
+void powerPhase(uint8_t phase)
+{
+  powerApply(config.power.phase[phase], phase != POWER_PHASE_SENSOR);
+}
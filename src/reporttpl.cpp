@@ -0,0 +1,332 @@
+#include "app.h"
+#include "state.h"
+#include "reporttpl.h"
+#include "sensor.h"
+#include "battery.h"
+#include "timemodel.h"
+#include "events.h"
+#include "stats.h"
+#include "sampler.h"
+
+// Placeholders, opcode TPL_OP_VALUE + index
+#define TPL_ID      0   // Chip ID, 6 hex digits
+#define TPL_MAC     1   // Station MAC address
+#define TPL_FW      2   // Firmware version, JSON escaped
+#define TPL_MSG     3   // config.report.msg, JSON escaped
+#define TPL_TEMP    4   // °C, null if no sensor
+#define TPL_HUM     5   // %
+#define TPL_PRESS   6   // hPa
+#define TPL_VBATT   7   // V
+#define TPL_SOC     8   // Battery charge (%)
+#define TPL_WAKE    9   // External or Timer
+#define TPL_WAKES   10  // Wake counter
+#define TPL_TIME    11  // Unix time, 0 if never set
+#define TPL_BOOT    12  // Boot to setup (µs)
+#define TPL_AWAKE   13  // Time awake (ms)
+#define TPL_RSSI    14  // WiFi signal (dBm)
+#define TPL_EVENTS  15  // Default report members, with their leading comma
+#define TPL_STATS   16
+#define TPL_SAMPLES 17
+#define TPL_VALUES  18
+
+static const char tplName0[] PROGMEM = "id";
+static const char tplName1[] PROGMEM = "mac";
+static const char tplName2[] PROGMEM = "fw";
+static const char tplName3[] PROGMEM = "msg";
+static const char tplName4[] PROGMEM = "temp";
+static const char tplName5[] PROGMEM = "hum";
+static const char tplName6[] PROGMEM = "press";
+static const char tplName7[] PROGMEM = "vbatt";
+static const char tplName8[] PROGMEM = "soc";
+static const char tplName9[] PROGMEM = "wake";
+static const char tplName10[] PROGMEM = "wakes";
+static const char tplName11[] PROGMEM = "time";
+static const char tplName12[] PROGMEM = "boot";
+static const char tplName13[] PROGMEM = "awake";
+static const char tplName14[] PROGMEM = "rssi";
+static const char tplName15[] PROGMEM = "events";
+static const char tplName16[] PROGMEM = "stats";
+static const char tplName17[] PROGMEM = "samples";
+static const char * const tplNames[TPL_VALUES] PROGMEM = {
+  tplName0, tplName1, tplName2, tplName3, tplName4, tplName5, tplName6, tplName7,
+  tplName8, tplName9, tplName10, tplName11, tplName12, tplName13, tplName14, tplName15,
+  tplName16, tplName17 };
+
+/* ======================================================================
+Function: tplFind
+Purpose : placeholder of a name
+Input   : name, not terminated
+          its length
+Output  : TPL_* index, -1 if unknown
+Comments: -
+====================================================================== */
+static int8_t tplFind(const char * name, uint8_t len)
+{
+  for (uint8_t i=0; i<TPL_VALUES; i++)
+  {
+    PGM_P p = (PGM_P) pgm_read_ptr(&tplNames[i]);
+    if (strlen_P(p) == len && !strncmp_P(name, p, len))
+      return i;
+  }
+  return -1;
+}
+
+/* ======================================================================
+Function: tplCompile
+Purpose : compile a report template text into opcodes
+Input   : text, empty for the default JSON report
+          opcodes, untouched on error
+          their size
+Output  : false if a placeholder is unknown or it does not fit
+Comments: the unused end of the opcodes is zeroed
+====================================================================== */
+bool tplCompile(const char * text, uint8_t * code, uint8_t size)
+{
+  uint8_t out[255];
+  uint8_t n = 0;
+
+  if (strlen(text) > TPL_TEXT_SIZE)
+    return false;
+
+  memset(out, 0, size);
+  while (*text)
+  {
+    uint8_t c = *text;
+
+    if (c == '{')
+    {
+      const char * end = text + 1;
+      while (*end >= 'a' && *end <= 'z')
+        end++;
+      if (*end == '}' && end > text + 1)
+      {
+        int8_t op = tplFind(text + 1, end - text - 1);
+        if (op < 0)
+        {
+          char name[TPL_NAME_SIZE+1];
+          uint8_t l = end - text - 1 < TPL_NAME_SIZE ? end - text - 1 : TPL_NAME_SIZE;
+          memcpy(name, text + 1, l);
+          name[l] = '\0';
+          dbg_s("Template: unknown {%s}" EOL, name);
+          return false;
+        }
+        if (n >= size)
+        {
+          dbgF("Template: too long" EOL);
+          return false;
+        }
+        out[n++] = TPL_OP_VALUE + op;
+        text = end + 1;
+        continue;
+      }
+    }
+
+    if (n + (c >= TPL_OP_VALUE ? 2 : 1) > size)
+    {
+      dbgF("Template: too long" EOL);
+      return false;
+    }
+    if (c >= TPL_OP_VALUE)
+      out[n++] = TPL_OP_BYTE;
+    out[n++] = c;
+    text++;
+  }
+
+  memcpy(code, out, size);
+  return true;
+}
+
+/* ======================================================================
+Function: tplSource
+Purpose : template text of compiled opcodes
+Input   : opcodes
+          their size
+          text, TPL_TEXT_SIZE+1 bytes
+Output  : -
+Comments: same as the text compiled
+====================================================================== */
+void tplSource(const uint8_t * code, uint8_t size, char * buf)
+{
+  char * p = buf;
+
+  for (uint8_t i=0; i<size && code[i]; i++)
+  {
+    uint8_t c = code[i];
+
+    if (c == TPL_OP_BYTE && i + 1 < size)
+      *p++ = code[++i];
+    else if (c >= TPL_OP_VALUE && c < TPL_OP_VALUE + TPL_VALUES)
+    {
+      *p++ = '{';
+      strcpy_P(p, (PGM_P) pgm_read_ptr(&tplNames[c - TPL_OP_VALUE]));
+      p += strlen(p);
+      *p++ = '}';
+    }
+    else
+      *p++ = c;
+  }
+  *p = '\0';
+}
+
+/* ======================================================================
+Function: tplSamples
+Purpose : check if compiled opcodes report the deep sleep samples
+Input   : opcodes
+          their size
+Output  : true if {samples} is used
+Comments: -
+====================================================================== */
+bool tplSamples(const uint8_t * code, uint8_t size)
+{
+  for (uint8_t i=0; i<size && code[i]; i++)
+  {
+    if (code[i] == TPL_OP_BYTE)
+      i++;
+    else if (code[i] == TPL_OP_VALUE + TPL_SAMPLES)
+      return true;
+  }
+  return false;
+}
+
+/* ======================================================================
+Function: tplValue
+Purpose : format a placeholder value
+Input   : TPL_* index
+          buffer of 24 bytes
+Output  : value
+Comments: sensors not fitted give null, as JSON
+====================================================================== */
+static const char * tplValue(uint8_t op, char * v)
+{
+  uint8_t mac[6];
+
+  switch (op)
+  {
+    case TPL_ID:
+      sprintf_P(v, PSTR("%06X"), ESP.getChipId());
+      break;
+    case TPL_MAC:
+      WiFi.macAddress(mac);
+      sprintf_P(v, PSTR("%02X:%02X:%02X:%02X:%02X:%02X"), mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+      break;
+    case TPL_TEMP:
+    case TPL_HUM:
+    case TPL_PRESS:
+      if (!sensorHas(1 << (op - TPL_TEMP)))
+        return "null";
+      dtostrf(op == TPL_TEMP ? sysinfo.temperature : op == TPL_HUM ? sysinfo.humidity : sysinfo.pressure, 1, 2, v);
+      break;
+    case TPL_VBATT:
+      dtostrf(sysinfo.vBatt, 1, 3, v);
+      break;
+    case TPL_SOC:
+      utoa(batterySoc() / 100, v, 10);
+      break;
+    case TPL_WAKE:
+      return sysinfo.extWake ? "External" : "Timer";
+    case TPL_WAKES:
+      utoa(state.wakes, v, 10);
+      break;
+    case TPL_TIME:
+      utoa(timeNow(), v, 10);
+      break;
+    case TPL_BOOT:
+      utoa(sysinfo.bootUs, v, 10);
+      break;
+    case TPL_AWAKE:
+      utoa(millis(), v, 10);
+      break;
+    case TPL_RSSI:
+      sprintf_P(v, PSTR("%d"), (int) WiFi.RSSI());
+      break;
+    default:
+      *v = '\0';
+  }
+  return v;
+}
+
+/* ======================================================================
+Function: tplEscape
+Purpose : append a text value, JSON escaped
+Input   : text
+          output buffer
+          its length, updated
+          its size
+Output  : false if it does not fit
+Comments: quotes and backslashes escaped, control characters dropped
+====================================================================== */
+static bool tplEscape(const char * s, char * out, uint16_t & n, uint16_t len)
+{
+  for (; *s; s++)
+  {
+    if ((uint8_t) *s < ' ')
+      continue;
+    if (n + 2 >= len)
+      return false;
+    if (*s == '"' || *s == '\\')
+      out[n++] = '\\';
+    out[n++] = *s;
+  }
+  return true;
+}
+
+/* ======================================================================
+Function: tplRender
+Purpose : run compiled opcodes
+Input   : opcodes
+          their size
+          output buffer, terminated
+          its size
+Output  : length, 0 if empty or it does not fit
+Comments: {events}, {stats} and {samples} are built as in the default
+          report, the only placeholders that allocate
+====================================================================== */
+uint16_t tplRender(const uint8_t * code, uint8_t size, char * out, uint16_t len)
+{
+  uint16_t n = 0;
+  char v[24];
+
+  for (uint8_t i=0; i<size && code[i]; i++)
+  {
+    uint8_t c = code[i];
+
+    if (c == TPL_OP_BYTE && i + 1 < size)
+      c = code[++i];
+    else if (c == TPL_OP_VALUE + TPL_FW || c == TPL_OP_VALUE + TPL_MSG)
+    {
+      if (!tplEscape(c == TPL_OP_VALUE + TPL_FW ? __version : config.report.msg, out, n, len))
+        return 0;
+      continue;
+    }
+    else if (c >= TPL_OP_VALUE + TPL_EVENTS && c < TPL_OP_VALUE + TPL_VALUES)
+    {
+      String r;
+      if (c == TPL_OP_VALUE + TPL_EVENTS)
+        eventJSON(r);
+      else if (c == TPL_OP_VALUE + TPL_STATS)
+        statsJSON(r);
+      else
+        samplerJSON(r);
+      if (n + r.length() >= len)
+        return 0;
+      memcpy(out + n, r.c_str(), r.length());
+      n += r.length();
+      continue;
+    }
+    else if (c >= TPL_OP_VALUE)
+    {
+      const char * s = tplValue(c - TPL_OP_VALUE, v);
+      uint16_t l = strlen(s);
+      if (n + l >= len)
+        return 0;
+      memcpy(out + n, s, l);
+      n += l;
+      continue;
+    }
+    if (n + 1 >= len)
+      return 0;
+    out[n++] = c;
+  }
+  out[n] = '\0';
+  return n;
+}
@@ -0,0 +1,327 @@
+#include "app.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "battery.h"
+
+//#define DEBUG_SAMPLER
+
+#define SAMPLER_MAGIC   0x5353
+#define SAMPLER_RF_OFF  0x01  // This wake was started with the radio disabled
+#define SAMPLER_FLUSH   0x02  // Rebooted with the radio to flush, sample already taken
+
+#pragma pack(push)  // push current alignment to stack
+#pragma pack(1)     // set alignment to 1 byte boundary
+
+// 332 bytes, multiple of 4 for the RTC memory access
+typedef struct
+{
+  uint16_t magic;                   // 2   SAMPLER_MAGIC
+  uint8_t  count;                   // 1   Samples stored, oldest first
+  uint8_t  next;                    // 1   Samples still to take before a flush
+  uint8_t  flags;                   // 1   SAMPLER_* flags
+  uint8_t  fed;                     // 1   Samples already given to the statistics
+  _sample  s[SAMPLER_MAX];          // 320
+  uint16_t taken;                   // 2   Intervals slept since the last upload wake
+  uint8_t  stretch;                 // 1   Interval multiplier, see battery.h
+  uint8_t  reserved;                // 1
+  uint16_t crc;                     // 2   CRC of the above
+} _rtcsamples;
+
+#pragma pack(pop)
+
+static_assert(sizeof(_rtcsamples) == SAMPLER_RTC_BLOCKS * 4, "RTC samples block size");
+
+static _rtcsamples rtc;
+static bool samplerTimer;           // Woken by the RTC timer, not a reset
+static bool samplerSent;            // This wake report carried the samples
+
+/* ======================================================================
+Function: samplerCrc
+Purpose : compute the CRC of the RTC samples block
+Input   : -
+Output  : CRC16
+Comments: -
+====================================================================== */
+static uint16_t samplerCrc(void)
+{
+  uint16_t crc = ~0;
+  const uint8_t * p = (const uint8_t *) &rtc;
+
+  for (uint16_t i=0; i<offsetof(_rtcsamples, crc); i++)
+    crc = crc16Update(crc, *p++);
+  return crc;
+}
+
+/* ======================================================================
+Function: samplerStore
+Purpose : write the samples block back to RTC memory
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+static void samplerStore(void)
+{
+  rtc.crc = samplerCrc();
+  ESP.rtcUserMemoryWrite(SAMPLER_RTC_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+}
+
+/* ======================================================================
+Function: samplerTake
+Purpose : convert this wake sensor readings into a sample
+Input   : sample to fill
+Output  : -
+Comments: values not read are 0
+====================================================================== */
+void samplerTake(_sample & s)
+{
+  s.vbatt = sysinfo.vBatt * 1000;
+  s.temperature = sensorHas(SENSOR_HAS_TEMPERATURE) ? lroundf(sysinfo.temperature * 100) : 0;
+  s.humidity = sensorHas(SENSOR_HAS_HUMIDITY) ? lroundf(sysinfo.humidity * 100) : 0;
+  s.pressure = sensorHas(SENSOR_HAS_PRESSURE) ? lroundf(sysinfo.pressure * 100) : 0;
+}
+
+/* ======================================================================
+Function: samplerEnabled
+Purpose : check if the board is scheduled by deep sleep
+Input   : -
+Output  : true if config.sleep.interval is set
+Comments: -
+====================================================================== */
+bool samplerEnabled(void)
+{
+  return config.sleep.interval != 0;
+}
+
+/* ======================================================================
+Function: samplerTimerWake
+Purpose : check if this boot is a deep sleep wake
+Input   : -
+Output  : false after a power on or a reset
+Comments: valid once samplerAdd() has been called
+====================================================================== */
+bool samplerTimerWake(void)
+{
+  return samplerTimer;
+}
+
+/* ======================================================================
+Function: samplerAdd
+Purpose : store this wake sample into RTC memory
+Input   : -
+Output  : true if the samples have to be uploaded on this wake
+Comments: when an upload is due on a wake started with the radio
+          disabled, the board reboots at once with it enabled and
+          does not return
+====================================================================== */
+bool samplerAdd(void)
+{
+  samplerTimer = ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE;
+
+  ESP.rtcUserMemoryRead(SAMPLER_RTC_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+  if (rtc.magic != SAMPLER_MAGIC || rtc.crc != samplerCrc() || rtc.count > SAMPLER_MAX)
+  {
+    // Power on, RTC memory content is random
+    memset(&rtc, 0, sizeof(rtc));
+    rtc.magic = SAMPLER_MAGIC;
+    rtc.next = config.sleep.flush;
+  }
+
+  // Came back with the radio, the sample was taken by the previous boot
+  if (rtc.flags & SAMPLER_FLUSH)
+  {
+    rtc.flags = 0;
+    return true;
+  }
+
+  // Full, drop the oldest one
+  if (rtc.count == SAMPLER_MAX)
+  {
+    memmove(&rtc.s[0], &rtc.s[1], --rtc.count * sizeof(_sample));
+    if (rtc.fed)
+      rtc.fed--;
+  }
+
+  samplerTake(rtc.s[rtc.count++]);
+  rtc.taken += samplerStretch();
+  if (rtc.next)
+    rtc.next--;
+
+  #ifdef DEBUG_SAMPLER
+  dbg_s("Sample %d, %d before flush%s" EOL, rtc.count, rtc.next,
+        samplerTimer ? "" : ", reset");
+  #endif
+
+  // Report straight away after a reset so the user sees it works
+  if (rtc.next && samplerTimer)
+    return false;
+
+  if (rtc.flags & SAMPLER_RF_OFF)
+  {
+    dbgF("Sampler: reboot with radio" EOL);
+    rtc.flags = SAMPLER_FLUSH;
+    samplerStore();
+    logFlush(LOG_FLUSH_TIMEOUT);
+    ESP.deepSleep(SAMPLER_HOP_US, WAKE_RF_DEFAULT);
+  }
+  return true;
+}
+
+/* ======================================================================
+Function: samplerTaken
+Purpose : number of intervals slept since the last upload wake
+Input   : -
+Output  : count, this wake one included
+Comments: counter restarts, each interval is counted once. A stretched
+          interval counts as several
+====================================================================== */
+uint16_t samplerTaken(void)
+{
+  uint16_t taken = rtc.taken;
+
+  rtc.taken = 0;
+  return taken;
+}
+
+/* ======================================================================
+Function: samplerReported
+Purpose : tell the samples are in the report being sent
+Input   : -
+Output  : -
+Comments: called by the report formats carrying all of them, the UDP
+          and ESP-NOW frames only carry the current values
+====================================================================== */
+void samplerReported(void)
+{
+  samplerSent = true;
+}
+
+/* ======================================================================
+Function: samplerFlushed
+Purpose : end of an upload wake
+Input   : true if the report was sent
+Output  : -
+Comments: samples are only cleared when the report carried them, see
+          samplerReported(). Else they are kept for the next upload, the
+          oldest ones are dropped when RTC memory is full. The battery
+          stretch changes with a report: kept samples may then span two
+          intervals, the report gives the current one
+====================================================================== */
+void samplerFlushed(bool reported)
+{
+  uint16_t next = config.sleep.flush ? config.sleep.flush : 1;
+
+  if (reported)
+  {
+    if (samplerSent)
+      rtc.count = rtc.fed = 0;
+    uint16_t most = SAMPLER_INTERVAL_MAX / config.sleep.interval;
+    rtc.stretch = batteryStretch() < most ? batteryStretch() : most;
+  }
+  rtc.next = next < SAMPLER_MAX ? next : SAMPLER_MAX;
+}
+
+/* ======================================================================
+Function: samplerStretch
+Purpose : current battery saving multiplier
+Input   : -
+Output  : 1 when not stretched
+Comments: applies to the interval only, uploads are then as far
+          apart as the reports of a stretched TPL5111 board
+====================================================================== */
+uint8_t samplerStretch(void)
+{
+  return samplerEnabled() && rtc.stretch ? rtc.stretch : 1;
+}
+
+/* ======================================================================
+Function: samplerSleep
+Purpose : deep sleep until next sample
+Input   : -
+Output  : -
+Comments: the radio is only enabled on the wake that will upload,
+          time spent awake is taken off the interval
+====================================================================== */
+void samplerSleep(void)
+{
+  uint64_t us = config.sleep.interval * samplerStretch() * 1000000ULL;
+  uint32_t awake = millis() * 1000UL;
+  RFMode rf = rtc.next <= 1 ? WAKE_RF_DEFAULT : WAKE_RF_DISABLED;
+
+  if (awake < us)
+    us -= awake;
+  rtc.flags = (rf == WAKE_RF_DISABLED) ? SAMPLER_RF_OFF : 0;
+  samplerStore();
+
+  dbg_s("Deep sleep %lus, radio %s" EOL, (unsigned long) (us / 1000000),
+        rf == WAKE_RF_DISABLED ? "off" : "on");
+  logFlush(LOG_FLUSH_TIMEOUT);
+  ESP.deepSleep(us, rf);
+}
+
+/* ======================================================================
+Function: samplerCount
+Purpose : number of samples waiting for upload
+Input   : -
+Output  : count
+Comments: -
+====================================================================== */
+uint8_t samplerCount(void)
+{
+  return samplerEnabled() ? rtc.count : 0;
+}
+
+/* ======================================================================
+Function: samplerGet
+Purpose : get a sample waiting for upload
+Input   : index, 0 is the oldest
+Output  : sample, NULL if none
+Comments: -
+====================================================================== */
+const _sample * samplerGet(uint8_t i)
+{
+  return i < samplerCount() ? &rtc.s[i] : NULL;
+}
+
+/* ======================================================================
+Function: samplerNext
+Purpose : get the next sample not given to the statistics yet
+Input   : -
+Output  : sample, NULL if none left
+Comments: each sample is returned once, even if kept for another upload
+====================================================================== */
+const _sample * samplerNext(void)
+{
+  return rtc.fed < samplerCount() ? &rtc.s[rtc.fed++] : NULL;
+}
+
+/* ======================================================================
+Function: samplerJSON
+Purpose : append the samples to a JSON report
+Input   : report being built, without its closing brace
+Output  : -
+Comments: ,"interval":s,"samples":[[temp,hum,press,vbatt],..] oldest
+          first, in 1/100 °C, 1/100 %, Pa and mV. Nothing is added when
+          not in deep sleep mode
+====================================================================== */
+void samplerJSON(String & r)
+{
+  if (!samplerCount())
+    return;
+
+  r += F(",\"interval\":");
+  r += config.sleep.interval * samplerStretch();
+  r += F(",\"samples\":[");
+  for (uint8_t i=0; i<rtc.count; i++)
+  {
+    const _sample & s = rtc.s[i];
+    if (i)
+      r += ',';
+    r += '[';
+    r += s.temperature; r += ',';
+    r += s.humidity;    r += ',';
+    r += s.pressure;    r += ',';
+    r += s.vbatt;
+    r += ']';
+  }
+  r += ']';
+}
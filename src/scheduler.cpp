@@ -0,0 +1,171 @@
+#include "app.h"
+#include "scheduler.h"
+
+//#define DEBUG_SCHED
+
+static _schedtask schedTask[SCHED_TASKS_MAX];  // Sorted by priority
+static uint8_t  schedCount;
+static int8_t   schedCurrent = -1;             // Task running
+static uint32_t schedPasses;
+
+/* ======================================================================
+Function: schedAdd
+Purpose : add a task to the scheduler
+Input   : name (PROGMEM), function, SCHED_PRIO_*, period (ms, 0 on every
+          pass), deadline (ms)
+Output  : false if there is no slot left
+Comments: the task is due at once
+====================================================================== */
+bool schedAdd(PGM_P name, _schedfn fn, uint8_t prio, uint16_t period, uint16_t deadline)
+{
+  uint8_t i;
+
+  if (schedCount >= SCHED_TASKS_MAX)
+  {
+    logE("No slot for task %S" EOL, name);
+    return false;
+  }
+
+  // After the ones of the same priority
+  for (i = schedCount; i && schedTask[i - 1].prio > prio; i--)
+    schedTask[i] = schedTask[i - 1];
+  schedCount++;
+
+  memset(&schedTask[i], 0, sizeof(_schedtask));
+  schedTask[i].name = name;
+  schedTask[i].fn = fn;
+  schedTask[i].prio = prio;
+  schedTask[i].period = period;
+  schedTask[i].deadline = deadline;
+  schedTask[i].due = millis();
+  return true;
+}
+
+/* ======================================================================
+Function: schedDelay
+Purpose : set when the running task runs next
+Input   : delay (ms)
+Output  : -
+Comments: instead of its period, this time only. For tasks working in
+          slices, e.g. polling a conversion before going back to sleep
+====================================================================== */
+void schedDelay(uint16_t ms)
+{
+  if (schedCurrent >= 0)
+    schedTask[schedCurrent].due = millis() + ms;
+}
+
+/* ======================================================================
+Function: schedExec
+Purpose : run a task and account for it
+Input   : task, time (ms)
+Output  : -
+Comments: for tasks run on every pass, the delay since the previous run
+          is the lateness
+====================================================================== */
+static void schedExec(uint8_t i, uint32_t now)
+{
+  _schedtask & t = schedTask[i];
+  uint32_t late = now - t.due;
+  uint32_t start, us;
+
+  if (late > t.lateMax)
+    t.lateMax = late;
+  if (late > t.deadline && t.runs)
+  {
+    t.missed++;
+    #ifdef DEBUG_SCHED
+    dbg_s("Task %S late by %lums" EOL, t.name, late);
+    #endif
+  }
+
+  t.due = now + t.period;
+  schedCurrent = i;
+  start = micros();
+  t.fn();
+  us = micros() - start;
+  schedCurrent = -1;
+
+  t.runs++;
+  t.usTotal += us;
+  if (us > t.usMax)
+    t.usMax = us;
+}
+
+/* ======================================================================
+Function: schedRun
+Purpose : one scheduler pass
+Input   : -
+Output  : -
+Comments: all the I/O tasks due, then the first other task due by
+          priority and due time
+====================================================================== */
+void schedRun(void)
+{
+  int8_t next = -1;
+
+  schedPasses++;
+  for (uint8_t i = 0; i < schedCount; i++)
+  {
+    _schedtask & t = schedTask[i];
+    uint32_t now = millis();
+
+    if ((int32_t) (now - t.due) < 0)
+      continue;
+    if (t.prio == SCHED_PRIO_IO)
+      schedExec(i, now);
+    else if (next < 0 || (t.prio == schedTask[next].prio &&
+                          (int32_t) (t.due - schedTask[next].due) < 0))
+      next = i;
+  }
+
+  if (next >= 0)
+    schedExec(next, millis());
+}
+
+/* ======================================================================
+Function: schedJSON
+Purpose : scheduler statistics in JSON
+Input   : response
+Output  : -
+Comments: load is the share of the uptime spent in the task (1/10 %)
+====================================================================== */
+void schedJSON(String & r)
+{
+  uint32_t uptime = millis();
+
+  r = F("{\"uptime\":");
+  r += uptime;
+  r += F(",\"passes\":");
+  r += schedPasses;
+  r += F(",\"tasks\":[");
+  for (uint8_t i = 0; i < schedCount; i++)
+  {
+    _schedtask & t = schedTask[i];
+
+    if (i)
+      r += ',';
+    r += F("\r\n{\"name\":\"");
+    r += FPSTR(t.name);
+    r += F("\",\"prio\":");
+    r += t.prio;
+    r += F(",\"period\":");
+    r += t.period;
+    r += F(",\"deadline\":");
+    r += t.deadline;
+    r += F(",\"runs\":");
+    r += t.runs;
+    r += F(",\"missed\":");
+    r += t.missed;
+    r += F(",\"late_max\":");
+    r += t.lateMax;
+    r += F(",\"us_avg\":");
+    r += t.runs ? (uint32_t) (t.usTotal / t.runs) : 0;
+    r += F(",\"us_max\":");
+    r += t.usMax;
+    r += F(",\"load\":");
+    r += uptime ? (uint32_t) (t.usTotal / uptime) : 0;
+    r += '}';
+  }
+  r += F("\r\n]}\r\n");
+}
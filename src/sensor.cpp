@@ -0,0 +1,220 @@
+#include "app.h"
+#include "sensor.h"
+#include "scheduler.h"
+
+//#define DEBUG_SENSOR
+
+// Driver registry, NULL entries are drivers left out of the build
+typedef SensorDriver * (* _sensorfactory)(void);
+static const _sensorfactory sensorDrivers[] =
+{
+  featureBME280 ? bme280Driver : NULL,
+};
+#define SENSOR_DRIVERS (sizeof(sensorDrivers) / sizeof(sensorDrivers[0]))
+
+static SensorDriver * sensorDriver[SENSOR_DRIVERS];     // Fitted ones
+static uint8_t sensorFirst[SENSOR_DRIVERS];             // Their first channel
+static uint8_t sensorCount[SENSOR_DRIVERS];             // Their channel count
+static const _sensorchannel * sensorDesc[SENSOR_CHANNELS_MAX];
+static float sensorValue[SENSOR_CHANNELS_MAX];
+static uint16_t sensorValid;                            // Channels read
+static uint8_t sensorTotal;                             // Channels of fitted drivers
+static uint8_t sensorPending;                           // Drivers converting
+static uint32_t sensorStart;                            // Conversions start (ms)
+static bool sensorRefreshing;                           // See sensorsTask()
+
+/* ======================================================================
+Function: sensorsStart
+Purpose : probe the sensors and start all their conversions
+Input   : -
+Output  : -
+Comments: conversions run while the wake goes on, see sensorsCollect()
+====================================================================== */
+void sensorsStart(void)
+{
+  sensorTotal = 0;
+  sensorValid = 0;
+
+  for (uint8_t d = 0; d < SENSOR_DRIVERS; d++)
+  {
+    SensorDriver * driver = sensorDrivers[d] ? sensorDrivers[d]() : NULL;
+    uint8_t count = 0;
+    const _sensorchannel * desc;
+
+    sensorDriver[d] = NULL;
+    if (!driver || !driver->begin())
+      continue;
+    desc = driver->channels(count);
+    if (sensorTotal + count > SENSOR_CHANNELS_MAX)
+      break;
+
+    sensorDriver[d] = driver;
+    sensorFirst[d] = sensorTotal;
+    sensorCount[d] = count;
+    for (uint8_t i = 0; i < count; i++)
+      sensorDesc[sensorTotal++] = &desc[i];
+  }
+  sensorsRefresh();
+}
+
+/* ======================================================================
+Function: sensorsRefresh
+Purpose : start new conversions of the fitted sensors
+Input   : -
+Output  : -
+Comments: values read before stay available until the new ones are
+====================================================================== */
+void sensorsRefresh(void)
+{
+  sensorPending = 0;
+  sensorStart = millis();
+  for (uint8_t d = 0; d < SENSOR_DRIVERS; d++)
+  {
+    if (!sensorDriver[d])
+      continue;
+    sensorDriver[d]->startConversion();
+    sensorPending |= 1 << d;
+  }
+}
+
+/* ======================================================================
+Function: sensorsPoll
+Purpose : read the sensors done converting, without waiting
+Input   : -
+Output  : true once all of them are read or timed out
+Comments: each sensor is read as soon as it is done, so they cost the
+          longest conversion time, not the sum of them. The first channel
+          of each known quantity then goes into sysinfo
+====================================================================== */
+bool sensorsPoll(void)
+{
+  for (uint8_t d = 0; d < SENSOR_DRIVERS; d++)
+  {
+    if (!(sensorPending & (1 << d)) || !sensorDriver[d]->poll())
+      continue;
+    sensorPending &= ~(1 << d);
+    if (sensorDriver[d]->read(&sensorValue[sensorFirst[d]]))
+      sensorValid |= ((1 << sensorCount[d]) - 1) << sensorFirst[d];
+    #ifdef DEBUG_SENSOR
+    dbg_s("Sensor %d read after %lums" EOL, d, millis() - sensorStart);
+    #endif
+  }
+  if (sensorPending && millis() - sensorStart < SENSOR_TIMEOUT)
+    return false;
+  if (sensorPending)
+    logW("Sensor timeout %02X" EOL, sensorPending);
+  sensorPending = 0;
+
+  sysinfo.sensors = 0;
+  for (uint8_t i = 0; i < sensorTotal; i++)
+  {
+    _sensorchannel desc;
+    float value;
+
+    if (!sensorGet(i, desc, value) || desc.quantity >= SENSOR_OTHER ||
+        sensorHas(1 << desc.quantity))
+      continue;
+    sysinfo.sensors |= 1 << desc.quantity;
+    if (desc.quantity == SENSOR_TEMPERATURE)
+      sysinfo.temperature = value;
+    else if (desc.quantity == SENSOR_HUMIDITY)
+      sysinfo.humidity = value;
+    else
+      sysinfo.pressure = value;
+  }
+  return true;
+}
+
+/* ======================================================================
+Function: sensorsCollect
+Purpose : wait for the conversions and read the sensors
+Input   : -
+Output  : -
+Comments: see sensorsPoll()
+====================================================================== */
+void sensorsCollect(void)
+{
+  while (!sensorsPoll())
+    delay(1);
+}
+
+/* ======================================================================
+Function: sensorsTask
+Purpose : config mode refresh of the sensors, see scheduler.h
+Input   : -
+Output  : -
+Comments: starts the conversions, then polls them in short slices
+====================================================================== */
+void sensorsTask(void)
+{
+  if (!sensorRefreshing)
+    sensorsRefresh();
+  sensorRefreshing = !sensorsPoll();
+  if (sensorRefreshing)
+    schedDelay(SENSOR_POLL_MS);
+}
+
+/* ======================================================================
+Function: sensorChannels
+Purpose : number of channels of the fitted sensors
+Input   : -
+Output  : count
+Comments: -
+====================================================================== */
+uint8_t sensorChannels(void)
+{
+  return sensorTotal;
+}
+
+/* ======================================================================
+Function: sensorGet
+Purpose : get a channel descriptor and value
+Input   : channel, descriptor and value to fill
+Output  : false if the channel was not read
+Comments: descriptor strings stay in flash
+====================================================================== */
+bool sensorGet(uint8_t i, _sensorchannel & desc, float & value)
+{
+  if (i >= sensorTotal)
+    return false;
+  memcpy_P(&desc, sensorDesc[i], sizeof(desc));
+  value = sensorValue[i];
+  return sensorValid & (1 << i);
+}
+
+/* ======================================================================
+Function: sensorHas
+Purpose : check quantities were read on this wake
+Input   : SENSOR_HAS_* mask
+Output  : true if all of them are in sysinfo
+Comments: -
+====================================================================== */
+bool sensorHas(uint8_t quantities)
+{
+  return (sysinfo.sensors & quantities) == quantities;
+}
+
+/* ======================================================================
+Function: sensorJSON
+Purpose : append the channels read to a JSON report
+Input   : report being built, without its closing brace, SENSOR_HAS_*
+          quantities to leave out
+Output  : -
+Comments: ,"key":value for each channel
+====================================================================== */
+void sensorJSON(String & r, uint8_t skip)
+{
+  for (uint8_t i = 0; i < sensorTotal; i++)
+  {
+    _sensorchannel desc;
+    float value;
+
+    if (!sensorGet(i, desc, value) ||
+        (desc.quantity < SENSOR_OTHER && (skip & (1 << desc.quantity))))
+      continue;
+    r += F(",\"");
+    r += FPSTR(desc.key);
+    r += F("\":");
+    r += String(value, desc.decimals);
+  }
+}
@@ -0,0 +1,160 @@
+#include "state.h"
+#include "log.h"
+
+#include <EEPROM.h>
+
+// EEPROM flash sector, from the linker script as the core EEPROM library
+extern "C" uint32_t _EEPROM_start;
+
+// Runtime state kept across power cycles
+_State state;
+
+static bool     stateLoaded;        // stateInit() done, the state can be staged
+static int8_t   stateSlot = -1;     // Next free journal record, -1 if unknown or full
+static bool     stateJournal;       // This wake may be journaled, see stateWake()
+static _wakerec stateRec;           // Its record
+static _State   stateWoke;          // State right after it
+
+/* ======================================================================
+Function: stateJournalAddr
+Purpose : flash address of a journal record
+Input   : record index
+Output  : address, as ESP.flashRead()
+Comments: -
+====================================================================== */
+static uint32_t stateJournalAddr(uint8_t i)
+{
+  return (uint32_t) (uintptr_t) &_EEPROM_start - 0x40200000 + STATE_JOURNAL_ADDR + i * sizeof(_wakerec);
+}
+
+/* ======================================================================
+Function: stateRecCrc
+Purpose : CRC of a journal record
+Input   : record
+Output  : CRC of all but its CRC field
+Comments: -
+====================================================================== */
+static uint16_t stateRecCrc(const _wakerec & r)
+{
+  const uint8_t * p = (const uint8_t *) &r;
+  uint16_t crc = ~0;
+
+  for (uint8_t i = 0; i < sizeof(_wakerec) - 2; i++)
+    crc = crc16Update(crc, *p++);
+  return crc;
+}
+
+/* ======================================================================
+Function: stateInit
+Purpose : load runtime state from EEPROM
+Input   : -
+Output  : -
+Comments: must be called after cfgInit() which opens the EEPROM,
+          a bad CRC (first boot, layout change) starts from a clean state.
+          Journaled wakes are not applied, see stateReplay()
+====================================================================== */
+void stateInit(void)
+{
+  if (eepromReadBlock(EEPROM_STATE_ADDR, &state, sizeof(_State)))
+    stateSlot = 0;
+  else
+    dbgF("State reset" EOL);
+  stateLoaded = true;
+}
+
+/* ======================================================================
+Function: stateReplay
+Purpose : read the next wake journaled since the last commit
+Input   : record read
+Output  : true if one was read, it has to be applied as on its wake
+Comments: call until false before stateWake(). A record cut by a power
+          loss ends the journal, the next save then commits
+====================================================================== */
+bool stateReplay(_wakerec & r)
+{
+  uint32_t buf[sizeof(_wakerec) / 4];
+
+  if (stateSlot < 0 || stateSlot >= (int8_t) STATE_JOURNAL_RECS ||
+      !ESP.flashRead(stateJournalAddr(stateSlot), buf, sizeof(buf)))
+  {
+    stateSlot = -1;
+    return false;
+  }
+
+  memcpy(&r, buf, sizeof(r));
+  if (r.magic == STATE_JOURNAL_MAGIC && r.crc == stateRecCrc(r))
+  {
+    stateSlot++;
+    return true;
+  }
+
+  // Free slots are erased, anything else is a cut write
+  for (uint8_t i = 0; i < sizeof(buf) / 4; i++)
+    if (buf[i] != 0xFFFFFFFF)
+      stateSlot = -1;
+  return false;
+}
+
+/* ======================================================================
+Function: stateWake
+Purpose : allow this wake to be journaled instead of committed
+Input   : its record, flags and sample set
+Output  : -
+Comments: called right after applying it to the state, stateSave() then
+          journals it if nothing else changed since
+====================================================================== */
+void stateWake(const _wakerec & r)
+{
+  stateRec = r;
+  stateRec.magic = STATE_JOURNAL_MAGIC;
+  stateRec.reserved = 0xFFFF;
+  stateRec.crc = stateRecCrc(stateRec);
+  stateWoke = state;
+  stateJournal = true;
+}
+
+/* ======================================================================
+Function: stateStage
+Purpose : put the runtime state into the EEPROM buffer
+Input   : -
+Output  : -
+Comments: any EEPROM commit erases the journal, so the state has to
+          go along with it
+====================================================================== */
+void stateStage(void)
+{
+  if (!stateLoaded)
+    return;
+  eepromWriteBlock(EEPROM_STATE_ADDR, &state, sizeof(_State), false);
+  stateSlot = -1;
+}
+
+/* ======================================================================
+Function: stateSave
+Purpose : save runtime state to EEPROM
+Input   : -
+Output  : true if saved (or unchanged)
+Comments: a wake allowed by stateWake() is appended to the journal when
+          the state did not change since and no log waits for a commit.
+          Else flash is only written when some byte actually changed
+====================================================================== */
+bool stateSave(void)
+{
+  uint32_t buf[sizeof(_wakerec) / 4];
+
+  if (stateJournal && stateSlot >= 0 && stateSlot < (int8_t) STATE_JOURNAL_RECS &&
+      !logStaged() && !memcmp(&state, &stateWoke, sizeof(_State) - 2))
+  {
+    memcpy(buf, &stateRec, sizeof(buf));
+    stateJournal = false;
+    if (ESP.flashWrite(stateJournalAddr(stateSlot), buf, sizeof(buf)))
+    {
+      stateSlot++;
+      return true;
+    }
+  }
+
+  stateJournal = false;
+  stateSlot = -1;
+  return eepromWriteBlock(EEPROM_STATE_ADDR, &state, sizeof(_State));
+}
@@ -0,0 +1,186 @@
+#include "app.h"
+#include "state.h"
+#include "stats.h"
+#include "timemodel.h"
+#include "sensor.h"
+
+//#define DEBUG_STATS
+
+// Channel names and divider to report units (°C, %, hPa, V)
+static const char statsName0[] PROGMEM = "temperature";
+static const char statsName1[] PROGMEM = "humidity";
+static const char statsName2[] PROGMEM = "pressure";
+static const char statsName3[] PROGMEM = "battery";
+static const char * const statsNames[STATS_CHANNELS] PROGMEM =
+  { statsName0, statsName1, statsName2, statsName3 };
+static const uint16_t statsScale[STATS_CHANNELS] PROGMEM = { 100, 100, 100, 1000 };
+
+/* ======================================================================
+Function: statsEnabled
+Purpose : check if statistics are computed
+Input   : -
+Output  : true if a window is configured
+Comments: -
+====================================================================== */
+bool statsEnabled(void)
+{
+  return config.stats.window != 0;
+}
+
+/* ======================================================================
+Function: statsPeriod
+Purpose : time between two samples
+Input   : -
+Output  : seconds
+Comments: calibrated by the time model
+====================================================================== */
+static uint16_t statsPeriod(void)
+{
+  return (timePeriod() + 500) / 1000;
+}
+
+/* ======================================================================
+Function: statsAdd
+Purpose : add one sample to the current window
+Input   : sample
+Output  : -
+Comments: Welford's algorithm, O(1) state per channel and no loss of
+          precision from summing squares. A full window is moved to
+          done, replacing one not reported yet
+====================================================================== */
+void statsAdd(const _sample & s)
+{
+  if (!statsEnabled())
+    return;
+
+  _statswin & w = state.stats.cur;
+  const int32_t v[STATS_CHANNELS] = { s.temperature, s.humidity, (int32_t) s.pressure, s.vbatt };
+  uint16_t at = w.n++;
+
+  for (uint8_t i=0; i<STATS_CHANNELS; i++)
+  {
+    _statchan & c = w.ch[i];
+    float delta = v[i] - c.mean;
+
+    c.mean += delta / w.n;
+    c.m2 += delta * (v[i] - c.mean);
+    if (!at || v[i] < c.min)
+    {
+      c.min = v[i];
+      c.min_at = at;
+    }
+    if (!at || v[i] > c.max)
+    {
+      c.max = v[i];
+      c.max_at = at;
+    }
+  }
+
+  if (w.n >= config.stats.window)
+  {
+    state.stats.done = w;
+    memset(&w, 0, sizeof(w));
+  }
+
+  #ifdef DEBUG_STATS
+  dbg_s("Stats: %u samples, T mean %d" EOL, state.stats.cur.n,
+        (int) state.stats.cur.ch[STATS_TEMPERATURE].mean);
+  #endif
+}
+
+/* ======================================================================
+Function: statsReported
+Purpose : statistics were successfully reported
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+void statsReported(void)
+{
+  state.stats.done.n = 0;
+  if (config.stats.flags & STATS_PER_REPORT)
+    memset(&state.stats.cur, 0, sizeof(_statswin));
+}
+
+/* ======================================================================
+Function: statsReplace
+Purpose : check if the last values have to be left out of reports
+Input   : -
+Output  : true if reports carry the statistics instead
+Comments: -
+====================================================================== */
+bool statsReplace(void)
+{
+  return statsEnabled() && (config.stats.flags & STATS_REPLACE);
+}
+
+/* ======================================================================
+Function: statsWinJSON
+Purpose : append one window to a JSON report
+Input   : report being built, window name, window
+Output  : -
+Comments: ages are seconds between the sample and the last one of the
+          window
+====================================================================== */
+static void statsWinJSON(String & r, const __FlashStringHelper * name, const _statswin & w)
+{
+  uint16_t period = statsPeriod();
+
+  r += F(",\"");
+  r += name;
+  r += F("\":{\"n\":");
+  r += w.n;
+  r += F(",\"age\":");
+  r += (uint32_t) (w.n - 1) * period;
+
+  for (uint8_t i=0; i<STATS_CHANNELS; i++)
+  {
+    const _statchan & c = w.ch[i];
+    float scale = pgm_read_word(&statsScale[i]);
+
+    // STATS_* sensor channels are in SENSOR_* quantities order
+    if (i != STATS_VBATT && !sensorHas(1 << i))
+      continue;
+
+    r += F(",\"");
+    r += FPSTR((const char *) pgm_read_ptr(&statsNames[i]));
+    r += F("\":{\"mean\":");
+    r += String(c.mean / scale, 3);
+    r += F(",\"sd\":");
+    r += String(w.n > 1 ? sqrtf(c.m2 / (w.n - 1)) / scale : 0.0f, 3);
+    r += F(",\"min\":");
+    r += String(c.min / scale, 2);
+    r += F(",\"min_age\":");
+    r += (uint32_t) (w.n - 1 - c.min_at) * period;
+    r += F(",\"max\":");
+    r += String(c.max / scale, 2);
+    r += F(",\"max_age\":");
+    r += (uint32_t) (w.n - 1 - c.max_at) * period;
+    r += '}';
+  }
+  r += '}';
+}
+
+/* ======================================================================
+Function: statsJSON
+Purpose : append the statistics to a JSON report
+Input   : report being built, without its closing brace
+Output  : -
+Comments: ,"stats":{"window":N,"current":{..},"last":{..}} with empty
+          windows left out. Nothing is added when disabled
+====================================================================== */
+void statsJSON(String & r)
+{
+  const _stats & s = state.stats;
+
+  if (!statsEnabled() || (!s.cur.n && !s.done.n))
+    return;
+
+  r += F(",\"stats\":{\"window\":");
+  r += config.stats.window;
+  if (s.cur.n)
+    statsWinJSON(r, F("current"), s.cur);
+  if (s.done.n)
+    statsWinJSON(r, F("last"), s.done);
+  r += '}';
+}
@@ -0,0 +1,268 @@
+#include "app.h"
+#include "state.h"
+#include "sampler.h"
+#include "timemodel.h"
+
+//#define DEBUG_TIME
+
+/* ======================================================================
+Function: timeNominal
+Purpose : tick period from the scheduling settings
+Input   : -
+Output  : seconds
+Comments: -
+====================================================================== */
+static uint16_t timeNominal(void)
+{
+  return samplerEnabled() ? config.sleep.interval : WAKE_PERIOD;
+}
+
+/* ======================================================================
+Function: timePeriod
+Purpose : best known tick period
+Input   : -
+Output  : milliseconds
+Comments: calibrated one if any for the current scheduling, else nominal
+====================================================================== */
+uint32_t timePeriod(void)
+{
+  const _timestate & t = state.time;
+
+  if (t.period && t.nominal == timeNominal())
+    return t.period;
+  return timeNominal() * 1000UL;
+}
+
+/* ======================================================================
+Function: timeWake
+Purpose : count the ticks elapsed since the previous wake
+Input   : ticks, 1 with the TPL5111, samples taken in deep sleep mode,
+          0 on an external wake
+Output  : -
+Comments: -
+====================================================================== */
+void timeWake(uint16_t ticks)
+{
+  state.time.ticks += ticks;
+}
+
+/* ======================================================================
+Function: timeNow
+Purpose : estimated current time
+Input   : -
+Output  : Unix time, 0 if never synchronised
+Comments: -
+====================================================================== */
+uint32_t timeNow(void)
+{
+  const _timestate & t = state.time;
+
+  if (!t.epoch)
+    return 0;
+  return t.epoch + (uint64_t) (t.ticks - t.tick) * timePeriod() / 1000 + millis() / 1000;
+}
+
+/* ======================================================================
+Function: timeError
+Purpose : estimated error of timeNow()
+Input   : -
+Output  : seconds, 0xFFFFFFFF if never synchronised
+Comments: anchor resolution plus the period uncertainty over the ticks
+          elapsed since then
+====================================================================== */
+uint32_t timeError(void)
+{
+  const _timestate & t = state.time;
+  uint32_t ppm = (t.period && t.nominal == timeNominal()) ? TIME_DRIFT_PPM_CAL : TIME_DRIFT_PPM_RAW;
+
+  if (!t.epoch)
+    return 0xFFFFFFFF;
+  return (t.source == TIME_SOURCE_DATE ? 1 : 0) +
+         (uint64_t) (t.ticks - t.tick) * timePeriod() / 1000 * ppm / 1000000;
+}
+
+/* ======================================================================
+Function: timeSet
+Purpose : synchronise the time model
+Input   : current Unix time, TIME_SOURCE_*
+Output  : -
+Comments: the tick period is calibrated against the previous anchor
+          when it is old enough for the source resolution not to matter.
+          A Date header does not replace a more precise estimate.
+          External wakes are not ticks, they can not anchor the model
+====================================================================== */
+void timeSet(uint32_t epoch, uint8_t source)
+{
+  _timestate & t = state.time;
+  uint32_t start = epoch - millis() / 1000;
+  uint16_t nominal = timeNominal();
+
+  if (sysinfo.extWake || (source == TIME_SOURCE_DATE && t.epoch && timeError() <= 1))
+    return;
+
+  // Scheduling changed, so did the period
+  if (t.nominal != nominal)
+  {
+    t.nominal = nominal;
+    t.period = 0;
+    t.cal_epoch = 0;
+  }
+
+  if (!t.cal_epoch || start < t.cal_epoch || t.ticks == t.cal_tick)
+  {
+    t.cal_epoch = start;
+    t.cal_tick = t.ticks;
+  }
+  else if (start - t.cal_epoch >= TIME_CALIB_MIN_SECONDS)
+  {
+    uint32_t p = (uint64_t) (start - t.cal_epoch) * 1000 / (t.ticks - t.cal_tick);
+    uint32_t n = nominal * 1000UL;
+
+    // Otherwise ticks were missed (power loss, samples dropped)
+    if (p > n - n / TIME_CALIB_RANGE && p < n + n / TIME_CALIB_RANGE)
+      t.period = t.period ? (3ULL * t.period + p) / 4 : p;
+
+    #ifdef DEBUG_TIME
+    dbg_s("Time: period %lums, calibrated %lums" EOL, (unsigned long) p, (unsigned long) t.period);
+    #endif
+    t.cal_epoch = start;
+    t.cal_tick = t.ticks;
+  }
+
+  #ifdef DEBUG_TIME
+  dbg_s("Time: %lu from %d, estimate was %lu" EOL, (unsigned long) epoch, source,
+        (unsigned long) timeNow());
+  #endif
+  t.epoch = start;
+  t.tick = t.ticks;
+  t.source = source;
+}
+
+/* ======================================================================
+Function: timeHttpDate
+Purpose : synchronise from an HTTP Date header
+Input   : header value "Sun, 06 Nov 1994 08:49:37 GMT"
+Output  : false if it can not be parsed
+Comments: -
+====================================================================== */
+bool timeHttpDate(const char * date)
+{
+  static const char months[] PROGMEM = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char mon[4];
+  int d, y, hh, mm, ss;
+  int m = 0;
+
+  if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d", &d, mon, &y, &hh, &mm, &ss) != 6 || y < 2000)
+    return false;
+
+  // Month names stay in flash, compared 3 bytes at a time
+  while (m < 12 && memcmp_P(mon, months + m * 3, 3))
+    m++;
+  if (m++ == 12)
+    return false;
+
+  // Days since 1970 (days from civil algorithm, years start in March)
+  y -= m <= 2;
+  uint32_t era = y / 400;
+  uint32_t yoe = y - era * 400;
+  uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  uint32_t days = era * 146097 + doe - 719468;
+
+  timeSet(days * 86400 + hh * 3600 + mm * 60 + ss, TIME_SOURCE_DATE);
+  return true;
+}
+
+/* ======================================================================
+Function: timeSntp
+Purpose : get the time from the SNTP server
+Input   : -
+Output  : true if synchronised
+Comments: single request, WiFi has to be connected
+====================================================================== */
+static bool timeSntp(void)
+{
+  uint8_t pkt[TIME_NTP_PACKET_SIZE];
+  IPAddress ip;
+  WiFiUDP udp;
+  bool ret = false;
+
+  if (!WiFi.hostByName(config.time.ntp, ip) || !udp.begin(1024 + (RANDOM_REG32 & 0x7FFF)))
+    return false;
+
+  // LI 0, version 3, mode client
+  memset(pkt, 0, sizeof(pkt));
+  pkt[0] = 0x1B;
+  udp.beginPacket(ip, TIME_NTP_PORT);
+  udp.write(pkt, sizeof(pkt));
+  if (udp.endPacket())
+  {
+    uint32_t start = millis();
+    while (!ret && millis() - start < TIME_NTP_TIMEOUT)
+    {
+      if (udp.parsePacket() >= TIME_NTP_PACKET_SIZE &&
+          udp.read(pkt, sizeof(pkt)) == TIME_NTP_PACKET_SIZE)
+      {
+        // Transmit timestamp seconds, rounded with the fraction MSB
+        uint32_t secs = (uint32_t) pkt[40] << 24 | (uint32_t) pkt[41] << 16 |
+                        (uint32_t) pkt[42] << 8 | pkt[43];
+        if (secs > TIME_NTP_UNIX_OFFSET)
+        {
+          timeSet(secs - TIME_NTP_UNIX_OFFSET + (pkt[44] >> 7), TIME_SOURCE_SNTP);
+          ret = true;
+        }
+      }
+      else
+        delay(1);
+    }
+  }
+  udp.stop();
+  return ret;
+}
+
+/* ======================================================================
+Function: timeSync
+Purpose : synchronise with SNTP if the estimate may be too far off
+Input   : -
+Output  : true if synchronised
+Comments: WiFi has to be connected. Failures back off over ticks
+====================================================================== */
+bool timeSync(void)
+{
+  _timestate & t = state.time;
+
+  if (sysinfo.extWake || !config.time.drift || !*config.time.ntp || timeError() < config.time.drift)
+    return false;
+  if (t.fails && (t.ticks & ((1UL << min(t.fails, (uint8_t) TIME_NTP_BACKOFF_MAX)) - 1)))
+    return false;
+
+  bool ret = timeSntp();
+  if (ret)
+    t.fails = 0;
+  else
+  {
+    if (t.fails < 255)
+      t.fails++;
+    logW("SNTP sync failed" EOL);
+  }
+  return ret;
+}
+
+/* ======================================================================
+Function: timeJSON
+Purpose : append the time stamp to a JSON report
+Input   : report being built, without its closing brace
+Output  : -
+Comments: ,"time":unix,"time_err":s start of this wake, nothing if the
+          time was never set
+====================================================================== */
+void timeJSON(String & r)
+{
+  if (!state.time.epoch)
+    return;
+
+  r += F(",\"time\":");
+  r += timeNow() - millis() / 1000;
+  r += F(",\"time_err\":");
+  r += timeError();
+}
@@ -0,0 +1,79 @@
+#include "app.h"
+#include "state.h"
+#include "frame.h"
+#include "dnscache.h"
+#include "udpclient.h"
+
+//#define DEBUG_UDP_REPORT
+
+/* ======================================================================
+Function: udpWaitAck
+Purpose : wait for the collector acknowledge
+Input   : UDP socket, sequence number, timeout (ms)
+Output  : true if acknowledged
+Comments: -
+====================================================================== */
+static bool udpWaitAck(WiFiUDP & udp, uint32_t seq, uint16_t timeout)
+{
+  uint8_t ack[FRAME_ACK_SIZE];
+  uint32_t start = millis();
+
+  while (millis() - start < timeout)
+  {
+    int len = udp.parsePacket();
+    if (len)
+    {
+      if (len == FRAME_ACK_SIZE && udp.read(ack, sizeof(ack)) == len &&
+          frameCheckAck(ack, len, seq))
+        return true;
+      continue;
+    }
+    delay(1);
+  }
+  return false;
+}
+
+/* ======================================================================
+Function: udpReport
+Purpose : send sysinfo as a single binary datagram to the collector
+Input   : -
+Output  : true if sent (and acknowledged when enabled)
+Comments: report host and port are the collector ones
+====================================================================== */
+bool udpReport(void)
+{
+  uint8_t frame[FRAME_SIZE];
+  uint8_t len;
+  bool ack = config.report_ack != 0;
+  bool ret = false;
+  IPAddress ip;
+  WiFiUDP udp;
+
+  if (!dnsResolve(config.report.host, ip))
+    return false;
+
+  // Same sequence on retry, collector can drop the duplicate
+  len = frameEncode(frame, ++state.seq, ack ? FRAME_FLAG_ACK : 0);
+
+  // Local port only needed to get the acknowledge back
+  if (ack && !udp.begin(1024 + (RANDOM_REG32 & 0x7FFF)))
+    return false;
+
+  for (uint8_t i = 0; i < (ack ? UDP_REPORT_TRIES : 1) && !ret; i++)
+  {
+    udp.beginPacket(ip, config.report.port);
+    udp.write(frame, len);
+    ret = udp.endPacket();
+    #ifdef DEBUG_UDP_REPORT
+    dbg_s("UDP frame #%u sent to %s:%u" EOL, state.seq, ip.toString().c_str(), config.report.port);
+    #endif
+    if (ret && ack)
+      ret = udpWaitAck(udp, state.seq, config.report_ack);
+  }
+  udp.stop();
+
+  // Maybe the collector moved
+  if (!ret && ack)
+    dnsInvalidate();
+  return ret;
+}
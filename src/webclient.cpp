@@ -1,73 +1,452 @@
 #include "app.h"
 #include "config.h"
 #include "webclient.h"
+#include "fwupdate.h"
+#include "state.h"
+#include "auth.h"
+#include "udpclient.h"
+#include "mqtt.h"
+#include "sampler.h"
+#include "stats.h"
+#include "timemodel.h"
+#include "batch.h"
+#include "sensor.h"
+#include "battery.h"
+#include "events.h"
+#include "reporttpl.h"
+#include "dnscache.h"
 
-#include <ESP8266HTTPClient.h>
+#include <WiFiClientSecure.h>
 
 //#define DEBUG_HTTP_POST
 
-bool httpPost(const char* host, const uint16_t port, char * url, uint8_t* payload, const size_t size)
+// Cipher suites offered over HTTPS, AES-128 only. Forward secret ECDHE
+// first, ECDSA being the cheapest for the ESP; RSA key exchange is left
+// for servers without ECDHE. Resumed sessions skip the key exchange anyway
+static const uint16_t tlsCiphers[] = {
+  BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_RSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_RSA_WITH_AES_128_CBC_SHA256
+};
+
+// Session of the last handshake, kept in state for resumption
+static BearSSL::Session tlsSession;
+
+// TLS client connected to an address, still giving the server name for
+// SNI: connecting by name would resolve it again, bypassing the DNS cache
+class tlsClient : public BearSSL::WiFiClientSecureCtx
+{
+public:
+  bool connect(IPAddress ip, uint16_t port, const char * name)
+  {
+    return WiFiClient::connect(ip, port) && _connectSSL(name);
+  }
+};
+
+/* ======================================================================
+Function: tlsSetup
+Purpose : prepare the TLS client for the report server
+Input   : TLS client, server address and port
+Output  : false if no certificate fingerprint is configured
+Comments: the session saved by the previous wake is handed over so the
+          server can resume it with an abbreviated handshake
+====================================================================== */
+static bool tlsSetup(tlsClient & client, IPAddress ip, const uint16_t port)
+{
+  uint8_t i;
+
+  // Never talk to an unauthenticated server
+  for (i = 0; i < CFG_REPORT_FP_SIZE && !config.report_fp[i]; i++)
+    ;
+  if (i == CFG_REPORT_FP_SIZE)
+  {
+    dbgF("No TLS fingerprint configured" EOL);
+    return false;
+  }
+  client.setFingerprint(config.report_fp);
+  client.setCiphers(tlsCiphers, sizeof(tlsCiphers)/sizeof(tlsCiphers[0]));
+
+  // Probed once, costs a connection
+  if (state.tls.mfln == TLS_MFLN_UNKNOWN)
+    state.tls.mfln = BearSSL::WiFiClientSecure::probeMaxFragmentLength(ip, port, TLS_MFLN_SIZE)
+                     ? TLS_MFLN_OK : TLS_MFLN_NONE;
+  if (state.tls.mfln == TLS_MFLN_OK)
+    client.setBufferSizes(TLS_MFLN_SIZE, TLS_MFLN_SIZE);
+
+  memcpy((void *) &tlsSession, state.tls.session, sizeof(BearSSL::Session));
+  client.setSession(&tlsSession);
+  return true;
+}
+
+/* ======================================================================
+Function: tlsSaveSession
+Purpose : keep the TLS session for the next wake
+Input   : -
+Output  : -
+Comments: a resumed session is unchanged and does not wear the flash
+====================================================================== */
+static void tlsSaveSession(void)
+{
+  memcpy(state.tls.session, (void *) &tlsSession, sizeof(BearSSL::Session));
+}
+
+/* ======================================================================
+Function: httpHeader
+Purpose : value of a reply header line
+Input   : line, header name with its colon (PROGMEM), value
+Output  : true if the line is that header
+Comments: names are case insensitive
+====================================================================== */
+static bool httpHeader(const String & line, PGM_P name, String & value)
 {
+  uint8_t len = strlen_P(name);
+
+  if (strncasecmp_P(line.c_str(), name, len))
+    return false;
+  value = line.substring(len);
+  value.trim();
+  return true;
+}
+
+/* ======================================================================
+Function: httpPost
+Purpose : send a request to the report server
+Input   : server name and port, URL, body (GET if NULL) and its size,
+          reply body if wanted
+Output  : true if the server answered 200
+Comments: connects to the cached server address (dnscache.h), the name
+          is only sent, in the Host header and for SNI. It is looked up
+          again when that connection fails. HTTP/1.0, so the server
+          closes the connection after a reply that is never chunked
+====================================================================== */
+bool httpPost(const char* host, const uint16_t port, char * url, uint8_t* payload, const size_t size, String* reply)
+{
+  static_assert(sizeof(BearSSL::Session) <= TLS_SESSION_SIZE, "TLS session does not fit in state");
+  bool tls = config.report.proto == CFG_REPORT_PROTO_HTTPS;
+  WiFiClient plain;
+  tlsClient secure;
+  WiFiClient * client = &plain;
+  IPAddress ip;
+  String line, date, value;
+  int httpCode = 0;
+  int len = -1;
+  uint8_t buf[128];
+  uint32_t start;
+
+  auto connect = [&]() {
+    return tls ? secure.connect(ip, port, host) : plain.connect(ip, port) > 0;
+  };
+
+  if (!dnsResolve(host, ip))
+    return false;
+
+  if (tls)
+  {
+    if (!tlsSetup(secure, ip, port))
+      return false;
+    client = &secure;
+  }
+
+  // Server may have moved, try a fresh address
+  if (!connect())
+  {
+    client->stop();
+    dnsInvalidate();
+    if (!dnsResolve(host, ip) || !connect())
+      return false;
+  }
+  client->setNoDelay(true);
+  client->setTimeout(HTTP_TIMEOUT);
+
+  line = payload ? F("POST ") : F("GET ");
+  line += url;
+  line += F(" HTTP/1.0\r\nHost: ");
+  line += host;
+  if (port != (tls ? 443 : 80))
+  {
+    line += ':';
+    line += port;
+  }
+  line += F("\r\nUser-Agent: " __appName "\r\n");
+  if (payload)
+  {
+    line += F("Content-Length: ");
+    line += (unsigned) size;
+    line += F("\r\n");
+  }
+  line += F("\r\n");
+
   #ifdef DEBUG_HTTP_POST
-  dbgF("Starting lookup" EOL);
-  long startTime = millis();
+  dbg_s(EOL "%s http%s://%s:%d%s" EOL, payload ? "POST" : "GET", tls?"s":"", host, port, url);
+  if (payload)
+    dbg_s("Payload: %s" EOL,(char*)payload);
   #endif
-  IPAddress serverIP;
-  WiFi.hostByName(host, serverIP);
+
+  if (client->write((const uint8_t *) line.c_str(), line.length()) != line.length() ||
+      (payload && client->write(payload, size) != size))
+  {
+    client->stop();
+    return false;
+  }
+
+  // Status line, then the headers up to an empty line
+  line = client->readStringUntil('\n');
+  if (line.startsWith(F("HTTP/1.")) && line.length() >= 12)
+    httpCode = line.substring(9, 12).toInt();
+  while (httpCode && (line = client->readStringUntil('\n')).length() > 1)
+  {
+    if (httpHeader(line, PSTR("Content-Length:"), value))
+      len = value.toInt();
+    else
+      httpHeader(line, PSTR("Date:"), date);
+  }
+
   #ifdef DEBUG_HTTP_POST
-  dbg_s("[DNS] [%dms] Finished lookup", millis() - startTime);
+  dbg_s("Reply code: %d" EOL,httpCode);
   #endif
-  HTTPClient http;
-  bool ret = false;
-  // configure traged server and url
-  http.begin(host, port, url);
-
-  // start connection and send HTTP header
 
-  int httpCode=0;
-  if(payload != NULL)
+  if (httpCode == 200 && reply)
   {
-    #ifdef DEBUG_HTTP_POST
-    dbg_s(EOL "POST http%s://%s:%d%s" EOL, port==443?"s":"", host, port, url);
-    dbg_s("Payload: %s" EOL,(char*)payload);
-    #endif
-    httpCode = http.POST(payload,size);
-  }
-  else
-    httpCode = http.GET();
-  if(httpCode) {
-      #ifdef DEBUG_HTTP_POST
-      dbg_s("Reply code: %d" EOL,httpCode);
-      #endif
-      // HTTP header has been send and Server response header has been handled
-      // file found at server
-      if(httpCode == 200) 
+    *reply = "";
+    start = millis();
+    while ((len < 0 || (int) reply->length() < len) && millis() - start < HTTP_TIMEOUT &&
+           (client->connected() || client->available()))
+    {
+      int n = client->read(buf, sizeof(buf) - 1);
+      if (n <= 0)
       {
-        String payload = http.getString();
-        #ifdef DEBUG_HTTP_POST
-        dbg_s("Reply data: %s" EOL,payload.c_str());
-        #endif
-        ret = true;
+        delay(1);
+        continue;
       }
+      buf[n] = '\0';
+      *reply += (char *) buf;
+    }
+    #ifdef DEBUG_HTTP_POST
+    dbg_s("Reply data: %s" EOL,reply->c_str());
+    #endif
   }
-  #ifdef DEBUG_HTTP_POST 
-  else
-      dbgF("failed!");
-  #endif
-  return ret;
+  client->stop();
+
+  if (httpCode != 200)
+    return false;
+  if (tls)
+    tlsSaveSession();
+  // Free time reference, refines the time model
+  if (date.length())
+    timeHttpDate(date.c_str());
+  return true;
+}
+
+/* ======================================================================
+Function: replyNextLine
+Purpose : split the next "key=value" directive out of a reply body
+Input   : reply body, current position (updated), key and value
+Output  : false when the end of the body is reached
+Comments: lines without '=' come back with an empty key
+====================================================================== */
+static bool replyNextLine(String & reply, int & pos, String & key, String & value)
+{
+  if (pos >= (int) reply.length())
+    return false;
+
+  int end = reply.indexOf('\n', pos);
+  if (end < 0)
+    end = reply.length();
+
+  String line = reply.substring(pos, end);
+  pos = end + 1;
+  line.trim();
+
+  int eq = line.indexOf('=');
+  key = eq > 0 ? line.substring(0, eq) : String();
+  value = eq > 0 ? line.substring(eq + 1) : String();
+  return true;
+}
+
+/* ======================================================================
+Function: reportApplyConfig
+Purpose : apply a configuration delta sent back by the report server
+Input   : reply body
+Output  : -
+Comments: the delta is the set of "cfg_<form field>=value" lines, signed
+          by cfg_sig (hex HMAC-SHA256 of every other cfg_ line, in order,
+          each one terminated by '\n') and numbered by cfg_seq which must
+          grow to prevent replays. Nothing is applied if any field is
+          rejected, config is only written if some value changed.
+====================================================================== */
+static void reportApplyConfig(String & reply)
+{
+  String key, value, sig, sigData;
+  uint32_t seq = 0;
+  int pos = 0;
+
+  while (replyNextLine(reply, pos, key, value))
+  {
+    if (!key.startsWith(F("cfg_")))
+      continue;
+    if (key == F("cfg_sig")) {
+      sig = value;
+      continue;
+    }
+    if (key == F("cfg_seq"))
+      seq = strtoul(value.c_str(), NULL, 10);
+    sigData += key + '=' + value + '\n';
+  }
+
+  if (!sigData.length())
+    return;
+
+  if (seq <= state.cfg_seq ||
+      !authCheckHex((const uint8_t *) sigData.c_str(), sigData.length(), sig.c_str()))
+  {
+    dbgF("Remote config rejected" EOL);
+    return;
+  }
+
+  _Config old;
+  memcpy(&old, &config, sizeof(_Config));
+
+  pos = 0;
+  while (replyNextLine(reply, pos, key, value))
+  {
+    if (!key.startsWith(F("cfg_")) || key == F("cfg_sig") || key == F("cfg_seq"))
+      continue;
+    if (!cfgSetField(key.c_str() + 4, value.c_str()))
+    {
+      dbg_s("Remote config field %s rejected" EOL, key.c_str());
+      memcpy(&config, &old, sizeof(_Config));
+      return;
+    }
+  }
+
+  state.cfg_seq = seq;
+  if (memcmp(&old, &config, sizeof(_Config)))
+  {
+    dbgF("Remote config applied" EOL);
+    cfgSave();
+  }
+}
+
+/* ======================================================================
+Function: reportHandleReply
+Purpose : process the directives sent back by the report server
+Input   : reply body
+Output  : -
+Comments: one "key=value" directive per line, unknown keys are ignored
+          fw_seq, fw_ver, fw_url, fw_size, fw_md5 : firmware update offer
+          fw_sig                          : offer signature, see below
+          cfg_*                           : configuration delta
+          The firmware offer must be signed like config deltas, over
+          its other fw_ lines: without a shared key configured it is
+          always rejected. Its fw_seq must be above the last one
+          accepted, so a captured offer cannot be replayed to install
+          an older image; the one accepted repeated is ignored.
+====================================================================== */
+void reportHandleReply(String & reply)
+{
+  String key, value, sigData;
+  String fw_ver, fw_url, fw_md5, fw_sig;
+  uint32_t fw_size = 0;
+  uint32_t fw_seq = 0;
+  int pos = 0;
+
+  while (replyNextLine(reply, pos, key, value))
+  {
+    if (!key.startsWith(F("fw_")))
+      continue;
+    if      (key == F("fw_ver"))  fw_ver = value;
+    else if (key == F("fw_url"))  fw_url = value;
+    else if (key == F("fw_size")) fw_size = value.toInt();
+    else if (key == F("fw_md5"))  fw_md5 = value;
+    else if (key == F("fw_seq"))  fw_seq = strtoul(value.c_str(), NULL, 10);
+    else if (key == F("fw_sig"))  { fw_sig = value; continue; }
+    sigData += key + '=' + value + '\n';
+  }
+
+  if (fw_ver.length() && fw_url.length())
+  {
+    // authCheckHex() fails without a key, an unsigned image is never run
+    if (!authCheckHex((const uint8_t *) sigData.c_str(), sigData.length(), fw_sig.c_str()) ||
+        fw_seq < state.fw_seq)
+      dbgF("Firmware offer rejected" EOL);
+    else if (fw_seq > state.fw_seq)
+    {
+      state.fw_seq = fw_seq;
+      fwUpdateOffer(fw_ver.c_str(), fw_url.c_str(), fw_size, fw_md5.c_str());
+    }
+  }
+
+  reportApplyConfig(reply);
 }
 
 /* ======================================================================
 Function: reportPost
-Purpose : Do a http post to custom server
+Purpose : Do a http post to custom server, or use the configured transport
 Input   :
-Output  : true if post returned 200 OK
-Comments: -
+Output  : true if post returned 200 OK (or datagram sent)
+Comments: events, statistics and deep sleep samples are only marked
+          reported by the reports carrying them
 ====================================================================== */
 boolean reportPost(void)
 {
+  bool ret;
+
   if (!(*config.report.host))
     return false;
+
+  if (config.report.proto == CFG_REPORT_PROTO_UDP || config.report.proto == CFG_REPORT_PROTO_MQTT)
+  {
+    ret = config.report.proto == CFG_REPORT_PROTO_UDP ? udpReport() : mqttReport();
+    if (ret)
+      eventReported();
+    return ret;
+  }
+
+  String reply;
+
+  // Deep sleep mode samples as a binary batch, see batch.h. It has no room
+  // for events and statistics: events wait for a JSON report
+  if (config.report_batch && samplerCount() && !eventCount())
+  {
+    uint8_t batch[BATCH_SIZE];
+    uint16_t len = batchEncode(batch, config.report_batch == BATCH_HEATSHRINK);
+    if (len)
+    {
+      if (!httpPost(config.report.host, config.report.port, config.report.url,
+                    batch, len, &reply))
+        return false;
+      reportHandleReply(reply);
+      samplerReported();
+      return true;
+    }
+    // Does not fit, JSON then
+  }
+
+  uint32_t us = micros();
+
+  // Backend specific layout, events, statistics and samples go through
+  // their placeholders or not at all
+  if (*config.report_tpl)
+  {
+    char out[TPL_OUT_SIZE];
+    uint16_t len = tplRender(config.report_tpl, sizeof(config.report_tpl), out, sizeof(out));
+    logD("Template: %u bytes, %luus" EOL, len, (unsigned long) (micros() - us));
+    if (len)
+    {
+      if (!httpPost(config.report.host, config.report.port, config.report.url,
+                    (uint8_t *) out, len, &reply))
+        return false;
+      reportHandleReply(reply);
+      statsReported();
+      eventReported();
+      if (tplSamples(config.report_tpl, sizeof(config.report_tpl)))
+        samplerReported();
+      return true;
+    }
+    logW("Template output over %u bytes, default report" EOL, TPL_OUT_SIZE);
+  }
+
   String p = "{";
   // Message
   p += "\"message\":\"";
@@ -84,28 +463,36 @@ boolean reportPost(void)
   p += sysinfo.extWake ? "External" : "Timer";
   p += "\"";
 
-#ifdef HAS_BME280
-  p += ",";
+  // Sensor channels, the statistics may stand for the known quantities
+  sensorJSON(p, statsReplace() ? SENSOR_HAS_WEATHER : 0);
 
-  // Temperature
-  p += "\"temperature\":";
-  p += sysinfo.temperature;
-  p += ",";
+  // Coalesced external wakes
+  eventJSON(p);
 
-  // Pressure
-  p += "\"pressure\":";
-  p += sysinfo.pressure;
-  p += ",";
+  // Battery charge estimates
+  batteryJSON(p);
+
+  // Deep sleep mode accumulated samples
+  samplerJSON(p);
+
+  // Sensor statistics windows
+  statsJSON(p);
 
-  // Humidity
-  p += "\"humidity\":";
-  p += sysinfo.humidity;
-  p += "";
-#endif
+  // Estimated time of this wake
+  timeJSON(p);
 
   p += "}";
-  return httpPost(config.report.host, config.report.port,
-                  config.report.url,
-                  (uint8_t*)p.c_str(), p.length()
-                 );
+  logD("JSON: %u bytes, %luus" EOL, p.length(), (unsigned long) (micros() - us));
+
+  if (!httpPost(config.report.host, config.report.port,
+                config.report.url,
+                (uint8_t*)p.c_str(), p.length(), &reply
+               ))
+    return false;
+
+  reportHandleReply(reply);
+  statsReported();
+  eventReported();
+  samplerReported();
+  return true;
 }
@@ -1,6 +1,11 @@
 #include "app.h"
 #include "config.h"
 #include "webserver.h"
+#include "power.h"
+#include "sensor.h"
+#include "battery.h"
+#include "scheduler.h"
+#include "history.h"
 
 // Optimize string space in flash, avoid duplication
 const char FP_JSON_START[] PROGMEM = "{\r\n";
@@ -12,7 +17,44 @@ const char FP_NL[] PROGMEM = "\r\n";
 
 ESP8266WebServer server(80);
 
+static uint32_t wifiScanAsked;      // Last /wifiscan.json (ms), 0 never
+static String   wifiScanList;       // Networks of the last completed scan, JSON
+
 void spiffsJSONTable();
+static void wifiScanKeep(int n);
+
+/* ======================================================================
+Function: httpTask
+Purpose : serve the web clients, see scheduler.h
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+static void httpTask(void)
+{
+  server.handleClient();
+}
+
+/* ======================================================================
+Function: wifiScanTask
+Purpose : refresh the networks of /wifiscan.json in the background
+Input   : -
+Output  : -
+Comments: only while the page asks for them, scanning makes the soft AP
+          leave its channel for a while
+====================================================================== */
+static void wifiScanTask(void)
+{
+  if (!wifiScanAsked || millis() - wifiScanAsked > 2UL * WIFI_SCAN_PERIOD)
+    return;
+  int n = WiFi.scanComplete();
+  if (n != WIFI_SCAN_RUNNING)
+  {
+    // Served while the next one runs
+    wifiScanKeep(n);
+    WiFi.scanNetworks(true);
+  }
+}
 
 
 void webserverInit(void)
@@ -23,7 +65,10 @@ void webserverInit(void)
   server.on("/system.json", sysJSONTable);
   server.on("/config.json", confJSONTable);
   server.on("/spiffs.json", spiffsJSONTable);
+  server.on("/log.json", logJSONTable);
   server.on("/wifiscan.json", wifiScanJSON);
+  server.on("/sched.json", schedJSONTable);
+  server.on("/history.json", historyJSONTable);
   server.on("/factory_reset", handleFactoryReset);
   server.on("/reset", handleReset);
 
@@ -85,6 +130,9 @@ void webserverInit(void)
   server.serveStatic("/js",   SPIFFS, "/js"  ,"max-age=86400");
   server.serveStatic("/css",  SPIFFS, "/css" ,"max-age=86400");
   server.begin();
+
+  schedAdd(PSTR("http"), httpTask, SCHED_PRIO_IO, 0, 50);
+  schedAdd(PSTR("wifiscan"), wifiScanTask, SCHED_PRIO_BACKGROUND, WIFI_SCAN_PERIOD, 1000);
 }
 
 /* ======================================================================
@@ -189,29 +237,20 @@ void handleFormConfig(void)
   // We validated config ?
   if (server.hasArg("save"))
   {
-    int itemp;
+    _cfgfield field;
     dbgF("===== Posted configuration" EOL);
 
-    // WifInfo
-    strncpy(config.ssid ,   server.arg("ssid").c_str(),     CFG_SSID_SIZE );
-    strncpy(config.psk ,    server.arg("psk").c_str(),      CFG_PSK_SIZE );
-    strncpy(config.host ,   server.arg("host").c_str(),     CFG_HOSTNAME_SIZE );
-    strncpy(config.ap_psk , server.arg("ap_psk").c_str(),   CFG_PSK_SIZE );
-    strncpy(config.ota_auth,server.arg("ota_auth").c_str(), CFG_PSK_SIZE );
-    itemp = server.arg("ota_port").toInt();
-    config.ota_port = (itemp>=0 && itemp<=65535) ? itemp : DEFAULT_OTA_PORT ;
-
-    strncpy(config.netcfg.ip,   server.arg(CFG_FORM_NET_IP).c_str(),  CFG_IP_ADDRESS_MAX_SIZE );
-    strncpy(config.netcfg.gw,   server.arg(CFG_FORM_NET_GW).c_str(),  CFG_IP_ADDRESS_MAX_SIZE );
-    strncpy(config.netcfg.msk,   server.arg(CFG_FORM_NET_MSK).c_str(),  CFG_IP_ADDRESS_MAX_SIZE );
-    strncpy(config.netcfg.dns,   server.arg(CFG_FORM_NET_DNS).c_str(),  CFG_IP_ADDRESS_MAX_SIZE );
-
-    // Report
-    strncpy(config.report.host,   server.arg("report_host").c_str(),  CFG_REPORT_HOST_SIZE );
-    strncpy(config.report.url,    server.arg("report_url").c_str(),   CFG_REPORT_URL_SIZE );
-    strncpy(config.report.msg,    server.arg("report_msg").c_str(),   CFG_REPORT_MSG_SIZE );
-    itemp = server.arg("report_port").toInt();
-    config.report.port = (itemp>=0 && itemp<=65535) ? itemp : CFG_REPORT_DEFAULT_PORT ;
+    // Single pass over the posted fields, those not in the form are
+    // left untouched, as well as invalid ones
+    for (int i = 0; i < server.args(); i++)
+    {
+      String name = server.argName(i);
+      if (cfgFieldFind(name.c_str(), &field) &&
+          !cfgFieldSet(&field, server.arg(i).c_str()))
+      {
+        dbgF("Invalid "); dbg(name); dbgF(EOL);
+      }
+    }
 
     if ( cfgSave() ) {
       ret = 200;
@@ -315,21 +354,34 @@ void getSysJSONData(String & response)
   response += millis()/1000;
   response += "\"},\r\n";
 
+  response += "{\"na\":\"Boot to setup (µs)\",\"va\":\"";
+  response += sysinfo.bootUs;
+  response += "\"},\r\n";
+
   response += "{\"na\":\"Battery (V)\",\"va\":\"";
   response += sysinfo.vBatt;
   response += "\"},\r\n";
 
-  response += "{\"na\":\"Temperature (°C)\",\"va\":\"";
-  response += sysinfo.temperature;
+  response += "{\"na\":\"Battery charge (%)\",\"va\":\"";
+  response += String(batterySoc() / 100.0, 1);
   response += "\"},\r\n";
 
-  response += "{\"na\":\"Pressure (hPa)\",\"va\":\"";
-  response += sysinfo.pressure;
+  response += "{\"na\":\"Battery ADC\",\"va\":\"";
+  response += String(batteryAdc(), 2);
   response += "\"},\r\n";
 
-  response += "{\"na\":\"Humidity (%)\",\"va\":\"";
-  response += sysinfo.humidity;
-  response += "\"},\r\n";
+  for (uint8_t i = 0; i < sensorChannels(); i++)
+  {
+    _sensorchannel desc;
+    float value;
+    bool valid = sensorGet(i, desc, value);
+
+    response += "{\"na\":\"";
+    response += FPSTR(desc.label);
+    response += "\",\"va\":\"";
+    response += valid ? String(value, desc.decimals) : String("-");
+    response += "\"},\r\n";
+  }
 
   response += "{\"na\":\"Version\",\"va\":\"" __version "\"},\r\n";
 
@@ -425,6 +477,23 @@ void spiffsJSONTable()
   server.send ( 200, "text/json", response );
 }
 
+/* ======================================================================
+Function: jsonString
+Purpose : append a value to a JSON string
+Input   : JSON being built, value
+Output  : -
+Comments: quotes and backslashes escaped, a report template is JSON
+====================================================================== */
+static void jsonString(String & r, const char * s)
+{
+  for (; *s; s++)
+  {
+    if (*s == '"' || *s == '\\')
+      r += '\\';
+    r += *s;
+  }
+}
+
 /* ======================================================================
 Function: getConfigJSONData
 Purpose : Return JSON string containing configuration data
@@ -434,27 +503,19 @@ Comments: -
 ====================================================================== */
 void getConfJSONData(String & r)
 {
+  _cfgfield field;
+  char buf[CFG_FIELD_VALUE_SIZE];
+
   // Json start
   r = FPSTR(FP_JSON_START);
 
   r+="\"";
-  r+=CFG_FORM_SSID;      r+=FPSTR(FP_QCQ); r+=config.ssid;           r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_PSK;       r+=FPSTR(FP_QCQ); r+=config.psk;            r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_HOST;      r+=FPSTR(FP_QCQ); r+=config.host;           r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_AP_PSK;    r+=FPSTR(FP_QCQ); r+=config.ap_psk;         r+= FPSTR(FP_QCNL);
-
-  r+=CFG_FORM_OTA_AUTH;  r+=FPSTR(FP_QCQ); r+=config.ota_auth;       r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_OTA_PORT;  r+=FPSTR(FP_QCQ); r+=config.ota_port;       r+= FPSTR(FP_QCNL);
-
-  r+=CFG_FORM_NET_IP;  r+=FPSTR(FP_QCQ); r+=config.netcfg.ip;        r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_NET_GW;  r+=FPSTR(FP_QCQ); r+=config.netcfg.gw;        r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_NET_MSK;  r+=FPSTR(FP_QCQ); r+=config.netcfg.msk;      r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_NET_DNS;  r+=FPSTR(FP_QCQ); r+=config.netcfg.dns;      r+= FPSTR(FP_QCNL);
-
-  r+=CFG_FORM_REPORT_HOST; r+=FPSTR(FP_QCQ); r+=config.report.host;  r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_REPORT_PORT; r+=FPSTR(FP_QCQ); r+=config.report.port;  r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_REPORT_URL;  r+=FPSTR(FP_QCQ); r+=config.report.url;   r+= FPSTR(FP_QCNL);
-  r+=CFG_FORM_REPORT_MSG;  r+=FPSTR(FP_QCQ); r+=config.report.msg;   r+= F("\"");
+  for (uint8_t i = 0; cfgField(i, &field); i++)
+  {
+    if (i) r+= FPSTR(FP_QCNL);
+    r+=field.name; r+=FPSTR(FP_QCQ); jsonString(r, cfgFieldValue(&field, buf));
+  }
+  r+= F("\"");
   // Json end
   r += FPSTR(FP_JSON_END);
 
@@ -477,6 +538,78 @@ void confJSONTable()
   dbgF("Ok!" EOL);
 }
 
+/* ======================================================================
+Function: logJSONTable
+Purpose : dump the saved and current log records in JSON for browser
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+void logJSONTable()
+{
+  String response = "";
+  logJSON(response);
+  server.send ( 200, "text/json", response );
+}
+
+/* ======================================================================
+Function: schedJSONTable
+Purpose : dump the config mode scheduler statistics in JSON for browser
+Input   : -
+Output  : -
+Comments: -
+====================================================================== */
+void schedJSONTable()
+{
+  String response = "";
+  schedJSON(response);
+  server.send ( 200, "text/json", response );
+}
+
+/* ======================================================================
+Function: historyChunk
+Purpose : send a /history.json chunk
+Input   : part of the answer, emptied
+Output  : -
+Comments: an empty chunk would end the answer
+====================================================================== */
+static void historyChunk(String & r)
+{
+  if (r.length())
+    server.sendContent(r);
+  r = "";
+}
+
+/* ======================================================================
+Function: historyJSONTable
+Purpose : dump the sensor history in JSON for browser
+Input   : -
+Output  : -
+Comments: /history.json?from=&to=&res= with Unix times (or seconds since
+          first boot if the clock was never set), res raw, 10m or 1h.
+          Sent with chunked encoding as the records are read
+====================================================================== */
+void historyJSONTable()
+{
+  uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : 0;
+  uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : 0xFFFFFFFF;
+  int8_t tier = historyTier(server.arg("res").c_str(), from);
+  String response = "";
+
+  if (tier < 0)
+  {
+    server.send(400, "text/plain", "Bad res");
+    return;
+  }
+
+  response.reserve(HIST_CHUNK + 128);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/json", "");
+  historyJSON(tier, from, to, response, historyChunk);
+  historyChunk(response);
+  server.sendContent("");
+}
+
 /* ======================================================================
 Function: getSpiffsJSONData
 Purpose : Return JSON string containing list of SPIFFS files
@@ -533,26 +666,19 @@ void getSpiffsJSONData(String & response)
 }
 
 /* ======================================================================
-Function: wifiScanJSON
-Purpose : scan Wifi Access Point and return JSON code
-Input   : -
+Function: wifiScanKeep
+Purpose : keep the networks of a completed scan
+Input   : networks found, as WiFi.scanComplete()
 Output  : -
-Comments: -
+Comments: nothing changes while a scan runs or after a failed one
 ====================================================================== */
-void wifiScanJSON(void)
+static void wifiScanKeep(int n)
 {
-  String response = "";
-  bool first = true;
-
-  // Just to debug where we are
-  dbg(F("Serving /wifiscan page..."));
+  if (n < 0)
+    return;
 
-  int n = WiFi.scanNetworks();
-
-  // Json start
-  response += F("[\r\n");
-
-  for (uint8_t i = 0; i < n; ++i)
+  wifiScanList = "";
+  for (int i = 0; i < n; ++i)
   {
     int8_t rssi = WiFi.RSSI(i);
 
@@ -565,18 +691,42 @@ void wifiScanJSON(void)
     else                percent = 2 * (rssi + 100);
     */
 
-    if (first)
-      first = false;
-    else
-      response += F(",");
+    if (i)
+      wifiScanList += F(",");
 
-    response += F("{\"ssid\":\"");
-    response += WiFi.SSID(i);
-    response += F("\",\"rssi\":") ;
-    response += rssi;
-    response += FPSTR(FP_JSON_END);
+    wifiScanList += F("{\"ssid\":\"");
+    jsonString(wifiScanList, WiFi.SSID(i).c_str());
+    wifiScanList += F("\",\"rssi\":") ;
+    wifiScanList += rssi;
+    wifiScanList += FPSTR(FP_JSON_END);
   }
+}
+
+/* ======================================================================
+Function: wifiScanJSON
+Purpose : scan Wifi Access Point and return JSON code
+Input   : -
+Output  : -
+Comments: the networks of the last completed scan, even while the
+          background one runs
+====================================================================== */
+void wifiScanJSON(void)
+{
+  String response = "";
 
+  // Just to debug where we are
+  dbg(F("Serving /wifiscan page..."));
+
+  // Networks found in the background, the first time scan now
+  int n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_FAILED && !wifiScanList.length())
+    n = WiFi.scanNetworks();
+  wifiScanKeep(n);
+  wifiScanAsked = millis() | 1;
+
+  // Json start
+  response += F("[\r\n");
+  response += wifiScanList;
   // Json end
   response += FPSTR("]\r\n");
 
@@ -0,0 +1,328 @@
+#include "app.h"
+#include "state.h"
+#include "wificonn.h"
+
+#include <coredecls.h>
+
+#define DEBUG_APP_WIFI
+
+// Upper bound of each connection duration bucket (ms)
+static const uint16_t wifiHistEdge[WIFI_HIST_BUCKETS] PROGMEM =
+  { 300, 500, 750, 1000, 1500, 2500, 4000, WIFI_CONNECT_TIMEOUT };
+
+/* ======================================================================
+Function: wifiHistAdd
+Purpose : account for a successful connection duration
+Input   : network index, duration (ms)
+Output  : -
+Comments: -
+====================================================================== */
+static void wifiHistAdd(uint8_t net, uint32_t ms)
+{
+  uint8_t * h = state.wifi.hist[net];
+  uint16_t total = 0;
+  uint8_t i;
+
+  for (i=0; i<WIFI_HIST_BUCKETS; i++)
+    total += h[i];
+  if (total >= WIFI_HIST_MAX)
+    for (i=0; i<WIFI_HIST_BUCKETS; i++)
+      h[i] >>= 1;
+
+  for (i=0; i<WIFI_HIST_BUCKETS-1 && ms > pgm_read_word(&wifiHistEdge[i]); i++)
+    ;
+  h[i]++;
+}
+
+/* ======================================================================
+Function: wifiTimeout
+Purpose : time out to use for a network
+Input   : network index, default time out (ms)
+Output  : time out (ms)
+Comments: high percentile of past connection durations plus margin, the
+          default one until we know enough or when it keeps failing
+====================================================================== */
+static uint16_t wifiTimeout(uint8_t net, uint16_t timeout)
+{
+  uint8_t * h = state.wifi.hist[net];
+  uint16_t total = 0, count = 0;
+  uint8_t i;
+
+  if (state.wifi.net[net].fails >= WIFI_HIST_DISTRUST)
+    return timeout;
+
+  for (i=0; i<WIFI_HIST_BUCKETS; i++)
+    total += h[i];
+  if (total < WIFI_HIST_MIN)
+    return timeout;
+
+  for (i=0; i<WIFI_HIST_BUCKETS-1; i++)
+  {
+    count += h[i];
+    if (count * 100 >= total * WIFI_HIST_PERCENTILE)
+      break;
+  }
+
+  timeout = pgm_read_word(&wifiHistEdge[i]) + WIFI_TIMEOUT_MARGIN;
+  if (!state.wifi.net[net].channel)
+    timeout += WIFI_TIMEOUT_SCAN;
+  if (timeout < WIFI_TIMEOUT_MIN)
+    timeout = WIFI_TIMEOUT_MIN;
+  if (timeout > WIFI_CONNECT_TIMEOUT)
+    timeout = WIFI_CONNECT_TIMEOUT;
+  return timeout;
+}
+
+/* ======================================================================
+Function: wifiWake
+Purpose : WiFi event handler, ends the connection wait
+Input   : -
+Output  : -
+Comments: got an address or got disconnected, status will tell
+====================================================================== */
+static void wifiWake(void)
+{
+  esp_schedule();
+}
+
+/* ======================================================================
+Function: wifiSsid
+Purpose : get a known network SSID
+Input   : network index, 0 main network, then fallbacks
+Output  : SSID, empty if the slot is unused
+Comments: -
+====================================================================== */
+static const char * wifiSsid(uint8_t net)
+{
+  return net ? config.networks[net-1].ssid : config.ssid;
+}
+
+/* ======================================================================
+Function: wifiScore
+Purpose : rank a known network
+Input   : network index
+Output  : score, the higher the better
+Comments: RSSI seen on the last successful connection, minus a penalty
+          for each failure since
+====================================================================== */
+static int16_t wifiScore(uint8_t net)
+{
+  _netrank * r = &state.wifi.net[net];
+  int16_t score = r->rssi ? r->rssi : WIFI_RSSI_UNKNOWN;
+
+  return score - WIFI_FAIL_PENALTY * r->fails;
+}
+
+/* ======================================================================
+Function: wifiCandidates
+Purpose : build the ordered list of networks to try
+Input   : list to fill
+Output  : number of candidates
+Comments: last network connected first, then the others by score
+====================================================================== */
+static uint8_t wifiCandidates(uint8_t * list)
+{
+  uint8_t n = 0;
+  uint8_t first;
+  uint8_t last = state.wifi.last;
+
+  if (last && last <= WIFI_NETWORKS && *wifiSsid(last-1))
+    list[n++] = last-1;
+  first = n;
+
+  for (uint8_t net=0; net<WIFI_NETWORKS; net++)
+  {
+    if (!*wifiSsid(net) || net+1 == last)
+      continue;
+    // Insertion sort, there are only a few of them
+    uint8_t i = n;
+    while (i > first && wifiScore(list[i-1]) < wifiScore(net))
+    {
+      list[i] = list[i-1];
+      --i;
+    }
+    list[i] = net;
+    n++;
+  }
+  return n;
+}
+
+/* ======================================================================
+Function: wifiSetIP
+Purpose : set network addresses for a known network
+Input   : network index
+Output  : true if a static configuration is used
+Comments: -
+====================================================================== */
+static bool wifiSetIP(uint8_t net)
+{
+  IPAddress ip,gw,msk,dns;
+
+  if (net)
+  {
+    _network * n = &config.networks[net-1];
+    ip  = n->ip;
+    gw  = n->gw;
+    msk = n->msk;
+    dns = n->dns;
+  }
+  else if (config.netcfg.ip[0] != 0)
+  {
+    ip.fromString(String(config.netcfg.ip));
+    gw.fromString(String(config.netcfg.gw));
+    msk.fromString(String(config.netcfg.msk));
+    dns.fromString(String(config.netcfg.dns));
+  }
+
+  if (!(uint32_t) ip)
+    return false;
+
+  #ifdef DEBUG_APP_WIFI
+  dbgF("Using static IP configuration" EOL);
+  dbg_s("  IP : %s" EOL,ip.toString().c_str());
+  dbg_s("  MSK: %s" EOL,msk.toString().c_str());
+  dbg_s("  GW : %s" EOL,gw.toString().c_str());
+  dbg_s("  DNS: %s" EOL,dns.toString().c_str());
+  #endif
+  WiFi.config(ip, dns, gw, msk);
+  return true;
+}
+
+/* ======================================================================
+Function: wifiTry
+Purpose : try to connect to one known network
+Input   : network index, time out (ms)
+Output  : WiFi status
+Comments: when we know the access point from the last time, go straight
+          to its channel and BSSID instead of scanning.
+          Sleeps until a WiFi event rather than polling the status.
+====================================================================== */
+static int wifiTry(uint8_t net, uint16_t timeout)
+{
+  _netrank * r = &state.wifi.net[net];
+  const char * ssid = wifiSsid(net);
+  const char * psk  = net ? config.networks[net-1].psk : config.psk;
+  uint32_t start = millis();
+  unsigned long elapsed;
+  int ret;
+  WiFiEventHandler onGotIP = WiFi.onStationModeGotIP(
+                    [](const WiFiEventStationModeGotIP &) { wifiWake(); });
+  WiFiEventHandler onDisconnected = WiFi.onStationModeDisconnected(
+                    [](const WiFiEventStationModeDisconnected &) { wifiWake(); });
+
+  #ifdef DEBUG_APP_WIFI
+  dbgF("Connecting to: ");
+  dbg(ssid);
+  if (*psk) {
+    dbgF(" with key '");
+    dbg(psk);
+    dbgF("'");
+  } else {
+    dbgF(" unsecure AP");
+  }
+  if (r->channel) {
+    dbgF(" on channel ");
+    dbg(r->channel);
+  }
+  dbg_s("... %dms" , timeout);
+  dbgFlush();
+  #endif
+
+  if (r->channel)
+    WiFi.begin(ssid, *psk ? psk : NULL, r->channel, r->bssid);
+  else
+    WiFi.begin(ssid, *psk ? psk : NULL);
+
+  // No need to wait for the time out when the AP is not there or
+  // refuses us. A WiFi event resumes esp_delay(), delay() would not.
+  esp_delay(timeout, []() {
+      int s = WiFi.status();
+      return s != WL_CONNECTED && s != WL_NO_SSID_AVAIL && s != WL_CONNECT_FAILED;
+    });
+  ret = WiFi.status();
+  elapsed = millis() - start;
+
+  if (ret == WL_CONNECTED)
+  {
+    wifiHistAdd(net, elapsed);
+    memcpy(r->bssid, WiFi.BSSID(), sizeof(r->bssid));
+    r->channel = WiFi.channel();
+    r->rssi = WiFi.RSSI();
+    r->fails = 0;
+    state.wifi.last = net + 1;
+  }
+  else
+  {
+    // The AP may have moved, scan next time
+    r->channel = 0;
+    if (r->fails < 255)
+      r->fails++;
+    WiFi.disconnect();
+  }
+
+  #ifdef DEBUG_APP_WIFI
+  dbg_s(" status %d after %lums" EOL, ret, elapsed);
+  #endif
+  return ret;
+}
+
+/* ======================================================================
+Function: wifiConnect
+Purpose : connect to the best known network
+Input   : -
+Output  : true if connected
+Comments: each network gets its learnt time out, by default
+          WIFI_CANDIDATE_TIMEOUT but for the last one, all together never
+          take more than WIFI_CONNECT_TIMEOUT
+====================================================================== */
+bool wifiConnect(void)
+{
+  uint8_t  list[WIFI_NETWORKS];
+  uint8_t  n = wifiCandidates(list);
+  uint32_t start = millis();
+  bool     staticip = false;
+  int      ret = WiFi.status();
+
+  if (!n)
+    return false;
+
+  WiFi.mode(WIFI_STA);
+  // Credentials are in our config, switching networks must not rewrite
+  // the SDK ones in flash every time
+  WiFi.persistent(false);
+
+  for (uint8_t i=0; i<n; i++)
+  {
+    int32_t left = WIFI_CONNECT_TIMEOUT - (millis() - start);
+    int32_t timeout = wifiTimeout(list[i], i < n-1 ? WIFI_CANDIDATE_TIMEOUT
+                                                    : WIFI_CONNECT_TIMEOUT);
+    if (left <= 0)
+      break;
+    if (left > timeout)
+      left = timeout;
+
+    if (wifiSetIP(list[i]))
+      staticip = true;
+    else if (staticip) {
+      // Back to DHCP after a static network
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      staticip = false;
+    }
+
+    ret = wifiTry(list[i], left);
+    if (ret == WL_CONNECTED)
+      break;
+  }
+
+  // connected ? disable AP, client mode only
+  #ifdef DEBUG_APP_WIFI
+  if (ret == WL_CONNECTED)
+  {
+    dbgF("Connected!" EOL);
+    dbg_s("IP address   : %s" EOL, WiFi.localIP().toString().c_str());
+    dbg_s("MAC address  : %s" EOL, WiFi.macAddress().c_str());
+    dbg_s("RSSI         : %d" EOL, WiFi.RSSI());
+  }
+  #endif
+  return ret == WL_CONNECTED;
+}
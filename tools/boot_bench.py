@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Boot time benchmark, from the board serial output.
+
+Collects the "BOOT <us> us, WAKE <ms> ms" line printed on power off by
+builds with BOOT_BENCH (pio run -e field_bench), over several wakes, and
+prints statistics. Wake the board with its button or let the timer do it.
+
+    boot_bench.py --port /dev/ttyUSB0 --count 20
+    boot_bench.py < capture.log
+"""
+
+import argparse
+import re
+import statistics
+import sys
+
+LINE = re.compile(r"BOOT (\d+) us, WAKE (\d+) ms")
+
+
+def lines(args):
+    if not args.port:
+        yield from sys.stdin
+        return
+    import serial  # pyserial
+
+    with serial.Serial(args.port, args.baud) as link:
+        while True:
+            yield link.readline().decode(errors="replace")
+
+
+def stats(name, unit, values):
+    print("%-14s min %7d  median %7d  mean %9.1f  max %7d %s" % (
+        name, min(values), statistics.median(values), statistics.mean(values), max(values), unit))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", help="serial port, stdin if not given")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--count", type=int, default=10, help="wakes to measure")
+    args = parser.parse_args()
+
+    boot, wake = [], []
+    for line in lines(args):
+        m = LINE.search(line)
+        if not m:
+            continue
+        boot.append(int(m.group(1)))
+        wake.append(int(m.group(2)))
+        print("wake %d: boot to setup %sus, awake %sms" % (len(boot), m.group(1), m.group(2)),
+              file=sys.stderr)
+        if len(boot) >= args.count:
+            break
+
+    if not boot:
+        sys.exit("no BOOT line found, is it a BOOT_BENCH build ?")
+    stats("boot to setup", "us", boot)
+    stats("awake", "ms", wake)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Decoding of the esLPWeather multi sample batches (see include/batch.h).
+
+  eslpbatch.py decode FILE|-       decode a batch (binary, or hex text)
+  eslpbatch.py bench [--samples N] bytes and host encode time, batch vs JSON
+
+The device logs its own encode times at debug level ("Batch:" and "JSON:"
+lines of /log.json), the bench only runs the same algorithms on the host.
+"""
+
+import argparse
+import json
+import random
+import struct
+import sys
+import time
+
+BATCH_HEADER = struct.Struct("<2sBBIIHBB")
+BATCH_VERSION = 1
+FLAG_HEATSHRINK = 0x01
+
+# Channel bit, name and divider to report units, in encoding order
+CHANNELS = [
+    (0x01, "temperature", 100.0),
+    (0x02, "humidity", 100.0),
+    (0x04, "pressure", 100.0),
+    (0x08, "battery", 1000.0),
+]
+
+HS_WINDOW = 8
+HS_LOOKAHEAD = 4
+
+
+def heatshrink_decode(data, window=HS_WINDOW, lookahead=HS_LOOKAHEAD):
+    """Decompress a heatshrink stream, trailing padding bits are dropped."""
+    out = bytearray()
+    bits = "".join("{:08b}".format(b) for b in data)
+    pos = 0
+
+    def take(n):
+        nonlocal pos
+        if pos + n > len(bits):
+            raise EOFError
+        v = int(bits[pos:pos + n], 2)
+        pos += n
+        return v
+
+    try:
+        while True:
+            if take(1):
+                out.append(take(8))
+            else:
+                offset = take(window) + 1
+                count = take(lookahead) + 1
+                for _ in range(count):
+                    out.append(out[-offset] if offset <= len(out) else 0)
+    except EOFError:
+        pass
+    return bytes(out)
+
+
+def heatshrink_encode(data, window=HS_WINDOW, lookahead=HS_LOOKAHEAD):
+    """Same greedy whole buffer encoder as the device."""
+    bits = []
+    i = 0
+    while i < len(data):
+        maxlen = min(len(data) - i, 1 << lookahead)
+        best, offset = 0, 0
+        for j in range(max(0, i - (1 << window)), i):
+            n = 0
+            while n < maxlen and data[j + n] == data[i + n]:
+                n += 1
+            if n > best:
+                best, offset = n, i - j
+                if n == maxlen:
+                    break
+        if best >= 2:
+            bits.append("0" + format(offset - 1, "0%db" % window) + format(best - 1, "0%db" % lookahead))
+            i += best
+        else:
+            bits.append("1" + format(data[i], "08b"))
+            i += 1
+    s = "".join(bits)
+    s += "0" * (-len(s) % 8)
+    return bytes(int(s[k:k + 8], 2) for k in range(0, len(s), 8))
+
+
+def varints(data):
+    """Iterate over the ZigZag varints of a buffer."""
+    v, shift = 0, 0
+    for b in data:
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            yield (v >> 1) ^ -(v & 1)
+            v, shift = 0, 0
+    if shift:
+        raise ValueError("truncated varint")
+
+
+def varint(v):
+    zz = v << 1 if v >= 0 else (-v << 1) - 1
+    out = bytearray()
+    while True:
+        out.append((zz & 0x7F) | (0x80 if zz > 0x7F else 0))
+        zz >>= 7
+        if not zz:
+            return bytes(out)
+
+
+def decode(batch):
+    """Decode a batch into a dict with one entry per sample, raise ValueError if invalid."""
+    if len(batch) < BATCH_HEADER.size:
+        raise ValueError("batch too short")
+    magic, version, flags, chip, first, interval, mask, count = BATCH_HEADER.unpack_from(batch)
+    if magic != b"EB" or version != BATCH_VERSION:
+        raise ValueError("not a batch")
+    data = batch[BATCH_HEADER.size:]
+    if flags & FLAG_HEATSHRINK:
+        data = heatshrink_decode(data)
+    values = list(varints(data))
+    present = [c for c in CHANNELS if mask & c[0]]
+    if len(values) != count * len(present):
+        raise ValueError("%d values for %d samples" % (len(values), count))
+    samples = [{"time": first + i * interval if first else None} for i in range(count)]
+    for n, (_, name, div) in enumerate(present):
+        v = 0
+        for i in range(count):
+            v += values[n * count + i]
+            samples[i][name] = v / div
+    return {"chip": "%06X" % chip, "interval": interval, "samples": samples}
+
+
+def encode(samples, first, interval, compress, chip=0):
+    """Host mirror of batchEncode(), samples are (temp, hum, press, vbatt) in device units."""
+    data = bytearray()
+    for n in range(len(CHANNELS)):
+        prev = 0
+        for s in samples:
+            data += varint(s[n] - prev)
+            prev = s[n]
+    flags = 0
+    if compress:
+        packed = heatshrink_encode(bytes(data))
+        if len(packed) < len(data):
+            data, flags = packed, FLAG_HEATSHRINK
+    return BATCH_HEADER.pack(b"EB", BATCH_VERSION, flags, chip, first, interval, 0x0F,
+                             len(samples)) + bytes(data)
+
+
+def report_json(samples, interval):
+    """The JSON body reportPost() sends for the same samples."""
+    t, h, p, v = samples[-1]
+    body = '{"message":"","battery":%.2f,"wakeSource":"Timer","temperature":%.2f,' \
+           '"pressure":%.2f,"humidity":%.2f,"interval":%d,"samples":[%s]}' % (
+               v / 1000.0, t / 100.0, p / 100.0, h / 100.0, interval,
+               ",".join("[%d,%d,%d,%d]" % s for s in samples))
+    return body.encode()
+
+
+def synthetic(count, seed):
+    """Random walk looking like a room sensor."""
+    rnd = random.Random(seed)
+    t, h, p, v = 2150, 4500, 101325, 3900
+    out = []
+    for _ in range(count):
+        t += rnd.randint(-8, 8)
+        h += rnd.randint(-30, 30)
+        p += rnd.randint(-6, 6)
+        v -= rnd.random() < 0.1
+        out.append((t, h, p, v))
+    return out
+
+
+def timed(fn, *args):
+    start = time.perf_counter()
+    for _ in range(20):
+        out = fn(*args)
+    return out, (time.perf_counter() - start) / 20 * 1e6
+
+
+def bench(args):
+    print("%8s %8s %8s %8s %10s %10s %10s" % ("samples", "json", "batch", "hs", "json us", "batch us", "hs us"))
+    for count in args.samples:
+        samples = synthetic(count, count)
+        body, tj = timed(report_json, samples, 60)
+        raw, tb = timed(encode, samples, 1700000000, 60, False)
+        hs, th = timed(encode, samples, 1700000000, 60, True)
+        for b in (raw, hs):
+            got = [tuple(round(s[c[1]] * c[2]) for c in CHANNELS) for s in decode(b)["samples"]]
+            assert got == samples, "round trip failed"
+        print("%8d %8d %8d %8d %10.0f %10.0f %10.0f" % (count, len(body), len(raw), len(hs), tj, tb, th))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    d = sub.add_parser("decode")
+    d.add_argument("file")
+    b = sub.add_parser("bench")
+    b.add_argument("--samples", type=int, nargs="+", default=[1, 4, 10, 32])
+    args = parser.parse_args()
+
+    if args.cmd == "bench":
+        bench(args)
+        return
+    raw = (sys.stdin.buffer if args.file == "-" else open(args.file, "rb")).read()
+    try:
+        raw = bytes.fromhex(raw.decode())
+    except ValueError:
+        pass
+    print(json.dumps(decode(raw), indent=2))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,54 @@
+"""Decoding of the esLPWeather binary report frames (see include/frame.h)."""
+
+import hashlib
+import hmac
+import struct
+
+FRAME_DATA = struct.Struct("<2sBBIIHhHI")
+FRAME_MAC_SIZE = 8
+FRAME_SIZE = FRAME_DATA.size + FRAME_MAC_SIZE
+FRAME_VERSION = 1
+
+FLAG_EXTWAKE = 0x01
+FLAG_SENSOR = 0x02
+FLAG_ACK = 0x04
+
+ACK_DATA = struct.Struct("<2sII")
+
+
+def mac(key, data):
+    """Truncated HMAC-SHA256, as computed by the device."""
+    if not key:
+        return bytes(FRAME_MAC_SIZE)
+    return hmac.new(key, data, hashlib.sha256).digest()[:FRAME_MAC_SIZE]
+
+
+def decode(frame, key=None):
+    """Decode a report frame into a dict, raise ValueError if invalid.
+
+    When a key is given, the frame MAC must match.
+    """
+    if len(frame) != FRAME_SIZE:
+        raise ValueError("bad frame size %d" % len(frame))
+    data, tag = frame[:FRAME_DATA.size], frame[FRAME_DATA.size:]
+    magic, version, flags, chip, seq, vbatt, temp, hum, press = FRAME_DATA.unpack(data)
+    if magic != b"EL" or version != FRAME_VERSION:
+        raise ValueError("not a report frame")
+    if key is not None and not hmac.compare_digest(tag, mac(key, data)):
+        raise ValueError("bad MAC")
+    report = {
+        "chip": "%06X" % chip,
+        "seq": seq,
+        "battery": vbatt / 1000.0,
+        "wakeSource": "External" if flags & FLAG_EXTWAKE else "Timer",
+        "ack": bool(flags & FLAG_ACK),
+    }
+    if flags & FLAG_SENSOR:
+        report.update(temperature=temp / 100.0, humidity=hum / 100.0, pressure=press / 100.0)
+    return report
+
+
+def ack(chip, seq, key=None):
+    """Build the acknowledge frame of a report."""
+    data = ACK_DATA.pack(b"EA", int(chip, 16), seq)
+    return data + mac(key, data)
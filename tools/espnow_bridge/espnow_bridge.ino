@@ -0,0 +1,44 @@
+// ESP-NOW gateway radio: prints every received frame on the serial link as
+// "<sender MAC> <frame in hex>" lines, for tools/espnow_gateway.py.
+// Flash it on any ESP8266 kept powered, built with CHANNEL set to the
+// espnow_channel of the boards, eg: -DCHANNEL=6. The boards send on that
+// channel only, a gateway on another one never hears them.
+#include <ESP8266WiFi.h>
+
+extern "C" {
+#include <espnow.h>
+}
+
+// WiFi channel, must match espnow_channel (1 to 14)
+#ifndef CHANNEL
+#define CHANNEL 1
+#endif
+
+static void onRecv(uint8_t * mac, uint8_t * data, uint8_t len)
+{
+  Serial.printf("%02X:%02X:%02X:%02X:%02X:%02X ",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  while (len--)
+    Serial.printf("%02x", *data++);
+  Serial.print("\n");
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();
+  wifi_set_channel(CHANNEL);
+
+  esp_now_init();
+  esp_now_set_self_role(ESP_NOW_ROLE_SLAVE);
+  esp_now_register_recv_cb(onRecv);
+
+  Serial.print("\nMAC ");
+  Serial.print(WiFi.macAddress());
+  Serial.printf(" channel %d\n", CHANNEL);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Reference ESP-NOW gateway forwarder.
+
+Reads "<sender MAC> <frame hex>" lines from the gateway radio link
+(tools/espnow_bridge, or any file/pipe simulating it), checks and decodes
+the report frames and forwards them as JSON, either printed or POSTed.
+
+    espnow_gateway.py --link /dev/ttyUSB0 --key mysharedkey --forward http://server/report
+    echo "5C:CF:7F:00:00:01 454c..." | espnow_gateway.py --key mysharedkey
+"""
+
+import argparse
+import json
+import os
+import stat
+import sys
+import urllib.request
+
+import eslpframe
+
+
+def forward(report, url):
+    req = urllib.request.Request(url, data=json.dumps(report).encode(),
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req, timeout=10) as resp:
+        resp.read()
+
+
+def lines(args):
+    if not args.link:
+        yield from sys.stdin
+        return
+    if not stat.S_ISCHR(os.stat(args.link).st_mode):
+        # Recorded or simulated link
+        with open(args.link, "r", errors="replace") as link:
+            yield from link
+        return
+    import serial  # pyserial
+
+    # Serial.begin() of the bridge sketch
+    with serial.Serial(args.link, args.baud) as link:
+        while True:
+            yield link.readline().decode(errors="replace")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--link", help="radio link (serial device or file), stdin by default")
+    parser.add_argument("--baud", type=int, default=115200, help="serial device speed, as the bridge")
+    parser.add_argument("--key", help="shared key (report_key), MACs are not checked without it")
+    parser.add_argument("--forward", metavar="URL", help="POST reports to this URL instead of printing them")
+    args = parser.parse_args()
+
+    key = args.key.encode() if args.key else None
+    last = {}
+
+    for line in lines(args):
+        fields = line.split()
+        if len(fields) != 2 or fields[0].count(":") != 5:
+            continue  # bridge chatter
+        try:
+            report = eslpframe.decode(bytes.fromhex(fields[1]), key)
+        except ValueError as err:
+            print("%s: %s" % (fields[0], err), file=sys.stderr)
+            continue
+
+        # Retried frame whose link acknowledge got lost
+        if last.get(report["chip"]) == report["seq"]:
+            continue
+        last[report["chip"]] = report["seq"]
+
+        report["from"] = fields[0]
+        if args.forward:
+            try:
+                forward(report, args.forward)
+            except OSError as err:
+                print("forward failed: %s" % err, file=sys.stderr)
+        else:
+            print(json.dumps(report), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,220 @@
+#pragma once
+// Host simulation of the ESP8266 Arduino core, only what the firmware uses.
+// PROGMEM is plain memory, String allocations go through the simulated
+// heap (see hostsim.h) so handlers see the same out of memory behaviour.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <ctype.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Flash strings
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(const uint16_t *) (p))
+#define pgm_read_dword(p) (*(const uint32_t *) (p))
+#define pgm_read_ptr(p) (*(void * const *) (p))
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strncasecmp_P strncasecmp
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+// GPIO, A0 reads hostsim.adc (see hostsim.h)
+#define A0 17
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void pinMode(uint8_t pin, uint8_t mode);
+int analogRead(uint8_t pin);
+extern "C" { void esp_yield(void); void esp_schedule(void); }
+
+char * dtostrf(double value, signed char width, unsigned char prec, char * s);
+char * utoa(unsigned value, char * s, int radix);
+char * ltoa(long value, char * s, int radix);
+
+template<typename T> T min(T a, T b) { return a < b ? a : b; }
+template<typename T> T max(T a, T b) { return a > b ? a : b; }
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+#define RANDOM_REG32 ((uint32_t) rand())
+
+class String
+{
+public:
+  String(const char * s = "");
+  String(const String & s);
+  String(const __FlashStringHelper * s);
+  explicit String(char c);
+  explicit String(unsigned char v, unsigned char base = 10);
+  explicit String(int v, unsigned char base = 10);
+  explicit String(unsigned int v, unsigned char base = 10);
+  explicit String(long v, unsigned char base = 10);
+  explicit String(unsigned long v, unsigned char base = 10);
+  explicit String(float v, unsigned char decimals = 2);
+  explicit String(double v, unsigned char decimals = 2);
+  ~String();
+
+  String & operator=(const String & s);
+  String & operator=(const char * s);
+  String & operator=(const __FlashStringHelper * s);
+
+  bool reserve(unsigned int size);
+  bool concat(const char * s, unsigned int len);
+  String & operator+=(const String & s);
+  String & operator+=(const char * s);
+  String & operator+=(const __FlashStringHelper * s);
+  String & operator+=(char c);
+  String & operator+=(unsigned char v);
+  String & operator+=(int v);
+  String & operator+=(unsigned int v);
+  String & operator+=(long v);
+  String & operator+=(unsigned long v);
+  String & operator+=(float v);
+  String & operator+=(double v);
+  friend String operator+(const String & a, const String & b);
+  friend String operator+(const String & a, const char * b);
+  friend String operator+(const String & a, const __FlashStringHelper * b);
+  friend String operator+(const char * a, const String & b);
+  friend String operator+(const String & a, char b);
+
+  const char * c_str() const { return buf ? buf : ""; }
+  unsigned int length() const { return len; }
+  bool equals(const String & s) const;
+  bool operator==(const String & s) const { return equals(s); }
+  bool operator==(const char * s) const { return !strcmp(c_str(), s); }
+  bool operator!=(const String & s) const { return !equals(s); }
+  bool operator!=(const char * s) const { return strcmp(c_str(), s) != 0; }
+  bool startsWith(const String & s) const;
+  bool endsWith(const String & s) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String & s, unsigned int from = 0) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  char charAt(unsigned int i) const { return i < len ? buf[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return atof(c_str()); }
+  void trim();
+  void toLowerCase();
+
+private:
+  char * buf;
+  unsigned int len;
+  unsigned int cap;
+  bool invalidate(void);
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t * b, size_t n);
+  size_t write(const char * s) { return write((const uint8_t *) s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+  size_t printf(const char * fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t printf_P(const char * fmt, ...);
+  size_t print(const __FlashStringHelper * s) { return write((const char *) s); }
+  size_t print(const String & s) { return write(s.c_str()); }
+  size_t print(const char * s) { return write(s); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(unsigned char v, int base = 10) { return print((unsigned long) v, base); }
+  size_t print(int v, int base = 10) { return print((long) v, base); }
+  size_t print(unsigned int v, int base = 10) { return print((unsigned long) v, base); }
+  size_t print(long v, int base = 10);
+  size_t print(unsigned long v, int base = 10);
+  size_t print(double v, int decimals = 2);
+  size_t println(const __FlashStringHelper * s) { return print(s) + println(); }
+  size_t println(const String & s) { return print(s) + println(); }
+  size_t println(const char * s) { return print(s) + println(); }
+  size_t println(int v, int base = 10) { return print(v, base) + println(); }
+  size_t println(void) { return write("\r\n"); }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t * b, size_t n);
+  size_t readBytes(char * b, size_t n) { return readBytes((uint8_t *) b, n); }
+  void setTimeout(unsigned long ms) { timeout = ms; }
+  String readStringUntil(char end);
+protected:
+  unsigned long timeout = 1000;
+};
+
+#include "HardwareSerial.h"
+
+enum RFMode { RF_DEFAULT = 0, RF_CAL = 1, RF_NO_CAL = 2, RF_DISABLED = 4 };
+#define WAKE_RF_DEFAULT  RF_DEFAULT
+#define WAKE_RFCAL       RF_CAL
+#define WAKE_NO_RFCAL    RF_NO_CAL
+#define WAKE_RF_DISABLED RF_DISABLED
+
+struct rst_info;
+
+class EspClass
+{
+public:
+  uint32_t getChipId(void);
+  void restart(void);
+  uint32_t getFreeSketchSpace(void);
+  uint32_t getSketchSize(void);
+  uint32_t getFlashChipRealSize(void);
+  void eraseConfig(void);
+  void deepSleep(uint64_t us, RFMode mode = RF_DEFAULT);
+  uint64_t deepSleepMax(void);
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t * data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t * data, size_t size);
+  uint32_t getCycleCount(void);
+  uint32_t getFreeHeap(void);
+  uint32_t getMaxFreeBlockSize(void);
+  uint8_t getCpuFreqMHz(void);
+  String getSketchMD5(void);
+  String getResetReason(void);
+  String getResetInfo(void);
+  bool flashEraseSector(uint32_t sector);
+  bool flashWrite(uint32_t offset, uint32_t * data, size_t size);
+  bool flashRead(uint32_t offset, uint32_t * data, size_t size);
+  struct rst_info * getResetInfoPtr(void);
+};
+extern EspClass ESP;
+
+#include "Updater.h"
@@ -0,0 +1,19 @@
+#pragma once
+#include "IPAddress.h"
+
+class Client : public Stream
+{
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char * host, uint16_t port) = 0;
+  size_t write(uint8_t c) override { return 0; }
+  size_t write(const uint8_t * b, size_t n) override { return 0; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t * b, size_t n) { return -1; }
+  int peek() override { return -1; }
+  virtual void stop() {}
+  virtual uint8_t connected() { return 0; }
+  operator bool() { return connected(); }
+  using Print::write;
+};
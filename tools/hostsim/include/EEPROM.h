@@ -0,0 +1,31 @@
+#pragma once
+// EEPROM on an image file (--eeprom), loaded by begin() and written by
+// commit()
+#include <Arduino.h>
+
+class EEPROMClass
+{
+public:
+  void begin(size_t size);
+  uint8_t read(int addr) { return addr >= 0 && (size_t) addr < _data.size() ? _data[addr] : 0; }
+  void write(int addr, uint8_t v) { if (addr >= 0 && (size_t) addr < _data.size()) _data[addr] = v; }
+  bool commit(void);
+  void end(void);
+  uint8_t * getDataPtr(void) { return _data.data(); }
+  size_t length(void) { return _data.size(); }
+  template<typename T> T & get(int addr, T & t)
+  {
+    if (addr >= 0 && addr + sizeof(T) <= _data.size())
+      memcpy(&t, &_data[addr], sizeof(T));
+    return t;
+  }
+  template<typename T> const T & put(int addr, const T & t)
+  {
+    if (addr >= 0 && addr + sizeof(T) <= _data.size())
+      memcpy(&_data[addr], &t, sizeof(T));
+    return t;
+  }
+private:
+  std::vector<uint8_t> _data;
+};
+extern EEPROMClass EEPROM;
@@ -0,0 +1,35 @@
+#pragma once
+// No network from the board side: requests always fail
+#include <ESP8266WiFi.h>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+class HTTPClient
+{
+public:
+  bool begin(String url) { return true; }
+  bool begin(String host, uint16_t port, String uri) { return true; }
+  bool begin(WiFiClient & client, String url) { return true; }
+  bool begin(WiFiClient & client, String host, uint16_t port, String uri = "/", bool https = false) { return true; }
+  void end() {}
+  void setReuse(bool reuse) {}
+  void setTimeout(uint16_t ms) {}
+  void addHeader(const String & name, const String & value, bool first = false, bool replace = true) {}
+  void collectHeaders(const char * names[], size_t n) {}
+  String header(const char * name) { return String(); }
+  bool hasHeader(const char * name) { return false; }
+  int GET() { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  int POST(uint8_t * b, size_t n) { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  int POST(String payload) { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  int getSize() { return -1; }
+  WiFiClient & getStream() { return _client; }
+  WiFiClient * getStreamPtr() { return NULL; }
+  String getString() { return String(); }
+  int writeToStream(Stream * s) { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  static String errorToString(int error) { return F("connection refused"); }
+  bool connected() { return false; }
+private:
+  WiFiClient _client;
+};
@@ -0,0 +1,111 @@
+#pragma once
+// ESP8266WebServer over a POSIX listening socket. Like the core one it
+// serves one client at a time from handleClient() and closes every
+// connection after its response. Per URI statistics are kept for the
+// load test, see hostsim.h
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include <string>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define HTTP_UPLOAD_BUFLEN 2048
+
+struct HTTPUpload
+{
+  HTTPUploadStatus status;
+  String filename;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  ESP8266WebServer(int port);
+  void begin(void);
+  void handleClient(void);
+  void on(const String & uri, THandlerFunction fn);
+  void on(const String & uri, HTTPMethod method, THandlerFunction fn);
+  void on(const String & uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+  void onNotFound(THandlerFunction fn);
+  void serveStatic(const char * uri, fs::FS & fs, const char * path, const char * cache = NULL);
+
+  String uri(void);
+  HTTPMethod method(void);
+  String arg(const String & name);
+  String arg(int i);
+  String argName(int i);
+  int args(void);
+  bool hasArg(const String & name);
+  HTTPUpload & upload(void);
+
+  void sendHeader(const String & name, const String & value, bool first = false);
+  void send(int code, const char * type, const String & content);
+  void send(int code, const String & type, const String & content);
+  void send(int code, const char * type = NULL);
+  void send_P(int code, PGM_P type, PGM_P content);
+  void setContentLength(size_t len);
+  void sendContent(const String & content);
+  void sendContent_P(PGM_P content);
+  void sendContent_P(PGM_P content, size_t len);
+  template<typename T> size_t streamFile(T & file, const String & type);
+  WiFiClient client(void);
+
+private:
+  friend size_t hostsimStreamFile(ESP8266WebServer & server, fs::File & file);
+
+  struct Route
+  {
+    std::string uri;                // Exact URI, or prefix for static files
+    HTTPMethod method;
+    THandlerFunction fn;
+    THandlerFunction ufn;           // Upload handler
+    std::string path;               // Static files only
+    std::string cache;
+  };
+  struct Arg
+  {
+    std::string name;
+    std::string value;
+  };
+
+  void addArgs(const std::vector<std::string> & pairs);
+  bool readRequest(void);
+  bool readUpload(const std::string & boundary, size_t length);
+  bool serveFile(const Route & r);
+  void sendRaw(const char * data, size_t len);
+  void sendHead(int code, const char * type, size_t len);
+  void sendBody(const char * data, size_t len);
+
+  int _port;
+  int _listen;
+  int _sock;
+  std::vector<Route> _routes;
+  THandlerFunction _notFound;
+  HTTPMethod _method;
+  std::string _uri;
+  std::vector<Arg> _args;
+  std::string _headers;             // Pending sendHeader() lines
+  size_t _length;                   // setContentLength(), 0 if none
+  bool _sent;
+  bool _chunked;                    // Content length unknown, body sent by chunks
+  HTTPUpload _upload;
+  std::string _in;                  // Received bytes not parsed yet
+};
+
+size_t hostsimStreamFile(ESP8266WebServer & server, fs::File & file);
+
+template<typename T> size_t ESP8266WebServer::streamFile(T & file, const String & type)
+{
+  String name(file.name());
+  if (name.endsWith(".gz") && type != "application/x-gzip" && type != "application/octet-stream")
+    sendHeader("Content-Encoding", "gzip");
+  setContentLength(file.size());
+  send(200, type, "");
+  return hostsimStreamFile(*this, file);
+}
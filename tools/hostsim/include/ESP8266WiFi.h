@@ -0,0 +1,86 @@
+#pragma once
+// Station mode connects at once to any configured SSID, the soft AP always
+// starts. A scan finds a fixed list of networks. No name resolves, see
+// WiFiClient.h for the rest of the network
+#include <Arduino.h>
+#include <string>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiUdp.h"
+#include "WiFiClientSecure.h"
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+typedef enum { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL = 1, WL_CONNECTED = 3, WL_CONNECT_FAILED = 4, WL_DISCONNECTED = 6 } wl_status_t;
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } WiFiMode_t;
+typedef enum { WIFI_PHY_MODE_11B = 1, WIFI_PHY_MODE_11G = 2, WIFI_PHY_MODE_11N = 3 } WiFiPhyMode_t;
+typedef enum { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 } WiFiSleepType_t;
+
+struct WiFiEventStationModeGotIP { IPAddress ip, mask, gw; };
+struct WiFiEventStationModeDisconnected { String ssid; uint8_t bssid[6]; int reason; };
+struct WiFiEventStationModeConnected { String ssid; uint8_t bssid[6]; uint8_t channel; };
+class WiFiEventHandlerOpaque {};
+typedef std::shared_ptr<WiFiEventHandlerOpaque> WiFiEventHandler;
+
+class ESP8266WiFiClass
+{
+public:
+  bool mode(WiFiMode_t m) { _mode = m; return true; }
+  WiFiMode_t getMode() { return _mode; }
+  bool config(IPAddress ip, IPAddress gw, IPAddress mask, IPAddress dns = IPAddress());
+  wl_status_t begin(const char * ssid, const char * psk = NULL, int32_t channel = 0, const uint8_t * bssid = NULL, bool connect = true);
+  wl_status_t status() { return _status; }
+  bool disconnect(bool off = false);
+  int hostByName(const char * host, IPAddress & ip) { return 0; }
+  int hostByName(const char * host, IPAddress & ip, uint32_t timeout) { return 0; }
+  IPAddress localIP() { return _ip; }
+  IPAddress dnsIP(uint8_t n = 0) { return _dns; }
+  IPAddress gatewayIP() { return _gw; }
+  String macAddress();
+  uint8_t * macAddress(uint8_t * mac);
+  String SSID() { return String(_ssid.c_str()); }
+  String SSID(uint8_t i);
+  String psk() { return String(_psk.c_str()); }
+  int32_t RSSI() { return _status == WL_CONNECTED ? -58 : 0; }
+  int32_t RSSI(uint8_t i);
+  int32_t channel() { return _channel; }
+  int32_t channel(uint8_t i);
+  uint8_t * BSSID() { return _bssid; }
+  uint8_t * BSSID(uint8_t i);
+  void printDiag(Print & p);
+  int8_t scanNetworks(bool async = false, bool hidden = false);
+  int8_t scanComplete();
+  void scanDelete() { _scanned = false; }
+  bool softAP(const char * ssid, const char * psk = NULL) { return true; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  String softAPmacAddress();
+  bool hostname(const char * name) { return true; }
+  void setOutputPower(float dbm) {}
+  bool setPhyMode(WiFiPhyMode_t m) { return true; }
+  bool setSleepMode(WiFiSleepType_t t) { return true; }
+  bool forceSleepBegin(uint32_t us = 0) { return true; }
+  bool forceSleepWake() { return true; }
+  void persistent(bool on) {}
+  bool setAutoConnect(bool on) { return true; }
+  bool setAutoReconnect(bool on) { return true; }
+  WiFiEventHandler onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> fn);
+  WiFiEventHandler onStationModeDisconnected(std::function<void(const WiFiEventStationModeDisconnected &)> fn);
+  WiFiEventHandler onStationModeConnected(std::function<void(const WiFiEventStationModeConnected &)> fn);
+
+private:
+  WiFiMode_t _mode = WIFI_STA;
+  wl_status_t _status = WL_DISCONNECTED;
+  std::string _ssid;
+  std::string _psk;
+  int32_t _channel = 6;
+  bool _scanned = false;
+  uint8_t _bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  IPAddress _ip;
+  IPAddress _gw;
+  IPAddress _dns;
+  std::function<void(const WiFiEventStationModeGotIP &)> _gotIP;
+  std::function<void(const WiFiEventStationModeDisconnected &)> _disconnected;
+  std::function<void(const WiFiEventStationModeConnected &)> _connected;
+};
+extern ESP8266WiFiClass WiFi;
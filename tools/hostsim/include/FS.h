@@ -0,0 +1,86 @@
+#pragma once
+// SPIFFS on a host directory: files are read from the data directory
+// (--data), written and removed in an overlay one so the tree is never
+// modified. Names are flat paths like on SPIFFS, "/js/app.js.gz"
+#include <Arduino.h>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+struct DirImpl;
+
+class File : public Stream
+{
+public:
+  File() {}
+  File(std::shared_ptr<FileImpl> impl) : _p(impl) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t * b, size_t n) override;
+  int available() override;
+  int read() override;
+  size_t read(uint8_t * b, size_t n);
+  int peek() override;
+  void flush() override;
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  const char * name() const;
+  bool truncate(uint32_t size);
+  using Print::write;
+private:
+  std::shared_ptr<FileImpl> _p;
+};
+
+class Dir
+{
+public:
+  Dir() {}
+  Dir(std::shared_ptr<DirImpl> impl) : _p(impl) {}
+  bool next();
+  String fileName();
+  size_t fileSize();
+  File openFile(const char * mode);
+private:
+  std::shared_ptr<DirImpl> _p;
+};
+
+struct FSInfo
+{
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS
+{
+public:
+  bool begin();
+  void end();
+  bool info(FSInfo & info);
+  File open(const char * path, const char * mode);
+  File open(const String & path, const char * mode) { return open(path.c_str(), mode); }
+  bool exists(const char * path);
+  bool exists(const String & path) { return exists(path.c_str()); }
+  Dir openDir(const char * path);
+  bool remove(const char * path);
+  bool rename(const char * from, const char * to);
+  bool format();
+};
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::Dir;
+using fs::FSInfo;
+using fs::SeekSet;
+using fs::SeekEnd;
+using fs::SeekCur;
+extern fs::FS SPIFFS;
@@ -0,0 +1,24 @@
+#pragma once
+// Serial goes to the console, Serial1 nowhere
+enum SerialConfig { SERIAL_8N1 };
+enum SerialMode { SERIAL_FULL, SERIAL_TX_ONLY };
+
+class HardwareSerial : public Stream
+{
+public:
+  HardwareSerial(int uart) : _uart(uart) {}
+  void begin(unsigned long baud) {}
+  void begin(unsigned long baud, SerialConfig config, SerialMode mode) {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t * b, size_t n) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  int availableForWrite() override { return 128; }
+  void flush() override {}
+  using Print::write;
+private:
+  int _uart;
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+
+class IPAddress
+{
+public:
+  IPAddress() : _a(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _a(a | b << 8 | c << 16 | (uint32_t) d << 24) {}
+  IPAddress(uint32_t a) : _a(a) {}
+  operator uint32_t() const { return _a; }
+  bool fromString(const String & s) { return fromString(s.c_str()); }
+  bool fromString(const char * s);
+  String toString() const;
+  uint8_t operator[](int i) const { return _a >> (8 * i); }
+  uint8_t & operator[](int i) { return ((uint8_t *) &_a)[i]; }
+  bool isSet() const { return _a != 0; }
+  bool operator==(const IPAddress & a) const { return _a == a._a; }
+private:
+  uint32_t _a;
+};
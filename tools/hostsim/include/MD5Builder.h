@@ -0,0 +1,12 @@
+#pragma once
+// Checksums are not computed, toString() gives zeros
+class MD5Builder
+{
+public:
+  void begin() {}
+  void add(const uint8_t * b, uint16_t n) {}
+  bool addStream(Stream & s, size_t n) { return true; }
+  void calculate() {}
+  String toString() { return F("00000000000000000000000000000000"); }
+  void getBytes(uint8_t * b) { memset(b, 0, 16); }
+};
@@ -0,0 +1,20 @@
+#pragma once
+// Firmware updates are received and dropped
+class UpdaterClass
+{
+public:
+  bool begin(size_t size, int command = 0) { _size = 0; return true; }
+  size_t write(uint8_t * b, size_t n) { _size += n; return n; }
+  size_t writeStream(Stream & s);
+  bool end(bool evenIfRemaining = false) { return true; }
+  bool setMD5(const char * md5) { return true; }
+  bool hasError() { return false; }
+  void printError(Print & p) {}
+  uint8_t getError() { return 0; }
+  String md5String();
+  bool isFinished() { return true; }
+private:
+  size_t _size;
+};
+extern UpdaterClass Update;
+#define U_FLASH 0
@@ -0,0 +1,13 @@
+#pragma once
+// No network from the board side: connections always fail
+#include "Client.h"
+
+class WiFiClient : public Client
+{
+public:
+  int connect(IPAddress ip, uint16_t port) override { return 0; }
+  int connect(const char * host, uint16_t port) override { return 0; }
+  void setNoDelay(bool on) {}
+  void setTimeout(unsigned long ms) {}
+  static void stopAll() {}
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include "WiFiClient.h"
+#include <bearssl/bearssl.h>
+
+struct br_ssl_session_parameters
+{
+  uint8_t session_id[32];
+  uint8_t session_id_len;
+  uint16_t version;
+  uint16_t cipher_suite;
+  uint8_t master_secret[48];
+};
+
+namespace BearSSL {
+
+class Session
+{
+  br_ssl_session_parameters _session;
+};
+
+class PublicKey
+{
+public:
+  PublicKey(const char * pem) {}
+  PublicKey(const uint8_t * der, size_t len) {}
+  bool parse(const uint8_t * der, size_t len) { return false; }
+};
+
+class WiFiClientSecureCtx : public WiFiClient
+{
+public:
+  void setFingerprint(const uint8_t * fp) {}
+  bool setFingerprint(const char * fp) { return true; }
+  void setKnownKey(const PublicKey * pk, unsigned usages = 0) {}
+  void setInsecure() {}
+  void setSession(Session * s) {}
+  void setBufferSizes(int rx, int tx) {}
+  bool setCiphers(const uint16_t * list, int n) { return true; }
+  bool setCiphersLessSecure() { return true; }
+  static bool probeMaxFragmentLength(IPAddress ip, uint16_t port, uint16_t len) { return false; }
+  static bool probeMaxFragmentLength(const char * host, uint16_t port, uint16_t len) { return false; }
+  int getLastSSLError(char * buf = NULL, size_t len = 0) { return 0; }
+  uint8_t connected() override { return 0; }
+protected:
+  bool _connectSSL(const char * host) { return false; }
+};
+
+class WiFiClientSecure : public WiFiClientSecureCtx {};
+
+}
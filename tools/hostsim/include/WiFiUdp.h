@@ -0,0 +1,24 @@
+#pragma once
+// No network from the board side: nothing is ever received
+#include "IPAddress.h"
+
+class WiFiUDP : public Stream
+{
+public:
+  uint8_t begin(uint16_t port) { return 1; }
+  void stop() {}
+  int beginPacket(IPAddress ip, uint16_t port) { return 1; }
+  int beginPacket(const char * host, uint16_t port) { return 0; }
+  int endPacket() { return 1; }
+  size_t write(uint8_t c) override { return 1; }
+  size_t write(const uint8_t * b, size_t n) override { return n; }
+  int parsePacket() { return 0; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t * b, size_t n) { return 0; }
+  int peek() override { return -1; }
+  IPAddress remoteIP() { return IPAddress(); }
+  uint16_t remotePort() { return 0; }
+  static void stopAll() {}
+  using Print::write;
+};
@@ -0,0 +1,20 @@
+#pragma once
+// HMAC-SHA256 interface only. Not a real MAC, see network.cpp
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct br_hash_class_ br_hash_class;
+extern const br_hash_class br_sha256_vtable;
+typedef struct { uint8_t b[128]; } br_hmac_key_context;
+typedef struct { uint8_t b[256]; } br_hmac_context;
+
+void br_hmac_key_init(br_hmac_key_context * kc, const br_hash_class * dig, const void * key, size_t len);
+void br_hmac_init(br_hmac_context * ctx, const br_hmac_key_context * kc, size_t out_len);
+void br_hmac_update(br_hmac_context * ctx, const void * data, size_t len);
+size_t br_hmac_out(const br_hmac_context * ctx, void * out);
+
+#define br_sha256_SIZE 32
+#define BR_TLS_RSA_WITH_AES_128_GCM_SHA256 0x009C
+#define BR_TLS_RSA_WITH_AES_128_CBC_SHA256 0x003C
+#define BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 0xC02F
+#define BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 0xC02B
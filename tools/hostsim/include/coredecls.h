@@ -0,0 +1,11 @@
+#pragma once
+// Core internals, esp_delay() polls as nothing schedules the loop here
+#include <Arduino.h>
+
+template <typename T> inline void esp_delay(const uint32_t timeout_ms, T && blocked)
+{
+  uint32_t start = millis();
+
+  while (blocked() && millis() - start < timeout_ms)
+    delay(1);
+}
@@ -0,0 +1,21 @@
+#pragma once
+// UART0 registers, enough for the log output of log.cpp. The TX FIFO is
+// always empty, bytes written to it go to the console
+#include <stdint.h>
+
+struct HostsimUartFifo
+{
+  HostsimUartFifo & operator=(uint32_t c);
+};
+extern HostsimUartFifo hostsimUartFifo;
+extern volatile uint32_t hostsimUartRegs[0x10];
+
+#define USF(u)  hostsimUartFifo
+#define USIS(u) hostsimUartRegs[2]
+#define USIE(u) hostsimUartRegs[3]
+#define USIC(u) hostsimUartRegs[4]
+#define USS(u)  hostsimUartRegs[7]
+#define USC1(u) hostsimUartRegs[9]
+#define UIFE  1
+#define USTXC 16
+#define UCFET 8
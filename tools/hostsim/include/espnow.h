@@ -0,0 +1,15 @@
+#pragma once
+// No radio: ESP-NOW fails to start
+#include <stdint.h>
+
+enum esp_now_role { ESP_NOW_ROLE_IDLE = 0, ESP_NOW_ROLE_CONTROLLER, ESP_NOW_ROLE_SLAVE, ESP_NOW_ROLE_COMBO };
+typedef void (*esp_now_recv_cb_t)(uint8_t * mac, uint8_t * data, uint8_t len);
+typedef void (*esp_now_send_cb_t)(uint8_t * mac, uint8_t status);
+
+inline int esp_now_init(void) { return -1; }
+inline int esp_now_deinit(void) { return 0; }
+inline int esp_now_set_self_role(uint8_t role) { return -1; }
+inline int esp_now_add_peer(uint8_t * mac, uint8_t role, uint8_t channel, uint8_t * key, uint8_t len) { return -1; }
+inline int esp_now_register_send_cb(esp_now_send_cb_t cb) { return 0; }
+inline int esp_now_register_recv_cb(esp_now_recv_cb_t cb) { return 0; }
+inline int esp_now_send(uint8_t * mac, uint8_t * data, int len) { return -1; }
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+
+typedef void (*int_handler_t)(void *);
+#ifdef __cplusplus
+extern "C" {
+#endif
+void ets_isr_attach(int num, int_handler_t fn, void * arg);
+void ets_isr_mask(uint32_t mask);
+void ets_isr_unmask(uint32_t mask);
+#ifdef __cplusplus
+}
+#endif
+
+#define ETS_UART_INUM 5
+#define ETS_UART_INTR_ATTACH(func, arg) ets_isr_attach(ETS_UART_INUM, (int_handler_t) (func), (void *) (arg))
+#define ETS_UART_INTR_ENABLE() ets_isr_unmask(1 << ETS_UART_INUM)
+#define ETS_UART_INTR_DISABLE() ets_isr_mask(1 << ETS_UART_INUM)
@@ -0,0 +1,37 @@
+#pragma once
+// Host simulation internals, shared by the shim sources
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+struct HostsimOptions
+{
+  int port;                         // Listening port for the board port 80
+  std::string data;                 // SPIFFS image directory
+  std::string overlay;              // SPIFFS writes go there
+  std::string eeprom;               // EEPROM image file
+  size_t heap;                      // Simulated heap size (bytes)
+  int adc;                          // A0 reading
+  bool quiet;                       // No firmware log on stdout
+};
+extern HostsimOptions hostsim;
+
+// Simulated heap: String buffers, the only dynamic allocations of the
+// firmware, are counted against hostsim.heap, about what the ESP8266 has
+// free in config mode. A failed allocation returns NULL
+void * hostsimAlloc(size_t size);
+void * hostsimRealloc(void * p, size_t size);
+void hostsimFree(void * p);
+size_t hostsimHeapUsed(void);
+size_t hostsimHeapPeak(void);
+void hostsimHeapPeakReset(void);
+uint32_t hostsimHeapFailed(void);
+
+// Microseconds since start
+uint64_t hostsimMicros(void);
+
+// Firmware log output (UART0 and Serial)
+void hostsimConsole(const char * s, size_t n);
+
+// Runs the UART interrupt handler while its TX interrupt is enabled
+void hostsimUartService(void);
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+enum rst_reason
+{
+  REASON_DEFAULT_RST = 0, REASON_WDT_RST = 1, REASON_EXCEPTION_RST = 2, REASON_SOFT_WDT_RST = 3,
+  REASON_SOFT_RESTART = 4, REASON_DEEP_SLEEP_AWAKE = 5, REASON_EXT_SYS_RST = 6
+};
+struct rst_info { uint32_t reason, exccause, epc1, epc2, epc3, excvaddr, depc; };
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+bool system_update_cpu_freq(uint8_t freq);
+const char * system_get_sdk_version(void);
+uint32_t system_get_chip_id(void);
+uint8_t system_get_boot_version(void);
+uint32_t system_get_free_heap_size(void);
+uint32_t system_get_time(void);
+bool wifi_set_channel(uint8_t channel);
+bool system_rtc_mem_read(uint8_t addr, void * dst, uint16_t size);
+bool system_rtc_mem_write(uint8_t addr, const void * src, uint16_t size);
+void system_phy_set_max_tpw(uint8_t power);
+struct rst_info * system_get_rst_info(void);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Load test of the config mode web server running in hostsim.
+
+Each route is hit by concurrent clients for a while, then the client side
+rates and latencies are printed along with what hostsim measured in the
+firmware: handler time, heap peak over the level before the request and
+allocations refused. See README.md.
+"""
+import argparse
+import http.client
+import json
+import threading
+import time
+import urllib.parse
+
+ROUTES = [
+    ("GET", "/system.json"),
+    ("GET", "/config.json"),
+    ("POST", "/config_form.json"),
+    ("GET", "/spiffs.json"),
+    ("GET", "/wifiscan.json"),
+    ("GET", "/log.json"),
+    ("GET", "/sched.json"),
+    ("GET", "/history.json"),
+    ("GET", "/hb.htm"),
+    ("GET", "/"),
+    ("GET", "/js/app.js"),
+    ("GET", "/css/app.css"),
+]
+
+
+def request(host, port, method, path, body=None):
+    conn = http.client.HTTPConnection(host, port, timeout=10)
+    headers = {}
+    if body is not None:
+        headers["Content-Type"] = "application/x-www-form-urlencoded"
+    conn.request(method, path, body, headers)
+    resp = conn.getresponse()
+    data = resp.read()
+    conn.close()
+    return resp.status, data
+
+
+def config_form(host, port):
+    """The saved configuration posted back, as the web page does."""
+    status, data = request(host, port, "GET", "/config.json")
+    if status != 200:
+        raise SystemExit("GET /config.json: HTTP %d" % status)
+    fields = json.loads(data.decode("utf-8", "replace"))
+    fields["save"] = "1"
+    return urllib.parse.urlencode(fields)
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def run_route(args, method, path, body):
+    latencies = []
+    errors = [0]
+    lock = threading.Lock()
+    deadline = time.monotonic() + args.duration
+
+    def client():
+        while time.monotonic() < deadline:
+            start = time.monotonic()
+            try:
+                status, _ = request(args.host, args.port, method, path, body)
+                ok = status == 200
+            except (OSError, http.client.HTTPException):
+                ok = False
+            elapsed = time.monotonic() - start
+            with lock:
+                if ok:
+                    latencies.append(elapsed)
+                else:
+                    errors[0] += 1
+
+    threads = [threading.Thread(target=client) for _ in range(args.clients)]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    wall = time.monotonic() - start
+    latencies.sort()
+    return {
+        "count": len(latencies),
+        "errors": errors[0],
+        "rps": len(latencies) / wall if wall else 0.0,
+        "p50": percentile(latencies, 50) * 1000,
+        "p95": percentile(latencies, 95) * 1000,
+        "p99": percentile(latencies, 99) * 1000,
+        "max": (latencies[-1] if latencies else 0.0) * 1000,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--clients", type=int, default=4, help="concurrent clients per route")
+    parser.add_argument("--duration", type=float, default=3.0, help="seconds per route")
+    parser.add_argument("--route", action="append", metavar="[METHOD ]PATH",
+                        help="route to test, repeatable (default: all the web UI ones)")
+    parser.add_argument("--json", action="store_true", help="print the results as JSON")
+    args = parser.parse_args()
+
+    routes = ROUTES
+    if args.route:
+        routes = [tuple(r.split(None, 1)) if " " in r else ("GET", r) for r in args.route]
+
+    form = None
+    request(args.host, args.port, "GET", "/_hostsim/stats?reset=1")
+    results = {}
+    for method, path in routes:
+        body = None
+        if method == "POST":
+            form = form or config_form(args.host, args.port)
+            body = form
+        results[path] = run_route(args, method, path, body)
+
+    _, data = request(args.host, args.port, "GET", "/_hostsim/stats")
+    stats = json.loads(data.decode())
+    for path, r in results.items():
+        s = stats["routes"].get(path, {})
+        r["handler_us"] = s.get("us_avg", 0)
+        r["heap_peak"] = s.get("heap_peak", 0)
+        r["alloc_failed"] = s.get("alloc_failed", 0)
+
+    if args.json:
+        print(json.dumps({"heap": stats["heap"], "routes": results}, indent=2))
+        return
+
+    print("%d clients, %.1fs per route, %d bytes of heap" % (args.clients, args.duration, stats["heap"]))
+    print("%-20s %8s %8s %8s %8s %8s %6s %9s %9s %6s" % ("route", "req/s", "p50 ms", "p95 ms", "p99 ms",
+                                                         "max ms", "errors", "handler", "heap peak", "nomem"))
+    for path, r in results.items():
+        print("%-20s %8.0f %8.2f %8.2f %8.2f %8.2f %6d %7dus %9d %6d" % (
+            path, r["rps"], r["p50"], r["p95"], r["p99"], r["max"], r["errors"],
+            r["handler_us"], r["heap_peak"], r["alloc_failed"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,480 @@
+// Arduino core: String, Print, timing, GPIO and the ESP object
+#include <Arduino.h>
+#include <user_interface.h>
+#include <chrono>
+#include <thread>
+#include "hostsim.h"
+
+EspClass ESP;
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+UpdaterClass Update;
+
+/* ----------------------------------------------------------------------
+   String, buffers grow to the exact size like the core 2.x WString
+   ---------------------------------------------------------------------- */
+String::String(const char * s) : buf(NULL), len(0), cap(0)
+{
+  *this = s;
+}
+
+String::String(const String & s) : buf(NULL), len(0), cap(0)
+{
+  *this = s;
+}
+
+String::String(const __FlashStringHelper * s) : buf(NULL), len(0), cap(0)
+{
+  *this = (const char *) s;
+}
+
+String::String(char c) : buf(NULL), len(0), cap(0)
+{
+  concat(&c, 1);
+}
+
+static const char * hostsimItoa(char * s, unsigned long v, bool neg, unsigned char base)
+{
+  char * p = s + 33;
+  *p = 0;
+  do
+  {
+    unsigned d = v % base;
+    *--p = d < 10 ? '0' + d : 'a' + d - 10;
+    v /= base;
+  } while (v);
+  if (neg)
+    *--p = '-';
+  return p;
+}
+
+String::String(unsigned char v, unsigned char base) : String((unsigned long) v, base) {}
+String::String(int v, unsigned char base) : String((long) v, base) {}
+String::String(unsigned int v, unsigned char base) : String((unsigned long) v, base) {}
+
+String::String(long v, unsigned char base) : buf(NULL), len(0), cap(0)
+{
+  char s[34];
+  if (base == 10 && v < 0)
+    *this = hostsimItoa(s, -(unsigned long) v, true, base);
+  else
+    *this = hostsimItoa(s, (unsigned long) v, false, base);
+}
+
+String::String(unsigned long v, unsigned char base) : buf(NULL), len(0), cap(0)
+{
+  char s[34];
+  *this = hostsimItoa(s, v, false, base);
+}
+
+String::String(float v, unsigned char decimals) : String((double) v, decimals) {}
+
+String::String(double v, unsigned char decimals) : buf(NULL), len(0), cap(0)
+{
+  char s[33];
+  *this = dtostrf(v, decimals + 2, decimals, s);
+}
+
+String::~String()
+{
+  hostsimFree(buf);
+}
+
+bool String::invalidate(void)
+{
+  hostsimFree(buf);
+  buf = NULL;
+  len = cap = 0;
+  return false;
+}
+
+bool String::reserve(unsigned int size)
+{
+  if (buf && cap >= size)
+    return true;
+  char * p = (char *) hostsimRealloc(buf, size + 1);
+  if (!p)
+    return false;
+  if (!buf)
+    *p = 0;
+  buf = p;
+  cap = size;
+  return true;
+}
+
+String & String::operator=(const String & s)
+{
+  if (this != &s)
+    *this = s.c_str();
+  return *this;
+}
+
+String & String::operator=(const char * s)
+{
+  size_t n = s ? strlen(s) : 0;
+  if (!reserve(n))
+    invalidate();
+  else
+  {
+    memmove(buf, s ? s : "", n + 1);
+    len = n;
+  }
+  return *this;
+}
+
+String & String::operator=(const __FlashStringHelper * s)
+{
+  return *this = (const char *) s;
+}
+
+bool String::concat(const char * s, unsigned int n)
+{
+  if (!n)
+    return true;
+  if (!reserve(len + n))
+    return false;
+  memmove(buf + len, s, n);
+  len += n;
+  buf[len] = 0;
+  return true;
+}
+
+String & String::operator+=(const String & s) { concat(s.c_str(), s.len); return *this; }
+String & String::operator+=(const char * s) { concat(s, strlen(s)); return *this; }
+String & String::operator+=(const __FlashStringHelper * s) { return *this += (const char *) s; }
+String & String::operator+=(char c) { concat(&c, 1); return *this; }
+String & String::operator+=(unsigned char v) { return *this += (unsigned long) v; }
+String & String::operator+=(int v) { return *this += (long) v; }
+String & String::operator+=(unsigned int v) { return *this += (unsigned long) v; }
+String & String::operator+=(float v) { return *this += (double) v; }
+
+String & String::operator+=(long v)
+{
+  char s[34];
+  return *this += v < 0 ? hostsimItoa(s, -(unsigned long) v, true, 10) : hostsimItoa(s, v, false, 10);
+}
+
+String & String::operator+=(unsigned long v)
+{
+  char s[34];
+  return *this += hostsimItoa(s, v, false, 10);
+}
+
+String & String::operator+=(double v)
+{
+  char s[33];
+  return *this += dtostrf(v, 4, 2, s);
+}
+
+String operator+(const String & a, const String & b) { String r(a); r += b; return r; }
+String operator+(const String & a, const char * b) { String r(a); r += b; return r; }
+String operator+(const String & a, const __FlashStringHelper * b) { String r(a); r += b; return r; }
+String operator+(const char * a, const String & b) { String r(a); r += b; return r; }
+String operator+(const String & a, char b) { String r(a); r += b; return r; }
+
+bool String::equals(const String & s) const
+{
+  return len == s.len && !strcmp(c_str(), s.c_str());
+}
+
+bool String::startsWith(const String & s) const
+{
+  return len >= s.len && !strncmp(c_str(), s.c_str(), s.len);
+}
+
+bool String::endsWith(const String & s) const
+{
+  return len >= s.len && !strcmp(c_str() + len - s.len, s.c_str());
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  if (from >= len)
+    return -1;
+  const char * p = strchr(buf + from, c);
+  return p ? p - buf : -1;
+}
+
+int String::indexOf(const String & s, unsigned int from) const
+{
+  if (from >= len)
+    return -1;
+  const char * p = strstr(buf + from, s.c_str());
+  return p ? p - buf : -1;
+}
+
+String String::substring(unsigned int from) const
+{
+  return substring(from, len);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  String r;
+  if (from > to)
+  {
+    unsigned int t = from;
+    from = to;
+    to = t;
+  }
+  if (to > len)
+    to = len;
+  if (from < to)
+    r.concat(buf + from, to - from);
+  return r;
+}
+
+void String::trim()
+{
+  if (!len)
+    return;
+  unsigned int b = 0, e = len;
+  while (b < e && isspace((unsigned char) buf[b]))
+    b++;
+  while (e > b && isspace((unsigned char) buf[e - 1]))
+    e--;
+  len = e - b;
+  memmove(buf, buf + b, len);
+  buf[len] = 0;
+}
+
+void String::toLowerCase()
+{
+  for (unsigned int i = 0; i < len; i++)
+    buf[i] = tolower((unsigned char) buf[i]);
+}
+
+/* ----------------------------------------------------------------------
+   Print and Stream
+   ---------------------------------------------------------------------- */
+size_t Print::write(const uint8_t * b, size_t n)
+{
+  size_t r = 0;
+  while (n--)
+    r += write(*b++);
+  return r;
+}
+
+static size_t printVf(Print & p, const char * fmt, va_list ap)
+{
+  char s[256];
+  int n = vsnprintf(s, sizeof(s), fmt, ap);
+  if (n < 0)
+    return 0;
+  return p.write((const uint8_t *) s, (size_t) n < sizeof(s) ? n : sizeof(s) - 1);
+}
+
+size_t Print::printf(const char * fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  size_t r = printVf(*this, fmt, ap);
+  va_end(ap);
+  return r;
+}
+
+size_t Print::printf_P(const char * fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  size_t r = printVf(*this, fmt, ap);
+  va_end(ap);
+  return r;
+}
+
+size_t Print::print(long v, int base)
+{
+  char s[34];
+  return write(base == 10 && v < 0 ? hostsimItoa(s, -(unsigned long) v, true, 10) : hostsimItoa(s, v, false, base));
+}
+
+size_t Print::print(unsigned long v, int base)
+{
+  char s[34];
+  return write(hostsimItoa(s, v, false, base));
+}
+
+size_t Print::print(double v, int decimals)
+{
+  char s[33];
+  return write(dtostrf(v, 1, decimals, s));
+}
+
+size_t Stream::readBytes(uint8_t * b, size_t n)
+{
+  size_t r = 0;
+  unsigned long start = millis();
+  while (r < n && millis() - start < timeout)
+  {
+    int c = read();
+    if (c < 0)
+    {
+      if (!available())
+        break;
+      continue;
+    }
+    b[r++] = c;
+  }
+  return r;
+}
+
+String Stream::readStringUntil(char end)
+{
+  String r;
+  int c;
+  while ((c = read()) >= 0 && c != end)
+    r += (char) c;
+  return r;
+}
+
+size_t HardwareSerial::write(const uint8_t * b, size_t n)
+{
+  if (!_uart)
+    hostsimConsole((const char *) b, n);
+  return n;
+}
+
+size_t UpdaterClass::writeStream(Stream & s)
+{
+  size_t n = 0;
+  while (s.read() >= 0)
+    n++;
+  _size += n;
+  return n;
+}
+
+String UpdaterClass::md5String()
+{
+  return F("00000000000000000000000000000000");
+}
+
+/* ----------------------------------------------------------------------
+   Timing and GPIO. The TPL5111 DONE pin cuts nothing, the firmware goes
+   on to config mode as when the board stays powered
+   ---------------------------------------------------------------------- */
+uint64_t hostsimMicros(void)
+{
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long millis(void) { return hostsimMicros() / 1000; }
+unsigned long micros(void) { return hostsimMicros(); }
+void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+void yield(void) { hostsimUartService(); }
+extern "C" void esp_yield(void) { yield(); }
+extern "C" void esp_schedule(void) {}
+
+void delay(unsigned long ms)
+{
+  hostsimUartService();
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static uint8_t gpio[17] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };  // Pulled up, a timer wake
+
+int digitalRead(uint8_t pin) { return pin < sizeof(gpio) ? gpio[pin] : 0; }
+void pinMode(uint8_t pin, uint8_t mode) {}
+int analogRead(uint8_t pin) { return pin == A0 ? hostsim.adc : 0; }
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < sizeof(gpio))
+    gpio[pin] = value;
+}
+
+char * dtostrf(double value, signed char width, unsigned char prec, char * s)
+{
+  sprintf(s, "%*.*f", width, prec, value);
+  return s;
+}
+
+char * utoa(unsigned value, char * s, int radix)
+{
+  char b[34];
+  return strcpy(s, hostsimItoa(b, value, false, radix));
+}
+
+char * ltoa(long value, char * s, int radix)
+{
+  char b[34];
+  return strcpy(s, radix == 10 && value < 0 ? hostsimItoa(b, -(unsigned long) value, true, 10)
+                                           : hostsimItoa(b, value, false, radix));
+}
+
+/* ----------------------------------------------------------------------
+   ESP and SDK, a cold power on
+   ---------------------------------------------------------------------- */
+static struct rst_info resetInfo = { REASON_DEFAULT_RST, 0, 0, 0, 0, 0, 0 };
+static uint32_t rtcMem[128];
+
+uint32_t EspClass::getChipId(void) { return 0x00C0FFEE; }
+uint32_t EspClass::getFreeSketchSpace(void) { return 0x80000; }
+uint32_t EspClass::getSketchSize(void) { return 0x60000; }
+uint32_t EspClass::getFlashChipRealSize(void) { return 0x400000; }
+void EspClass::eraseConfig(void) {}
+uint64_t EspClass::deepSleepMax(void) { return 3 * 3600 * 1000000ULL; }
+uint32_t EspClass::getCycleCount(void) { return hostsimMicros() * 80; }
+uint32_t EspClass::getFreeHeap(void) { return hostsim.heap - hostsimHeapUsed(); }
+uint32_t EspClass::getMaxFreeBlockSize(void) { return getFreeHeap(); }
+uint8_t EspClass::getCpuFreqMHz(void) { return 80; }
+String EspClass::getSketchMD5(void) { return F("00000000000000000000000000000000"); }
+String EspClass::getResetReason(void) { return F("Power on"); }
+String EspClass::getResetInfo(void) { return F("Power on"); }
+bool EspClass::flashEraseSector(uint32_t sector) { return false; }
+bool EspClass::flashWrite(uint32_t offset, uint32_t * data, size_t size) { return false; }
+bool EspClass::flashRead(uint32_t offset, uint32_t * data, size_t size) { return false; }
+// Linker script symbol, the EEPROM flash sector. Flash reads fail: the
+// wake journal is never used, the state always committed
+extern "C" { uint32_t _EEPROM_start; }
+struct rst_info * EspClass::getResetInfoPtr(void) { return &resetInfo; }
+
+void EspClass::restart(void)
+{
+  hostsimUartService();
+  printf("hostsim: restart, exiting\n");
+  exit(0);
+}
+
+void EspClass::deepSleep(uint64_t us, RFMode mode)
+{
+  hostsimUartService();
+  printf("hostsim: deep sleep for %llus, exiting\n", (unsigned long long) (us / 1000000));
+  exit(0);
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t * data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMem))
+    return false;
+  memcpy(data, (uint8_t *) rtcMem + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t * data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMem))
+    return false;
+  memcpy((uint8_t *) rtcMem + offset * 4, data, size);
+  return true;
+}
+
+bool system_update_cpu_freq(uint8_t freq) { return true; }
+const char * system_get_sdk_version(void) { return "hostsim"; }
+uint32_t system_get_chip_id(void) { return ESP.getChipId(); }
+uint8_t system_get_boot_version(void) { return 0; }
+uint32_t system_get_free_heap_size(void) { return ESP.getFreeHeap(); }
+uint32_t system_get_time(void) { return hostsimMicros(); }
+bool wifi_set_channel(uint8_t channel) { return true; }
+void system_phy_set_max_tpw(uint8_t power) {}
+struct rst_info * system_get_rst_info(void) { return &resetInfo; }
+
+bool system_rtc_mem_read(uint8_t addr, void * dst, uint16_t size)
+{
+  return ESP.rtcUserMemoryRead(addr, (uint32_t *) dst, size);
+}
+
+bool system_rtc_mem_write(uint8_t addr, const void * src, uint16_t size)
+{
+  return ESP.rtcUserMemoryWrite(addr, (uint32_t *) src, size);
+}
@@ -0,0 +1,32 @@
+// EEPROM image file, a missing one reads as an erased flash
+#include <EEPROM.h>
+#include "hostsim.h"
+
+EEPROMClass EEPROM;
+
+void EEPROMClass::begin(size_t size)
+{
+  _data.assign(size, 0xFF);
+  FILE * f = fopen(hostsim.eeprom.c_str(), "rb");
+  if (f)
+  {
+    size_t n = fread(_data.data(), 1, size, f);
+    (void) n;
+    fclose(f);
+  }
+}
+
+bool EEPROMClass::commit(void)
+{
+  FILE * f = fopen(hostsim.eeprom.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(_data.data(), 1, _data.size(), f) == _data.size();
+  return fclose(f) == 0 && ok;
+}
+
+void EEPROMClass::end(void)
+{
+  commit();
+  _data.clear();
+}
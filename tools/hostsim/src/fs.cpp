@@ -0,0 +1,288 @@
+// SPIFFS over the data directory with a writable overlay
+#include <FS.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include "hostsim.h"
+
+#define SPIFFS_TOTAL 957314         // 1MB SPIFFS of a 4MB flash
+#define SPIFFS_BLOCK 8192
+#define SPIFFS_PAGE  256
+#define SPIFFS_NAME  32             // Longest path, terminator included
+
+fs::FS SPIFFS;
+
+namespace fs {
+
+struct FileImpl
+{
+  FILE * f;
+  std::string name;
+  ~FileImpl() { if (f) fclose(f); }
+};
+
+struct DirImpl
+{
+  std::vector<std::string> names;
+  size_t next;
+};
+
+}
+
+static bool mounted;
+static std::set<std::string> removed;   // Data files removed, not in the overlay
+
+static std::string dataPath(const char * name) { return hostsim.data + name; }
+static std::string overlayPath(const char * name) { return hostsim.overlay + name; }
+
+static bool isFile(const std::string & path)
+{
+  struct stat st;
+  return !stat(path.c_str(), &st) && S_ISREG(st.st_mode);
+}
+
+static bool makeParents(const std::string & path)
+{
+  for (size_t i = hostsim.overlay.size() + 1; (i = path.find('/', i)) != std::string::npos; i++)
+    if (mkdir(path.substr(0, i).c_str(), 0755) && errno != EEXIST)
+      return false;
+  return true;
+}
+
+// Where a file is read from, empty if it does not exist
+static std::string filePath(const char * name)
+{
+  std::string p = overlayPath(name);
+  if (isFile(p))
+    return p;
+  p = dataPath(name);
+  if (!removed.count(name) && isFile(p))
+    return p;
+  return std::string();
+}
+
+static void listFiles(const std::string & root, const std::string & dir, std::set<std::string> & names)
+{
+  DIR * d = opendir((root + dir).c_str());
+  if (!d)
+    return;
+  while (struct dirent * e = readdir(d))
+  {
+    if (e->d_name[0] == '.')
+      continue;
+    std::string name = dir + "/" + e->d_name;
+    if (isFile(root + name))
+      names.insert(name);
+    else
+      listFiles(root, name, names);
+  }
+  closedir(d);
+}
+
+static std::set<std::string> allFiles(void)
+{
+  std::set<std::string> names;
+  listFiles(hostsim.data, "", names);
+  for (const std::string & r : removed)
+    names.erase(r);
+  listFiles(hostsim.overlay, "", names);
+  return names;
+}
+
+namespace fs {
+
+/* ----------------------------------------------------------------------
+   File
+   ---------------------------------------------------------------------- */
+size_t File::write(uint8_t c) { return write(&c, 1); }
+size_t File::write(const uint8_t * b, size_t n) { return _p ? fwrite(b, 1, n, _p->f) : 0; }
+int File::available() { return _p ? size() - position() : 0; }
+int File::read() { return _p ? fgetc(_p->f) : -1; }
+size_t File::read(uint8_t * b, size_t n) { return _p ? fread(b, 1, n, _p->f) : 0; }
+void File::flush() { if (_p) fflush(_p->f); }
+size_t File::position() const { return _p ? ftell(_p->f) : 0; }
+void File::close() { _p.reset(); }
+File::operator bool() const { return _p != nullptr; }
+const char * File::name() const { return _p ? _p->name.c_str() : ""; }
+
+int File::peek()
+{
+  if (!_p)
+    return -1;
+  int c = fgetc(_p->f);
+  if (c >= 0)
+    ungetc(c, _p->f);
+  return c;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  return _p && !fseek(_p->f, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END);
+}
+
+size_t File::size() const
+{
+  if (!_p)
+    return 0;
+  struct stat st;
+  fflush(_p->f);
+  return fstat(fileno(_p->f), &st) ? 0 : st.st_size;
+}
+
+bool File::truncate(uint32_t size)
+{
+  return _p && !fflush(_p->f) && !ftruncate(fileno(_p->f), size);
+}
+
+/* ----------------------------------------------------------------------
+   Dir, SPIFFS has no directories: all names under the prefix
+   ---------------------------------------------------------------------- */
+bool Dir::next()
+{
+  return _p && ++_p->next <= _p->names.size();
+}
+
+String Dir::fileName()
+{
+  return _p && _p->next && _p->next <= _p->names.size() ? String(_p->names[_p->next - 1].c_str()) : String();
+}
+
+size_t Dir::fileSize()
+{
+  File f = openFile("r");
+  return f.size();
+}
+
+File Dir::openFile(const char * mode)
+{
+  return SPIFFS.open(fileName(), mode);
+}
+
+/* ----------------------------------------------------------------------
+   FS
+   ---------------------------------------------------------------------- */
+bool FS::begin()
+{
+  struct stat st;
+  mounted = !stat(hostsim.data.c_str(), &st) && S_ISDIR(st.st_mode) &&
+            (!mkdir(hostsim.overlay.c_str(), 0755) || errno == EEXIST);
+  return mounted;
+}
+
+void FS::end()
+{
+  mounted = false;
+}
+
+bool FS::info(FSInfo & info)
+{
+  info.totalBytes = SPIFFS_TOTAL;
+  info.usedBytes = 0;
+  for (const std::string & n : allFiles())
+  {
+    struct stat st;
+    if (!stat(filePath(n.c_str()).c_str(), &st))
+      info.usedBytes += (st.st_size + SPIFFS_PAGE - 1) / SPIFFS_PAGE * SPIFFS_PAGE;
+  }
+  info.blockSize = SPIFFS_BLOCK;
+  info.pageSize = SPIFFS_PAGE;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = SPIFFS_NAME;
+  return mounted;
+}
+
+File FS::open(const char * path, const char * mode)
+{
+  if (!mounted || *path != '/' || strlen(path) >= SPIFFS_NAME)
+    return File();
+
+  std::string from = filePath(path);
+  std::string p = from;
+  if (*mode != 'r' || mode[1] == '+')
+  {
+    // Written files move to the overlay
+    p = overlayPath(path);
+    if (!makeParents(p))
+      return File();
+    if (*mode != 'w' && !from.empty() && from != p)
+    {
+      FILE * in = fopen(from.c_str(), "rb");
+      FILE * out = fopen(p.c_str(), "wb");
+      char b[1024];
+      size_t n;
+      while (in && out && (n = fread(b, 1, sizeof(b), in)) > 0)
+        fwrite(b, 1, n, out);
+      if (in)
+        fclose(in);
+      if (out)
+        fclose(out);
+    }
+    removed.erase(path);
+  }
+  else if (p.empty())
+    return File();
+
+  std::string m = std::string(mode) + "b";
+  FILE * f = fopen(p.c_str(), m.c_str());
+  if (!f)
+    return File();
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->f = f;
+  impl->name = path;
+  return File(impl);
+}
+
+bool FS::exists(const char * path)
+{
+  return mounted && !filePath(path).empty();
+}
+
+Dir FS::openDir(const char * path)
+{
+  std::shared_ptr<DirImpl> impl = std::make_shared<DirImpl>();
+  std::string prefix(path);
+  impl->next = 0;
+  if (mounted)
+    for (const std::string & n : allFiles())
+      if (!n.compare(0, prefix.size(), prefix))
+        impl->names.push_back(n);
+  return Dir(impl);
+}
+
+bool FS::remove(const char * path)
+{
+  if (!exists(path))
+    return false;
+  ::remove(overlayPath(path).c_str());
+  if (isFile(dataPath(path)))
+    removed.insert(path);
+  return true;
+}
+
+bool FS::rename(const char * from, const char * to)
+{
+  File in = open(from, "r");
+  File out = in ? open(to, "w") : File();
+  if (!out)
+    return false;
+  uint8_t b[1024];
+  size_t n;
+  while ((n = in.read(b, sizeof(b))) > 0)
+    out.write(b, n);
+  in.close();
+  out.close();
+  return remove(from);
+}
+
+bool FS::format()
+{
+  for (const std::string & n : allFiles())
+    remove(n.c_str());
+  return mounted;
+}
+
+}
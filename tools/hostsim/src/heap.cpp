@@ -0,0 +1,69 @@
+// Simulated heap accounting, each block carries its size
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+
+#define HEAP_BLOCK_OVERHEAD 8       // umm_malloc block header
+
+static size_t heapUsed;
+static size_t heapPeak;
+static uint32_t heapFailed;
+
+static size_t heapCost(size_t size)
+{
+  return (size + HEAP_BLOCK_OVERHEAD + 7) & ~(size_t) 7;
+}
+
+void * hostsimAlloc(size_t size)
+{
+  return hostsimRealloc(NULL, size);
+}
+
+void * hostsimRealloc(void * p, size_t size)
+{
+  size_t old = p ? ((size_t *) p)[-1] : 0;
+
+  if (heapUsed - (p ? heapCost(old) : 0) + heapCost(size) > hostsim.heap)
+  {
+    heapFailed++;
+    return NULL;
+  }
+  size_t * b = (size_t *) realloc(p ? (size_t *) p - 1 : NULL, sizeof(size_t) + size);
+  if (!b)
+    return NULL;
+  if (p)
+    heapUsed -= heapCost(old);
+  heapUsed += heapCost(size);
+  if (heapUsed > heapPeak)
+    heapPeak = heapUsed;
+  *b = size;
+  return b + 1;
+}
+
+void hostsimFree(void * p)
+{
+  if (!p)
+    return;
+  heapUsed -= heapCost(((size_t *) p)[-1]);
+  free((size_t *) p - 1);
+}
+
+size_t hostsimHeapUsed(void)
+{
+  return heapUsed;
+}
+
+size_t hostsimHeapPeak(void)
+{
+  return heapPeak;
+}
+
+void hostsimHeapPeakReset(void)
+{
+  heapPeak = heapUsed;
+}
+
+uint32_t hostsimHeapFailed(void)
+{
+  return heapFailed;
+}
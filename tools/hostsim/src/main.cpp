@@ -0,0 +1,87 @@
+// Runs the firmware setup() and loop() on the host, see README.md
+#include <Arduino.h>
+#include <getopt.h>
+#include <signal.h>
+#include "hostsim.h"
+
+#ifndef HOSTSIM_DATA
+#define HOSTSIM_DATA "data"
+#endif
+
+HostsimOptions hostsim =
+{
+  8080,                             // port
+  HOSTSIM_DATA,                     // data
+  "hostsim-spiffs",                 // overlay
+  "hostsim-eeprom.bin",             // eeprom
+  40 * 1024,                        // heap, free in config mode on the board
+  680,                              // adc, about 3.8V with the default calibration
+  false,                            // quiet
+};
+
+void setup(void);
+void loop(void);
+
+static void usage(const char * name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --port N      listen on N for the board port 80 (%d)\n"
+          "  --data DIR    SPIFFS files (%s)\n"
+          "  --spiffs DIR  SPIFFS writes (%s)\n"
+          "  --eeprom FILE EEPROM image, created on first save (%s)\n"
+          "  --heap BYTES  heap left to the firmware (%u)\n"
+          "  --adc N       A0 reading (%d)\n"
+          "  --quiet       no firmware log\n",
+          name, hostsim.port, hostsim.data.c_str(), hostsim.overlay.c_str(), hostsim.eeprom.c_str(),
+          (unsigned) hostsim.heap, hostsim.adc);
+  exit(2);
+}
+
+static void onSignal(int sig)
+{
+  exit(0);
+}
+
+int main(int argc, char ** argv)
+{
+  static const struct option options[] =
+  {
+    { "port",   required_argument, NULL, 'p' },
+    { "data",   required_argument, NULL, 'd' },
+    { "spiffs", required_argument, NULL, 's' },
+    { "eeprom", required_argument, NULL, 'e' },
+    { "heap",   required_argument, NULL, 'h' },
+    { "adc",    required_argument, NULL, 'a' },
+    { "quiet",  no_argument,       NULL, 'q' },
+    { NULL, 0, NULL, 0 }
+  };
+  int c;
+
+  while ((c = getopt_long(argc, argv, "", options, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 'p': hostsim.port = atoi(optarg); break;
+      case 'd': hostsim.data = optarg; break;
+      case 's': hostsim.overlay = optarg; break;
+      case 'e': hostsim.eeprom = optarg; break;
+      case 'h': hostsim.heap = strtoul(optarg, NULL, 0); break;
+      case 'a': hostsim.adc = atoi(optarg); break;
+      case 'q': hostsim.quiet = true; break;
+      default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage(argv[0]);
+  while (!hostsim.data.empty() && hostsim.data.back() == '/')
+    hostsim.data.pop_back();
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+  setup();
+  for (;;)
+    loop();
+}
@@ -0,0 +1,227 @@
+// WiFi, OTA and crypto mocks
+#include <ESP8266WiFi.h>
+#include <ArduinoOTA.h>
+#include <bearssl/bearssl.h>
+
+ESP8266WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+
+struct br_hash_class_ {};
+const br_hash_class br_sha256_vtable = {};
+
+static const struct
+{
+  const char * ssid;
+  int32_t rssi;
+  int32_t channel;
+} scanList[] =
+{
+  { "hostsim", -48, 6 },
+  { "Livebox-1F2E", -67, 1 },
+  { "FreeWifi", -71, 11 },
+  { "SFR_4A10", -83, 6 },
+};
+#define SCAN_COUNT ((int8_t) (sizeof(scanList) / sizeof(scanList[0])))
+
+/* ----------------------------------------------------------------------
+   IPAddress
+   ---------------------------------------------------------------------- */
+bool IPAddress::fromString(const char * s)
+{
+  unsigned a, b, c, d;
+  char end;
+  if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255)
+    return false;
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+String IPAddress::toString() const
+{
+  char s[16];
+  sprintf(s, "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(s);
+}
+
+/* ----------------------------------------------------------------------
+   WiFi
+   ---------------------------------------------------------------------- */
+bool ESP8266WiFiClass::config(IPAddress ip, IPAddress gw, IPAddress mask, IPAddress dns)
+{
+  _ip = ip;
+  _gw = gw;
+  _dns = dns;
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char * ssid, const char * psk, int32_t channel, const uint8_t * bssid, bool connect)
+{
+  _ssid = ssid ? ssid : "";
+  _psk = psk ? psk : "";
+  if (channel)
+    _channel = channel;
+  if (bssid)
+    memcpy(_bssid, bssid, sizeof(_bssid));
+  if (_ssid.empty())
+  {
+    _status = WL_NO_SSID_AVAIL;
+    return _status;
+  }
+
+  _status = WL_CONNECTED;
+  if (!_ip.isSet())
+  {
+    _ip = IPAddress(127, 0, 0, 1);
+    _gw = _dns = IPAddress(127, 0, 0, 1);
+  }
+  if (_connected)
+  {
+    WiFiEventStationModeConnected e;
+    e.ssid = SSID();
+    memcpy(e.bssid, _bssid, sizeof(e.bssid));
+    e.channel = _channel;
+    _connected(e);
+  }
+  if (_gotIP)
+  {
+    WiFiEventStationModeGotIP e;
+    e.ip = _ip;
+    e.mask = IPAddress(255, 0, 0, 0);
+    e.gw = _gw;
+    _gotIP(e);
+  }
+  return _status;
+}
+
+bool ESP8266WiFiClass::disconnect(bool off)
+{
+  if (_status == WL_CONNECTED && _disconnected)
+  {
+    WiFiEventStationModeDisconnected e;
+    e.ssid = SSID();
+    memcpy(e.bssid, _bssid, sizeof(e.bssid));
+    e.reason = 8;  // Association leave
+    _disconnected(e);
+  }
+  _status = WL_DISCONNECTED;
+  return true;
+}
+
+String ESP8266WiFiClass::macAddress()
+{
+  return F("5C:CF:7F:C0:FF:EE");
+}
+
+uint8_t * ESP8266WiFiClass::macAddress(uint8_t * mac)
+{
+  static const uint8_t m[6] = { 0x5C, 0xCF, 0x7F, 0xC0, 0xFF, 0xEE };
+  memcpy(mac, m, sizeof(m));
+  return mac;
+}
+
+String ESP8266WiFiClass::softAPmacAddress()
+{
+  return F("5E:CF:7F:C0:FF:EE");
+}
+
+String ESP8266WiFiClass::SSID(uint8_t i)
+{
+  return String(i < SCAN_COUNT ? scanList[i].ssid : "");
+}
+
+int32_t ESP8266WiFiClass::RSSI(uint8_t i)
+{
+  return i < SCAN_COUNT ? scanList[i].rssi : 0;
+}
+
+int32_t ESP8266WiFiClass::channel(uint8_t i)
+{
+  return i < SCAN_COUNT ? scanList[i].channel : 0;
+}
+
+uint8_t * ESP8266WiFiClass::BSSID(uint8_t i)
+{
+  static uint8_t bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 };
+  bssid[5] = i;
+  return bssid;
+}
+
+void ESP8266WiFiClass::printDiag(Print & p)
+{
+  p.printf("Mode: %s\nChannel: %d\nSSID (%u): %s\nPassphrase (%u): %s\n",
+           _mode == WIFI_AP ? "AP" : _mode == WIFI_AP_STA ? "STA+AP" : "STA", _channel,
+           (unsigned) _ssid.size(), _ssid.c_str(), (unsigned) _psk.size(), _psk.c_str());
+}
+
+int8_t ESP8266WiFiClass::scanNetworks(bool async, bool hidden)
+{
+  _scanned = true;
+  return SCAN_COUNT;
+}
+
+int8_t ESP8266WiFiClass::scanComplete()
+{
+  return _scanned ? SCAN_COUNT : WIFI_SCAN_FAILED;
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> fn)
+{
+  _gotIP = fn;
+  return std::make_shared<WiFiEventHandlerOpaque>();
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeDisconnected(std::function<void(const WiFiEventStationModeDisconnected &)> fn)
+{
+  _disconnected = fn;
+  return std::make_shared<WiFiEventHandlerOpaque>();
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeConnected(std::function<void(const WiFiEventStationModeConnected &)> fn)
+{
+  _connected = fn;
+  return std::make_shared<WiFiEventHandlerOpaque>();
+}
+
+/* ----------------------------------------------------------------------
+   HMAC: a keyed checksum with the right sizes, not SHA256. Signed reports
+   can not be checked against a real server anyway
+   ---------------------------------------------------------------------- */
+struct HmacState
+{
+  uint64_t h[4];
+};
+
+static void hmacMix(HmacState & s, const uint8_t * b, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    uint64_t & h = s.h[i & 3];
+    h = (h ^ b[i]) * 0x100000001B3ULL;
+  }
+}
+
+void br_hmac_key_init(br_hmac_key_context * kc, const br_hash_class * dig, const void * key, size_t len)
+{
+  HmacState s = { { 0xCBF29CE484222325ULL, 1, 2, 3 } };
+  hmacMix(s, (const uint8_t *) key, len);
+  memcpy(kc->b, &s, sizeof(s));
+}
+
+void br_hmac_init(br_hmac_context * ctx, const br_hmac_key_context * kc, size_t out_len)
+{
+  memcpy(ctx->b, kc->b, sizeof(HmacState));
+}
+
+void br_hmac_update(br_hmac_context * ctx, const void * data, size_t len)
+{
+  HmacState s;
+  memcpy(&s, ctx->b, sizeof(s));
+  hmacMix(s, (const uint8_t *) data, len);
+  memcpy(ctx->b, &s, sizeof(s));
+}
+
+size_t br_hmac_out(const br_hmac_context * ctx, void * out)
+{
+  memcpy(out, ctx->b, br_sha256_SIZE);
+  return br_sha256_SIZE;
+}
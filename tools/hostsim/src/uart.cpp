@@ -0,0 +1,61 @@
+// UART0 for log.cpp: the FIFO never fills, the TX interrupt handler runs
+// as long as it keeps the FIFO empty interrupt enabled
+#include <Arduino.h>
+#include <esp8266_peri.h>
+#include <ets_sys.h>
+#include <unistd.h>
+#include "hostsim.h"
+
+HostsimUartFifo hostsimUartFifo;
+volatile uint32_t hostsimUartRegs[0x10];
+
+static int_handler_t uartIsr;
+static void * uartIsrArg;
+static bool uartUnmasked;
+
+HostsimUartFifo & HostsimUartFifo::operator=(uint32_t c)
+{
+  char b = c;
+  hostsimConsole(&b, 1);
+  return *this;
+}
+
+void hostsimConsole(const char * s, size_t n)
+{
+  if (!hostsim.quiet)
+    fwrite(s, 1, n, stdout);
+}
+
+void hostsimUartService(void)
+{
+  while (uartIsr && uartUnmasked && (USIE(0) & (1 << UIFE)))
+  {
+    USIS(0) = USIE(0);
+    uartIsr(uartIsrArg);
+  }
+  fflush(stdout);
+}
+
+void ets_isr_attach(int num, int_handler_t fn, void * arg)
+{
+  if (num == ETS_UART_INUM)
+  {
+    uartIsr = fn;
+    uartIsrArg = arg;
+  }
+}
+
+void ets_isr_mask(uint32_t mask)
+{
+  if (mask & (1 << ETS_UART_INUM))
+    uartUnmasked = false;
+}
+
+void ets_isr_unmask(uint32_t mask)
+{
+  if (mask & (1 << ETS_UART_INUM))
+  {
+    uartUnmasked = true;
+    hostsimUartService();
+  }
+}
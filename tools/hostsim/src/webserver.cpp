@@ -0,0 +1,598 @@
+// ESP8266WebServer over POSIX sockets, one connection at a time
+#include <ESP8266WebServer.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <map>
+#include "hostsim.h"
+
+#define HTTP_MAX_HEADER 4096        // Request line and headers
+#define HTTP_MAX_BODY   (2 << 20)   // Firmware images fit
+#define HTTP_TIMEOUT    2           // s, request receive timeout
+#define STATS_URI       "/_hostsim/stats"
+
+// Per route statistics for the load test
+struct RouteStats
+{
+  uint32_t count;
+  uint64_t us;                      // Handler time
+  uint32_t us_max;
+  size_t heap_max;                  // Heap peak above the level before the request
+  size_t bytes;                     // Response bytes
+  uint32_t failed;                  // Allocations refused during the handler
+  uint32_t unanswered;              // Handler sent nothing
+};
+static std::map<std::string, RouteStats> routeStats;
+static size_t responseBytes;
+
+static const char * statusText(int code)
+{
+  switch (code)
+  {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    default:  return "";
+  }
+}
+
+static std::string urlDecode(const std::string & s)
+{
+  std::string r;
+  for (size_t i = 0; i < s.size(); i++)
+  {
+    if (s[i] == '+')
+      r += ' ';
+    else if (s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char) s[i + 1]) && isxdigit((unsigned char) s[i + 2]))
+    {
+      r += (char) strtol(s.substr(i + 1, 2).c_str(), NULL, 16);
+      i += 2;
+    }
+    else
+      r += s[i];
+  }
+  return r;
+}
+
+// Value of a header, lowercase name
+static std::string headerValue(const std::string & headers, const char * name)
+{
+  std::string h;
+  for (char c : headers)
+    h += tolower((unsigned char) c);
+  std::string key = std::string("\n") + name + ":";
+  size_t p = h.find(key);
+  if (p == std::string::npos)
+    return std::string();
+  p += key.size();
+  size_t e = headers.find("\r\n", p);
+  std::string v = headers.substr(p, e - p);
+  v.erase(0, v.find_first_not_of(' '));
+  return v;
+}
+
+static std::string contentType(const std::string & path)
+{
+  static const char * const types[][2] =
+  {
+    { ".htm", "text/html" }, { ".html", "text/html" }, { ".css", "text/css" },
+    { ".js", "application/javascript" }, { ".json", "application/json" }, { ".png", "image/png" },
+    { ".gif", "image/gif" }, { ".jpg", "image/jpeg" }, { ".ico", "image/x-icon" },
+    { ".svg", "image/svg+xml" }, { ".woff", "font/woff" }, { ".woff2", "font/woff2" },
+    { ".ttf", "application/x-font-ttf" }, { ".gz", "application/x-gzip" },
+  };
+  std::string p = path;
+  if (p.size() > 3 && !p.compare(p.size() - 3, 3, ".gz"))
+    p.erase(p.size() - 3);
+  for (const auto & t : types)
+  {
+    size_t n = strlen(t[0]);
+    if (p.size() >= n && !p.compare(p.size() - n, n, t[0]))
+      return t[1];
+  }
+  return "text/plain";
+}
+
+ESP8266WebServer::ESP8266WebServer(int port) :
+  _port(port), _listen(-1), _sock(-1), _method(HTTP_GET), _length(0), _sent(false), _chunked(false)
+{
+}
+
+/* ----------------------------------------------------------------------
+   Setup
+   ---------------------------------------------------------------------- */
+void ESP8266WebServer::begin(void)
+{
+  struct sockaddr_in a;
+  int on = 1;
+
+  _listen = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  a.sin_port = htons(_port == 80 ? hostsim.port : _port);
+  if (bind(_listen, (struct sockaddr *) &a, sizeof(a)) || listen(_listen, 64))
+  {
+    perror("hostsim: web server");
+    exit(1);
+  }
+  printf("hostsim: web server on http://127.0.0.1:%d/\n", ntohs(a.sin_port));
+}
+
+void ESP8266WebServer::on(const String & uri, THandlerFunction fn)
+{
+  on(uri, HTTP_ANY, fn);
+}
+
+void ESP8266WebServer::on(const String & uri, HTTPMethod method, THandlerFunction fn)
+{
+  on(uri, method, fn, THandlerFunction());
+}
+
+void ESP8266WebServer::on(const String & uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn)
+{
+  Route r;
+  r.uri = uri.c_str();
+  r.method = method;
+  r.fn = fn;
+  r.ufn = ufn;
+  _routes.push_back(r);
+}
+
+void ESP8266WebServer::onNotFound(THandlerFunction fn)
+{
+  _notFound = fn;
+}
+
+void ESP8266WebServer::serveStatic(const char * uri, fs::FS & fs, const char * path, const char * cache)
+{
+  Route r;
+  r.uri = uri;
+  r.method = HTTP_GET;
+  r.path = path;
+  r.cache = cache ? cache : "";
+  _routes.push_back(r);
+}
+
+/* ----------------------------------------------------------------------
+   Request
+   ---------------------------------------------------------------------- */
+String ESP8266WebServer::uri(void) { return String(_uri.c_str()); }
+HTTPMethod ESP8266WebServer::method(void) { return _method; }
+int ESP8266WebServer::args(void) { return _args.size(); }
+HTTPUpload & ESP8266WebServer::upload(void) { return _upload; }
+WiFiClient ESP8266WebServer::client(void) { return WiFiClient(); }
+
+String ESP8266WebServer::arg(const String & name)
+{
+  for (const Arg & a : _args)
+    if (a.name == name.c_str())
+      return String(a.value.c_str());
+  return String();
+}
+
+String ESP8266WebServer::arg(int i)
+{
+  return i >= 0 && (size_t) i < _args.size() ? String(_args[i].value.c_str()) : String();
+}
+
+String ESP8266WebServer::argName(int i)
+{
+  return i >= 0 && (size_t) i < _args.size() ? String(_args[i].name.c_str()) : String();
+}
+
+bool ESP8266WebServer::hasArg(const String & name)
+{
+  for (const Arg & a : _args)
+    if (a.name == name.c_str())
+      return true;
+  return false;
+}
+
+static void parseArgs(const std::string & s, std::vector<std::string> & out)
+{
+  size_t p = 0;
+  while (p < s.size())
+  {
+    size_t e = s.find('&', p);
+    if (e == std::string::npos)
+      e = s.size();
+    if (e > p)
+      out.push_back(s.substr(p, e - p));
+    p = e + 1;
+  }
+}
+
+void ESP8266WebServer::addArgs(const std::vector<std::string> & pairs)
+{
+  for (const std::string & p : pairs)
+  {
+    size_t e = p.find('=');
+    _args.push_back(Arg { urlDecode(p.substr(0, e)), e == std::string::npos ? "" : urlDecode(p.substr(e + 1)) });
+  }
+}
+
+// Read until n bytes are buffered, false on timeout or close
+static bool readMore(int sock, std::string & in, size_t n)
+{
+  char b[4096];
+  while (in.size() < n)
+  {
+    ssize_t r = recv(sock, b, sizeof(b), 0);
+    if (r <= 0)
+      return false;
+    in.append(b, r);
+  }
+  return true;
+}
+
+bool ESP8266WebServer::readRequest(void)
+{
+  size_t end;
+  while ((end = _in.find("\r\n\r\n")) == std::string::npos)
+    if (_in.size() > HTTP_MAX_HEADER || !readMore(_sock, _in, _in.size() + 1))
+      return false;
+
+  std::string head = _in.substr(0, end + 2);
+  _in.erase(0, end + 4);
+
+  size_t sp1 = head.find(' ');
+  size_t sp2 = head.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos || sp2 == std::string::npos)
+    return false;
+  std::string m = head.substr(0, sp1);
+  _method = m == "POST" ? HTTP_POST : HTTP_GET;
+  std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+
+  std::vector<std::string> pairs;
+  size_t q = target.find('?');
+  _uri = urlDecode(target.substr(0, q));
+  if (q != std::string::npos)
+    parseArgs(target.substr(q + 1), pairs);
+
+  size_t length = atol(headerValue(head, "content-length").c_str());
+  std::string type = headerValue(head, "content-type");
+  if (length > HTTP_MAX_BODY)
+    return false;
+  if (type.compare(0, 19, "multipart/form-data") == 0)
+  {
+    size_t b = type.find("boundary=");
+    if (b == std::string::npos || !readMore(_sock, _in, length))
+      return false;
+    addArgs(pairs);
+    return readUpload("--" + type.substr(b + 9), length);
+  }
+  if (length)
+  {
+    if (!readMore(_sock, _in, length))
+      return false;
+    if (type.compare(0, 33, "application/x-www-form-urlencoded") == 0)
+      parseArgs(_in.substr(0, length), pairs);
+    else
+      _args.push_back(Arg { "plain", _in.substr(0, length) });
+  }
+
+  addArgs(pairs);
+  return true;
+}
+
+// Multipart body: form fields become arguments, a file goes through the
+// upload handler in HTTP_UPLOAD_BUFLEN chunks like on the board
+bool ESP8266WebServer::readUpload(const std::string & boundary, size_t length)
+{
+  std::string body = _in.substr(0, length);
+  const Route * route = NULL;
+
+  for (const Route & r : _routes)
+    if (r.ufn && r.uri == _uri && (r.method == HTTP_ANY || r.method == _method))
+    {
+      route = &r;
+      break;
+    }
+
+  size_t p = body.find(boundary);
+  while (p != std::string::npos)
+  {
+    p += boundary.size();
+    if (!body.compare(p, 2, "--"))
+      break;
+    size_t h = body.find("\r\n\r\n", p);
+    if (h == std::string::npos)
+      return false;
+    std::string head = body.substr(p, h + 2 - p);
+    size_t data = h + 4;
+    size_t next = body.find("\r\n" + boundary, data);
+    if (next == std::string::npos)
+      return false;
+
+    std::string disp = headerValue(head, "content-disposition");
+    size_t n = disp.find("name=\"");
+    size_t f = disp.find("filename=\"");
+    std::string name = n == std::string::npos ? "" : disp.substr(n + 6, disp.find('"', n + 6) - n - 6);
+    if (f == std::string::npos)
+      _args.push_back(Arg { name, body.substr(data, next - data) });
+    else if (route)
+    {
+      _upload.filename = disp.substr(f + 10, disp.find('"', f + 10) - f - 10).c_str();
+      _upload.totalSize = 0;
+      _upload.currentSize = 0;
+      _upload.status = UPLOAD_FILE_START;
+      route->ufn();
+      for (size_t i = data; i < next; i += HTTP_UPLOAD_BUFLEN)
+      {
+        _upload.currentSize = std::min((size_t) HTTP_UPLOAD_BUFLEN, next - i);
+        memcpy(_upload.buf, body.data() + i, _upload.currentSize);
+        _upload.totalSize += _upload.currentSize;
+        _upload.status = UPLOAD_FILE_WRITE;
+        route->ufn();
+      }
+      _upload.status = UPLOAD_FILE_END;
+      route->ufn();
+    }
+    p = body.find(boundary, next);
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------
+   Response
+   ---------------------------------------------------------------------- */
+void ESP8266WebServer::sendRaw(const char * data, size_t len)
+{
+  while (_sock >= 0 && len)
+  {
+    ssize_t n = ::send(_sock, data, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      break;
+    data += n;
+    len -= n;
+    responseBytes += n;
+  }
+}
+
+void ESP8266WebServer::sendHead(int code, const char * type, size_t len)
+{
+  // A String like in the core, its buffer counts in the handler heap
+  String h(F("HTTP/1.1 "));
+  h += code;
+  h += ' ';
+  h += statusText(code);
+  h += F("\r\nContent-Type: ");
+  h += type ? type : "text/html";
+  if (_length)
+    len = _length;
+  _chunked = len == CONTENT_LENGTH_UNKNOWN;
+  if (_chunked)
+    h += F("\r\nTransfer-Encoding: chunked");
+  else
+  {
+    h += F("\r\nContent-Length: ");
+    h += (unsigned long) len;
+  }
+  h += F("\r\nConnection: close\r\n");
+  h += _headers.c_str();
+  h += F("\r\n");
+  sendRaw(h.c_str(), h.length());
+  _headers.clear();
+  _sent = true;
+}
+
+// Body bytes, as one chunk once the head said chunked, an empty one
+// ends the body
+void ESP8266WebServer::sendBody(const char * data, size_t len)
+{
+  char size[12];
+
+  if (!_chunked)
+  {
+    sendRaw(data, len);
+    return;
+  }
+  sendRaw(size, snprintf(size, sizeof(size), "%zx\r\n", len));
+  sendRaw(data, len);
+  sendRaw("\r\n", 2);
+  if (!len)
+    _chunked = false;
+}
+
+void ESP8266WebServer::sendHeader(const String & name, const String & value, bool first)
+{
+  std::string line = std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+  if (first)
+    _headers.insert(0, line);
+  else
+    _headers += line;
+}
+
+void ESP8266WebServer::send(int code, const char * type, const String & content)
+{
+  sendHead(code, type, content.length());
+  if (content.length())
+    sendBody(content.c_str(), content.length());
+}
+
+void ESP8266WebServer::send(int code, const String & type, const String & content)
+{
+  send(code, type.c_str(), content);
+}
+
+void ESP8266WebServer::send(int code, const char * type)
+{
+  send(code, type, String());
+}
+
+void ESP8266WebServer::send_P(int code, PGM_P type, PGM_P content)
+{
+  sendHead(code, type, strlen(content));
+  if (*content)
+    sendBody(content, strlen(content));
+}
+
+void ESP8266WebServer::setContentLength(size_t len)
+{
+  _length = len;
+}
+
+void ESP8266WebServer::sendContent(const String & content)
+{
+  sendBody(content.c_str(), content.length());
+}
+
+void ESP8266WebServer::sendContent_P(PGM_P content)
+{
+  sendBody(content, strlen(content));
+}
+
+void ESP8266WebServer::sendContent_P(PGM_P content, size_t len)
+{
+  sendBody(content, len);
+}
+
+size_t hostsimStreamFile(ESP8266WebServer & server, fs::File & file)
+{
+  char b[1460];
+  size_t n, sent = 0;
+  while ((n = file.read((uint8_t *) b, sizeof(b))) > 0)
+  {
+    server.sendRaw(b, n);
+    sent += n;
+  }
+  return sent;
+}
+
+bool ESP8266WebServer::serveFile(const Route & r)
+{
+  if (_method != HTTP_GET || _uri.compare(0, r.uri.size(), r.uri))
+    return false;
+
+  std::string path = r.path + _uri.substr(r.uri.size());
+  if (path.empty() || path.back() == '/')
+    path += "index.htm";
+  std::string type = contentType(path);
+  if (!SPIFFS.exists(path.c_str()) && SPIFFS.exists((path + ".gz").c_str()))
+    path += ".gz";
+  File f = SPIFFS.open(path.c_str(), "r");
+  if (!f)
+    return false;
+  if (!r.cache.empty())
+    sendHeader("Cache-Control", r.cache.c_str());
+  streamFile(f, type.c_str());
+  return true;
+}
+
+/* ----------------------------------------------------------------------
+   Service, from loop()
+   ---------------------------------------------------------------------- */
+static void statsJSON(String & r)
+{
+  r = F("{\"heap\":");
+  r += (unsigned long) hostsim.heap;
+  r += F(",\"used\":");
+  r += (unsigned long) hostsimHeapUsed();
+  r += F(",\"routes\":{");
+  bool first = true;
+  for (const auto & s : routeStats)
+  {
+    char b[256];
+    snprintf(b, sizeof(b), "%s\"%s\":{\"count\":%u,\"us_avg\":%llu,\"us_max\":%u,\"heap_peak\":%zu,"
+             "\"bytes_avg\":%zu,\"alloc_failed\":%u,\"unanswered\":%u}", first ? "" : ",", s.first.c_str(), s.second.count,
+             (unsigned long long) (s.second.us / s.second.count), s.second.us_max, s.second.heap_max,
+             s.second.bytes / s.second.count, s.second.failed, s.second.unanswered);
+    r += b;
+    first = false;
+  }
+  r += F("}}");
+}
+
+void ESP8266WebServer::handleClient(void)
+{
+  struct pollfd p = { _listen, POLLIN, 0 };
+  struct timeval tv = { HTTP_TIMEOUT, 0 };
+
+  if (_listen < 0 || poll(&p, 1, 1) <= 0)
+    return;
+  _sock = accept(_listen, NULL, NULL);
+  if (_sock < 0)
+    return;
+  setsockopt(_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  _in.clear();
+  _args.clear();
+  _headers.clear();
+  _length = 0;
+  _sent = false;
+  _chunked = false;
+
+  size_t base = hostsimHeapUsed();
+  uint32_t failed = hostsimHeapFailed();
+  hostsimHeapPeakReset();
+  responseBytes = 0;
+  uint64_t start = hostsimMicros();
+  std::string key;
+
+  if (!readRequest())
+    sendHead(400, "text/plain", 0);
+  else if (_uri == STATS_URI)
+  {
+    String r;
+    statsJSON(r);
+    if (hasArg("reset"))
+      routeStats.clear();
+    send(200, "application/json", r);
+  }
+  else
+  {
+    for (const Route & r : _routes)
+    {
+      if (r.fn)
+      {
+        if (r.uri != _uri || (r.method != HTTP_ANY && r.method != _method))
+          continue;
+        r.fn();
+      }
+      else if (!serveFile(r))
+        continue;
+      key = r.fn ? r.uri : _uri;
+      break;
+    }
+    if (key.empty())
+    {
+      key = _uri;
+      if (_notFound)
+        _notFound();
+      else
+        send(404, "text/plain", "Not found");
+    }
+  }
+
+  if (!key.empty())
+  {
+    uint32_t us = hostsimMicros() - start;
+    RouteStats & s = routeStats[key];
+    s.count++;
+    s.us += us;
+    if (us > s.us_max)
+      s.us_max = us;
+    if (hostsimHeapPeak() - base > s.heap_max)
+      s.heap_max = hostsimHeapPeak() - base;
+    s.bytes += responseBytes;
+    s.failed += hostsimHeapFailed() - failed;
+    if (!_sent)
+      s.unanswered++;
+  }
+  if (!_sent)
+    sendHead(500, "text/plain", 0);
+
+  close(_sock);
+  _sock = -1;
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Stand-in HTTPS report server, to try the HTTPS transport on the bench.
+
+Prints every report body and answers 200 with the directives of --reply.
+Its certificate is created at first run; the fingerprint to set as
+report_fp is printed at start.
+
+    https_server.py --port 443 --cert server.pem --reply reply.txt
+"""
+
+import argparse
+import hashlib
+import http.server
+import os
+import ssl
+import subprocess
+import sys
+
+
+def make_cert(path):
+    # Self-signed ECDSA P-256 certificate, the cheapest for the ESP
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+                    "-nodes", "-days", "3650", "-subj", "/CN=eslpweather-test", "-keyout", path, "-out", path],
+                   check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def fingerprint(path):
+    with open(path) as f:
+        pem = f.read()
+    start = pem.index("-----BEGIN CERTIFICATE-----")
+    der = ssl.PEM_cert_to_DER_cert(pem[start:pem.index("-----END CERTIFICATE-----") + 25])
+    return ":".join("%02X" % b for b in hashlib.sha1(der).digest())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=443, help="TCP port (report_port)")
+    parser.add_argument("--cert", default="https_server.pem", help="certificate and key, created if missing")
+    parser.add_argument("--reply", help="file sent back as reply body, see Report server replies")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.cert):
+        make_cert(args.cert)
+    print("report_fp=%s" % fingerprint(args.cert), file=sys.stderr)
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        # Keep-alive, as HTTPClient
+        protocol_version = "HTTP/1.1"
+
+        def reply(self):
+            body = b""
+            if args.reply:
+                with open(args.reply, "rb") as f:
+                    body = f.read()
+            self.send_response(200)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            session = "resumed" if self.connection.session_reused else "full handshake"
+            print("%s %s %s (%s, %s): %s" % (self.client_address[0], self.command, self.path,
+                                             self.connection.cipher()[0], session,
+                                             body.decode(errors="replace")), flush=True)
+            self.reply()
+
+        def do_GET(self):
+            print("%s GET %s" % (self.client_address[0], self.path), flush=True)
+            self.reply()
+
+        def log_message(self, format, *a):
+            pass
+
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    # BearSSL on the ESP resumes by session ID, not tickets
+    ctx.options |= ssl.OP_NO_TICKET
+    ctx.load_cert_chain(args.cert)
+
+    server = http.server.ThreadingHTTPServer((args.bind, args.port), Handler)
+    server.socket = ctx.wrap_socket(server.socket, server_side=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,57 @@
+"""PlatformIO post build script: firmware size by memory region.
+
+Writes size.txt next to firmware.bin and prints it, so that the dev and
+field builds can be compared:
+
+    pio run -e dev -e field && cat .pio/build/*/size.txt
+"""
+
+import os
+import subprocess
+
+Import("env")  # noqa: F821, provided by SCons
+
+# Section name prefix -> region
+REGIONS = (
+    (".irom0.text", "flash code"),
+    (".text", "IRAM code"),
+    (".iram", "IRAM code"),
+    (".data", "RAM data"),
+    (".rodata", "RAM data"),
+    (".bss", "RAM bss"),
+)
+
+
+def region(section):
+    for prefix, name in REGIONS:
+        if section.startswith(prefix):
+            return name
+    return None
+
+
+def size_report(source, target, env):
+    elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    out = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+
+    sizes = {}
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[1].isdigit():
+            name = region(fields[0])
+            if name:
+                sizes[name] = sizes.get(name, 0) + int(fields[1])
+
+    lines = ["%s firmware size" % env["PIOENV"]]
+    # One row per region, several prefixes may add to it
+    for name in dict.fromkeys(name for _, name in REGIONS):
+        if name in sizes:
+            lines.append("  %-10s %7d" % (name, sizes[name]))
+    lines.append("  %-10s %7d" % ("image", os.path.getsize(str(target[0]))))
+    report = "\n".join(lines) + "\n"
+
+    with open(os.path.join(env.subst("$BUILD_DIR"), "size.txt"), "w") as f:
+        f.write(report)
+    print(report)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", size_report)  # noqa: F821
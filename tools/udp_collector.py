@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Reference collector for the UDP report transport.
+
+Prints every valid report as a JSON line and acknowledges it when asked to.
+
+    udp_collector.py --port 5683 --key mysharedkey
+"""
+
+import argparse
+import json
+import socket
+import sys
+
+import eslpframe
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bind", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=5683, help="UDP port (report_port)")
+    parser.add_argument("--key", help="shared key (report_key), MACs are not checked without it")
+    args = parser.parse_args()
+
+    key = args.key.encode() if args.key else None
+    last = {}
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    while True:
+        frame, peer = sock.recvfrom(512)
+        try:
+            report = eslpframe.decode(frame, key)
+        except ValueError as err:
+            print("%s: %s" % (peer[0], err), file=sys.stderr)
+            continue
+
+        if report["ack"]:
+            sock.sendto(eslpframe.ack(report["chip"], report["seq"], key), peer)
+
+        # Retried frame whose acknowledge got lost
+        if last.get(report["chip"]) == report["seq"]:
+            continue
+        last[report["chip"]] = report["seq"]
+
+        report["from"] = peer[0]
+        print(json.dumps(report), flush=True)
+
+
+if __name__ == "__main__":
+    main()